@@ -0,0 +1,519 @@
+//
+//  adaptiveLock.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#if defined(__linux__)
+	#include <sys/syscall.h>
+	#include <linux/futex.h>
+#endif
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+//
+#include "adaptiveLock.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+typedef enum LockBenchCase {
+								MUTEX_CASE = 0,
+								ADAPTIVE_LOCK_CASE,
+								FIXED_SLEEP_CASE,
+								ADAPTIVE_EVENT_CASE,
+								//
+								NUM_LOCK_BENCH_CASES
+} LockBenchCase;
+
+/** A benchmark thread
+ *  @var benchCase  what it times
+ *  @var ops        critical sections run, or units taken
+ *  @var waitNs     total latency of the ops
+ *  @var latency    ops per log2 bucket of their latency (ns)
+ */
+typedef struct alignas(64) LockBenchThread {
+	LockBenchCase benchCase;
+	unsigned long ops;
+	uint64_t waitNs;
+	unsigned long latency[ADAPTIVE_LATENCY_BUCKETS];
+} LockBenchThread;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+//	Spin sizing: about SPIN_HOLD_FACTOR times the average hold (or wait),
+//	at least MIN_SPIN_NS; a hold longer than MAX_SPIN_NS is not worth
+//	spinning for (parking and waking cost a few microseconds).
+const double SPIN_HOLD_FACTOR = 2.;
+const double MIN_SPIN_NS = 200.;
+const double MAX_SPIN_NS = 20000.;
+const int YIELD_ROUNDS = 4;
+//	one acquisition in HOLD_SAMPLE_MASK+1 has its hold timed
+const unsigned long HOLD_SAMPLE_MASK = 15;
+//	weight of a new sample in the moving averages
+const double EWMA_WEIGHT = 1. / 8.;
+//	parking without futexes: sleep this long between two checks
+const long PARK_FALLBACK_US = 50;
+
+const char* WAIT_STAGE_NAME[NUM_WAIT_STAGES] = {"spin", "yield", "park"};
+
+double pauseNs = 10.;
+bool singleCore = false;
+
+//	benchmark: length of each case, critical section and work outside it
+//	(in loop iterations), producer period and the fixed retry sleep
+const double LOCK_BENCH_SECONDS = 1.;
+const int BENCH_INSIDE_WORK = 40;
+const int BENCH_OUTSIDE_WORK = 200;
+const long BENCH_POUR_US = 1000;
+const long BENCH_RETRY_SLEEP_US = 100000;
+const int BENCH_POUR_RING = 1 << 16;
+const char* LOCK_BENCH_CASE_NAME[NUM_LOCK_BENCH_CASES] = {"pthread mutex", "adaptive lock", "fixed sleep",
+															"adaptive event"};
+
+pthread_mutex_t benchMutex = PTHREAD_MUTEX_INITIALIZER;
+AdaptiveLock benchLock;
+AdaptiveEvent benchEvent;
+volatile unsigned long benchShared[16];
+atomic<bool> lockBenchGo(false), lockBenchStop(false);
+//	the tank of the wait cases: units poured, units taken, pour times
+atomic<unsigned long> benchPoured(0), benchTaken(0);
+uint64_t* benchPourNs = NULL;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static uint64_t nowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static inline void cpuRelax(void)
+{
+#if defined(__SSE2__)
+	_mm_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+//	Parks on word while it holds value, for at most timeoutNs (0: no limit)
+static void parkOn(atomic<uint32_t>* word, uint32_t value, uint64_t timeoutNs)
+{
+#if defined(__linux__)
+	struct timespec timeout = {(time_t) (timeoutNs / 1000000000ULL), (long) (timeoutNs % 1000000000ULL)};
+	syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, timeoutNs > 0 ? &timeout : NULL, NULL, 0);
+#else
+	if (word->load(memory_order_relaxed) == value)
+		usleep(timeoutNs > 0 ? min((uint64_t) PARK_FALLBACK_US, timeoutNs / 1000 + 1) : PARK_FALLBACK_US);
+#endif
+}
+
+static void wakeOn(atomic<uint32_t>* word, int count)
+{
+#if defined(__linux__)
+	syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#endif
+}
+
+static int latencyBucket(uint64_t ns)
+{
+	return min(ADAPTIVE_LATENCY_BUCKETS-1, 63 - __builtin_clzll(ns | 1));
+}
+
+//	upper bound of the bucket holding the given fraction of the waits
+static uint64_t latencyPercentile(const unsigned long* buckets, double fraction)
+{
+	unsigned long total = 0, seen = 0;
+	for (int k=0; k<ADAPTIVE_LATENCY_BUCKETS; k++)
+		total += buckets[k];
+	for (int k=0; k<ADAPTIVE_LATENCY_BUCKETS; k++)
+	{
+		seen += buckets[k];
+		if (total > 0 && seen >= fraction * total)
+			return 2ULL << k;
+	}
+	return 0;
+}
+
+static uint32_t spinBudgetFor(double averageNs)
+{
+	//	with one core, the holder cannot run while we spin
+	if (singleCore)
+		return 0;
+	double spinNs = SPIN_HOLD_FACTOR * averageNs;
+	if (spinNs > MAX_SPIN_NS)
+		return 0;
+	return (uint32_t) (max(spinNs, MIN_SPIN_NS) / pauseNs);
+}
+
+static void recordWait(AdaptiveWaitStats* stats, AdaptiveWaitStage stage, uint64_t ns)
+{
+	stats->waits.fetch_add(1, memory_order_relaxed);
+	stats->byStage[stage].fetch_add(1, memory_order_relaxed);
+	stats->waitNs.fetch_add(ns, memory_order_relaxed);
+	stats->latency[latencyBucket(ns)].fetch_add(1, memory_order_relaxed);
+}
+
+static inline bool tryTake(AdaptiveLock* lock)
+{
+	uint32_t c = 0;
+	return lock->state.load(memory_order_relaxed) == 0 &&
+			lock->state.compare_exchange_strong(c, 1, memory_order_acquire, memory_order_relaxed);
+}
+
+static void lockContended(AdaptiveLock* lock)
+{
+	uint64_t start = nowNs();
+	AdaptiveWaitStage stage = SPIN_STAGE;
+	bool taken = false;
+	uint32_t budget = lock->spinBudget.load(memory_order_relaxed);
+	for (uint32_t k=0; k<budget && !taken; k++)
+	{
+		cpuRelax();
+		taken = tryTake(lock);
+	}
+	if (!taken)
+	{
+		stage = YIELD_STAGE;
+		for (int k=0; k<YIELD_ROUNDS && !taken; k++)
+		{
+			sched_yield();
+			taken = tryTake(lock);
+		}
+	}
+	if (!taken)
+	{
+		//	2 from here on: whoever releases the lock wakes a sleeper
+		stage = PARK_STAGE;
+		while (lock->state.exchange(2, memory_order_acquire) != 0)
+			parkOn(&lock->state, 2, 0);
+	}
+	recordWait(&lock->stats, stage, nowNs() - start);
+}
+
+static void printStats(FILE* out, const char* name, const AdaptiveWaitStats* stats, uint32_t spinBudget,
+					   double averageNs, const char* averageName)
+{
+	unsigned long waits = stats->waits.load(), latency[ADAPTIVE_LATENCY_BUCKETS];
+	for (int k=0; k<ADAPTIVE_LATENCY_BUCKETS; k++)
+		latency[k] = stats->latency[k].load();
+	fprintf(out, "  %-12s %9lu waits", name, waits);
+	if (waits > 0)
+	{
+		fprintf(out, " (");
+		for (int s=0; s<NUM_WAIT_STAGES; s++)
+			fprintf(out, "%s%.0f%% %s", s > 0 ? ", " : "", 100. * stats->byStage[s].load() / waits, WAIT_STAGE_NAME[s]);
+		fprintf(out, "), mean %.1f us, p50 < %.1f us, p99 < %.1f us", stats->waitNs.load() * 1e-3 / waits,
+				latencyPercentile(latency, 0.5) * 1e-3, latencyPercentile(latency, 0.99) * 1e-3);
+	}
+	fprintf(out, "\n  %-12s spin budget %u pauses (%.0f ns), %s %.2f us\n", "", spinBudget, spinBudget * pauseNs,
+			averageName, averageNs * 1e-3);
+}
+
+static double cpuSeconds(const struct rusage* usage)
+{
+	return usage->ru_utime.tv_sec + usage->ru_utime.tv_usec * 1e-6 + usage->ru_stime.tv_sec +
+			usage->ru_stime.tv_usec * 1e-6;
+}
+
+static void busyWork(int iterations)
+{
+	for (int k=0; k<iterations; k++)
+		benchShared[k & 15] = benchShared[k & 15] + 1;
+}
+
+static void* lockBenchThread(void* data)
+{
+	LockBenchThread* self = (LockBenchThread*) data;
+	unsigned int local[16] = {0};
+	while (!lockBenchGo.load(memory_order_acquire))
+		;
+	while (!lockBenchStop.load(memory_order_relaxed))
+	{
+		uint64_t start = nowNs();
+		if (self->benchCase == MUTEX_CASE)
+			pthread_mutex_lock(&benchMutex);
+		else
+			adaptiveLock(&benchLock);
+		uint64_t waited = nowNs() - start;
+		self->waitNs += waited;
+		self->latency[latencyBucket(waited)]++;
+		busyWork(BENCH_INSIDE_WORK);
+		if (self->benchCase == MUTEX_CASE)
+			pthread_mutex_unlock(&benchMutex);
+		else
+			adaptiveUnlock(&benchLock);
+		self->ops++;
+		for (int k=0; k<BENCH_OUTSIDE_WORK; k++)
+			local[k & 15] += k;
+	}
+	benchShared[0] = benchShared[0] + local[0];
+	return NULL;
+}
+
+//	A consumer of the wait cases: takes a unit, or waits for the next pour
+static void* waitBenchThread(void* data)
+{
+	LockBenchThread* self = (LockBenchThread*) data;
+	while (!lockBenchGo.load(memory_order_acquire))
+		;
+	while (!lockBenchStop.load(memory_order_relaxed))
+	{
+		uint32_t seen = adaptiveEventSequence(&benchEvent);
+		unsigned long taken = benchTaken.load(memory_order_relaxed);
+		if (taken < benchPoured.load(memory_order_acquire))
+		{
+			if (benchTaken.compare_exchange_weak(taken, taken + 1, memory_order_relaxed))
+			{
+				uint64_t waited = nowNs() - benchPourNs[taken % BENCH_POUR_RING];
+				self->waitNs += waited;
+				self->latency[latencyBucket(waited)]++;
+				self->ops++;
+			}
+		}
+		else if (self->benchCase == FIXED_SLEEP_CASE)
+			usleep(BENCH_RETRY_SLEEP_US);
+		else
+			adaptiveEventWait(&benchEvent, seen, BENCH_RETRY_SLEEP_US);
+	}
+	return NULL;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void adaptiveLockCalibrate(void)
+{
+	const int NUM_PAUSES = 20000;
+	singleCore = thread::hardware_concurrency() <= 1;
+	uint64_t start = nowNs();
+	for (int k=0; k<NUM_PAUSES; k++)
+		cpuRelax();
+	pauseNs = max(1., (double) (nowNs() - start) / NUM_PAUSES);
+}
+
+void adaptiveLockInit(AdaptiveLock* lock, const char* name)
+{
+	lock->state.store(0);
+	lock->name = name;
+	lock->acquisitions = 0;
+	lock->holdStartNs = 0;
+	lock->holdEwmaNs = 0.;
+	lock->spinBudget.store(spinBudgetFor(MIN_SPIN_NS));
+	lock->stats.waits = 0;
+	lock->stats.waitNs = 0;
+	for (int s=0; s<NUM_WAIT_STAGES; s++)
+		lock->stats.byStage[s] = 0;
+	for (int k=0; k<ADAPTIVE_LATENCY_BUCKETS; k++)
+		lock->stats.latency[k] = 0;
+}
+
+void adaptiveLock(AdaptiveLock* lock)
+{
+	uint32_t c = 0;
+	if (!lock->state.compare_exchange_strong(c, 1, memory_order_acquire, memory_order_relaxed))
+		lockContended(lock);
+	if ((++lock->acquisitions & HOLD_SAMPLE_MASK) == 0)
+		lock->holdStartNs = nowNs();
+}
+
+void adaptiveUnlock(AdaptiveLock* lock)
+{
+	if (lock->holdStartNs != 0)
+	{
+		double hold = (double) (nowNs() - lock->holdStartNs);
+		lock->holdEwmaNs = lock->holdEwmaNs == 0. ? hold : lock->holdEwmaNs + EWMA_WEIGHT * (hold - lock->holdEwmaNs);
+		lock->holdStartNs = 0;
+		lock->spinBudget.store(spinBudgetFor(lock->holdEwmaNs), memory_order_relaxed);
+	}
+	if (lock->state.exchange(0, memory_order_release) == 2)
+		wakeOn(&lock->state, 1);
+}
+
+void adaptiveEventInit(AdaptiveEvent* event, const char* name)
+{
+	event->sequence.store(0);
+	event->sleepers.store(0);
+	event->spinBudget.store(spinBudgetFor(MIN_SPIN_NS));
+	event->name = name;
+	event->waitEwmaNs.store(0);
+	event->timeouts.store(0);
+	event->stats.waits = 0;
+	event->stats.waitNs = 0;
+	for (int s=0; s<NUM_WAIT_STAGES; s++)
+		event->stats.byStage[s] = 0;
+	for (int k=0; k<ADAPTIVE_LATENCY_BUCKETS; k++)
+		event->stats.latency[k] = 0;
+}
+
+uint32_t adaptiveEventSequence(AdaptiveEvent* event)
+{
+	return event->sequence.load(memory_order_acquire);
+}
+
+bool adaptiveEventWait(AdaptiveEvent* event, uint32_t seen, long timeoutUs)
+{
+	uint64_t start = nowNs();
+	uint64_t deadline = start + (uint64_t) max(0L, timeoutUs) * 1000;
+	AdaptiveWaitStage stage = SPIN_STAGE;
+	bool signaled = false;
+	uint32_t budget = event->spinBudget.load(memory_order_relaxed);
+	for (uint32_t k=0; k<budget && !signaled; k++)
+	{
+		cpuRelax();
+		signaled = event->sequence.load(memory_order_acquire) != seen;
+	}
+	for (int k=0; k<YIELD_ROUNDS && !signaled; k++)
+	{
+		stage = YIELD_STAGE;
+		sched_yield();
+		signaled = event->sequence.load(memory_order_acquire) != seen;
+	}
+	uint64_t now = nowNs();
+	while (!signaled && now < deadline)
+	{
+		//	registered before the last check: a notify in between sees us
+		stage = PARK_STAGE;
+		event->sleepers.fetch_add(1);
+		if (event->sequence.load() == seen)
+			parkOn(&event->sequence, seen, deadline - now);
+		event->sleepers.fetch_sub(1);
+		signaled = event->sequence.load(memory_order_acquire) != seen;
+		now = nowNs();
+	}
+
+	//	a timeout counts as a long wait: not worth spinning for
+	uint64_t waited = now - start;
+	uint64_t average = event->waitEwmaNs.load(memory_order_relaxed);
+	average = average == 0 ? waited : (uint64_t) (average + EWMA_WEIGHT * ((double) waited - average));
+	event->waitEwmaNs.store(average, memory_order_relaxed);
+	event->spinBudget.store(spinBudgetFor((double) average), memory_order_relaxed);
+	if (signaled)
+		recordWait(&event->stats, stage, waited);
+	else
+		event->timeouts.fetch_add(1, memory_order_relaxed);
+	return signaled;
+}
+
+void adaptiveEventNotify(AdaptiveEvent* event, int count)
+{
+	event->sequence.fetch_add(1);
+	if (event->sleepers.load() > 0)
+		wakeOn(&event->sequence, count);
+}
+
+void adaptiveLockPrintReport(FILE* out, const AdaptiveLock* lock)
+{
+	printStats(out, lock->name, &lock->stats, lock->spinBudget.load(), lock->holdEwmaNs, "average hold");
+	fprintf(out, "  %-12s %lu acquisitions, %.2f%% contended\n", "", lock->acquisitions,
+			lock->acquisitions > 0 ? 100. * lock->stats.waits.load() / lock->acquisitions : 0.);
+}
+
+void adaptiveEventPrintReport(FILE* out, const AdaptiveEvent* event)
+{
+	printStats(out, event->name, &event->stats, event->spinBudget.load(), (double) event->waitEwmaNs.load(),
+			   "average wait");
+	fprintf(out, "  %-12s %lu waits timed out\n", "", event->timeouts.load());
+}
+
+void adaptiveLockBenchmark(int numThreads, FILE* out)
+{
+	adaptiveLockCalibrate();
+	benchPourNs = (uint64_t*) calloc(BENCH_POUR_RING, sizeof(uint64_t));
+	fprintf(out, "Waiting, %d thread(s), %.1f s each (pause %.1f ns%s)\n", numThreads, LOCK_BENCH_SECONDS, pauseNs,
+			singleCore ? ", one core: no spinning" : "");
+	fprintf(out, "  %-15s %12s %10s %10s %10s %12s %10s\n", "case", "ops/s", "mean us", "p50 us", "p99 us",
+			"CPU us/op", "switches");
+	for (int benchCase=0; benchCase<NUM_LOCK_BENCH_CASES; benchCase++)
+	{
+		bool waitCase = benchCase == FIXED_SLEEP_CASE || benchCase == ADAPTIVE_EVENT_CASE;
+		adaptiveLockInit(&benchLock, "bench");
+		adaptiveEventInit(&benchEvent, "bench");
+		benchPoured = 0;
+		benchTaken = 0;
+		lockBenchGo = false;
+		lockBenchStop = false;
+		vector<LockBenchThread> threads(numThreads);
+		vector<pthread_t> threadIDs(numThreads);
+		for (int k=0; k<numThreads; k++)
+		{
+			threads[k] = {};
+			threads[k].benchCase = (LockBenchCase) benchCase;
+			if (pthread_create(&threadIDs[k], nullptr, waitCase ? waitBenchThread : lockBenchThread, &threads[k]) != 0)
+			{
+				fprintf(stderr, "could not create lock benchmark thread %d\n", k);
+				exit(EXIT_FAILURE);
+			}
+		}
+		struct rusage before, after;
+		getrusage(RUSAGE_SELF, &before);
+		uint64_t start = nowNs(), end = start + (uint64_t) (LOCK_BENCH_SECONDS * 1e9);
+		lockBenchGo.store(true, memory_order_release);
+		if (waitCase)
+		{
+			//	this thread is the producer: a unit every BENCH_POUR_US
+			for (uint64_t pour = start; pour < end; pour += BENCH_POUR_US * 1000)
+			{
+				struct timespec due = {(time_t) (pour / 1000000000ULL), (long) (pour % 1000000000ULL)};
+				while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) != 0)
+					;
+				unsigned long unit = benchPoured.load(memory_order_relaxed);
+				benchPourNs[unit % BENCH_POUR_RING] = nowNs();
+				benchPoured.store(unit + 1, memory_order_release);
+				if (benchCase == ADAPTIVE_EVENT_CASE)
+					adaptiveEventNotify(&benchEvent, 1);
+			}
+		}
+		else
+			usleep((useconds_t) (LOCK_BENCH_SECONDS * 1e6));
+		lockBenchStop = true;
+		adaptiveEventNotify(&benchEvent, INT_MAX);
+		unsigned long ops = 0, latency[ADAPTIVE_LATENCY_BUCKETS] = {0};
+		uint64_t waitNs = 0;
+		for (int k=0; k<numThreads; k++)
+		{
+			pthread_join(threadIDs[k], NULL);
+			ops += threads[k].ops;
+			waitNs += threads[k].waitNs;
+			for (int b=0; b<ADAPTIVE_LATENCY_BUCKETS; b++)
+				latency[b] += threads[k].latency[b];
+		}
+		getrusage(RUSAGE_SELF, &after);
+		double seconds = (nowNs() - start) * 1e-9;
+
+		//	latencies: to take the lock, or from the pour to the take
+		double meanNs = ops > 0 ? (double) waitNs / ops : 0.;
+		long switches = (after.ru_nvcsw + after.ru_nivcsw) - (before.ru_nvcsw + before.ru_nivcsw);
+		fprintf(out, "  %-15s %12.0f %10.2f %10.2f %10.2f %12.3f %10ld\n", LOCK_BENCH_CASE_NAME[benchCase], ops / seconds,
+				meanNs * 1e-3, latencyPercentile(latency, 0.5) * 1e-3, latencyPercentile(latency, 0.99) * 1e-3,
+				ops > 0 ? (cpuSeconds(&after) - cpuSeconds(&before)) * 1e6 / ops : 0., switches);
+		if (benchCase == ADAPTIVE_LOCK_CASE)
+			adaptiveLockPrintReport(out, &benchLock);
+		else if (benchCase == ADAPTIVE_EVENT_CASE)
+			adaptiveEventPrintReport(out, &benchEvent);
+	}
+	fprintf(out, "  (locks: time to take it around a short critical section; waits: a unit poured every %ld us,"
+			" latency from the pour to the take, fixed sleep %ld ms)\n", BENCH_POUR_US, BENCH_RETRY_SLEEP_US / 1000);
+	free(benchPourNs);
+}
@@ -0,0 +1,170 @@
+//
+//  adaptiveLock.h
+//  GL threads
+//
+//  Adaptive spin-then-park waiting.  A waiter first spins on the word it
+//	waits for (with pause instructions), then yields the core a few times,
+//	then parks in the kernel on a futex.  Spinning only pays when the wait
+//	is shorter than a trip through the scheduler, so each lock sizes its
+//	spin from the hold times it observes (a sample every few
+//	acquisitions): about twice the average hold, and no spin at all if the
+//	holds are longer than the longest spin, or if there is one core.
+//
+//	AdaptiveLock is a mutex (free / held / held with sleepers, as in
+//	Drepper's "Futexes are tricky"): uncontended, a lock and an unlock are
+//	one atomic operation each.  AdaptiveEvent waits for a condition that
+//	another thread signals (ink poured in a tank): it replaces the fixed
+//	sleep after a failed take, and sizes its spin from the observed waits.
+//
+
+#ifndef ADAPTIVE_LOCK_H
+#define ADAPTIVE_LOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+//	log2 buckets of the wait latencies (ns)
+const int ADAPTIVE_LATENCY_BUCKETS = 32;
+
+typedef enum AdaptiveWaitStage {
+								SPIN_STAGE = 0,
+								YIELD_STAGE,
+								PARK_STAGE,
+								//
+								NUM_WAIT_STAGES
+} AdaptiveWaitStage;
+
+/** Wait statistics of a lock or an event.  A lock's are written by its
+ *	holder only; an event's with relaxed atomic adds.
+ *  @var waits          waits (contended acquisitions)
+ *  @var byStage        waits that ended at each stage
+ *  @var waitNs         total time waited
+ *  @var latency        waits per log2 bucket of their duration
+ */
+typedef struct AdaptiveWaitStats {
+	std::atomic<unsigned long> waits;
+	std::atomic<unsigned long> byStage[NUM_WAIT_STAGES];
+	std::atomic<unsigned long> waitNs;
+	std::atomic<unsigned long> latency[ADAPTIVE_LATENCY_BUCKETS];
+} AdaptiveWaitStats;
+
+/** A mutex that spins, yields, then parks
+ *  @var state          0: free, 1: held, 2: held, maybe with sleepers
+ *  @var spinBudget     pause instructions spun before yielding
+ *  @var name           name in the report
+ *  @var acquisitions   all acquisitions (counted by the holder)
+ *  @var holdStartNs    start of the sampled hold (0: not sampled)
+ *  @var holdEwmaNs     average hold time (moving)
+ *  @var stats          waits
+ */
+typedef struct alignas(64) AdaptiveLock {
+	std::atomic<uint32_t> state;
+	std::atomic<uint32_t> spinBudget;
+	const char* name;
+	unsigned long acquisitions;
+	uint64_t holdStartNs;
+	double holdEwmaNs;
+	AdaptiveWaitStats stats;
+} AdaptiveLock;
+
+/** A condition signaled by other threads: waiters wait for the sequence
+ *	number to move
+ *  @var sequence       bumped by every notify
+ *  @var sleepers       threads parked on sequence
+ *  @var spinBudget     pause instructions spun before yielding
+ *  @var name           name in the report
+ *  @var waitEwmaNs     average wait (moving; lost updates are harmless)
+ *  @var timeouts       waits that ended unsignaled
+ *  @var stats          waits
+ */
+typedef struct alignas(64) AdaptiveEvent {
+	std::atomic<uint32_t> sequence;
+	std::atomic<uint32_t> sleepers;
+	std::atomic<uint32_t> spinBudget;
+	const char* name;
+	std::atomic<uint64_t> waitEwmaNs;
+	std::atomic<unsigned long> timeouts;
+	AdaptiveWaitStats stats;
+} AdaptiveEvent;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Measures the cost of a pause instruction (call once, before the first
+ *	lock is used: the spin budgets are counted in pauses)
+ */
+void adaptiveLockCalibrate(void);
+
+/** Sets up a lock, free
+ *  @param lock     the lock
+ *  @param name     name in the report (a literal: the pointer is kept)
+ */
+void adaptiveLockInit(AdaptiveLock* lock, const char* name);
+
+/** Takes a lock, waiting as long as it takes
+ *  @param lock     the lock
+ */
+void adaptiveLock(AdaptiveLock* lock);
+
+/** Releases a lock held by the calling thread
+ *  @param lock     the lock
+ */
+void adaptiveUnlock(AdaptiveLock* lock);
+
+/** Sets up an event
+ *  @param event    the event
+ *  @param name     name in the report (a literal: the pointer is kept)
+ */
+void adaptiveEventInit(AdaptiveEvent* event, const char* name);
+
+/** Current sequence number of an event: read it before checking the
+ *	condition, and wait with it if the condition does not hold, so that a
+ *	notify in between is not missed
+ *  @param event    the event
+ *  @return its sequence number
+ */
+uint32_t adaptiveEventSequence(AdaptiveEvent* event);
+
+/** Waits until the event is notified after sequence number seen, or for
+ *	at most timeoutUs
+ *  @param event        the event
+ *  @param seen         sequence number read before checking the condition
+ *  @param timeoutUs    longest wait (in microseconds)
+ *  @return false if the wait timed out
+ */
+bool adaptiveEventWait(AdaptiveEvent* event, uint32_t seen, long timeoutUs);
+
+/** Signals an event
+ *  @param event    the event
+ *  @param count    parked waiters to wake (spinning ones all see it)
+ */
+void adaptiveEventNotify(AdaptiveEvent* event, int count);
+
+/** Prints the waits of a lock: stage reached, latency, spin budget
+ *  @param out      output stream
+ *  @param lock     the lock
+ */
+void adaptiveLockPrintReport(FILE* out, const AdaptiveLock* lock);
+
+/** Prints the waits of an event
+ *  @param out      output stream
+ *  @param event    the event
+ */
+void adaptiveEventPrintReport(FILE* out, const AdaptiveEvent* event);
+
+/** Compares, on n threads, pthread mutexes with adaptive locks (short
+ *	critical sections), and a fixed sleep after a failed take with an
+ *	adaptive event (a consumer waiting for a producer): latency of the
+ *	waits and CPU time used
+ *  @param numThreads   contending threads
+ *  @param out          output stream
+ */
+void adaptiveLockBenchmark(int numThreads, FILE* out);
+
+#endif // ADAPTIVE_LOCK_H
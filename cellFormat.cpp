@@ -0,0 +1,209 @@
+//
+//  cellFormat.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <time.h>
+//
+#include "cellFormat.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+/** The kernels of a format, instantiated from its class
+ *  @var name       name on the command line
+ *  @var cellBytes  size of a cell
+ *  @var maxChannel value at which a channel saturates
+ *  @var deposit    adds to a channel of cell k
+ *  @var blend      adds RGBA8 deltas to a run of cells
+ *  @var toneMap    converts a run of cells to RGBA8
+ */
+typedef struct CellFormatKernels {
+	const char* name;
+	size_t cellBytes;
+	unsigned int maxChannel;
+	void (*deposit)(void* cells, size_t k, int channel, unsigned int amount);
+	void (*blend)(void* cells, const uint8_t* delta, size_t numCells);
+	void (*toneMap)(const void* cells, uint32_t* out, size_t numCells, float key);
+} CellFormatKernels;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static double nowSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static unsigned int nextRandom(unsigned int* seed)
+{
+	*seed = *seed * 1103515245u + 12345u;
+	return *seed >> 8;
+}
+
+template <class Format>
+static void depositKernel(void* cells, size_t k, int channel, unsigned int amount)
+{
+	Format::deposit((typename Format::Cell*) cells + k, channel, amount);
+}
+
+template <class Format>
+static void blendKernel(void* cells, const uint8_t* delta, size_t numCells)
+{
+	Format::blend((typename Format::Cell*) cells, delta, numCells);
+}
+
+template <class Format>
+static void toneMapKernel(const void* cells, uint32_t* out, size_t numCells, float key)
+{
+	Format::toneMap((const typename Format::Cell*) cells, out, numCells, key);
+}
+
+template <class Format>
+static constexpr CellFormatKernels kernelsOf(const char* name)
+{
+	return {name, sizeof(typename Format::Cell), Format::MAX_CHANNEL, depositKernel<Format>, blendKernel<Format>,
+			toneMapKernel<Format>};
+}
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+const CellFormatKernels CELL_FORMAT_KERNELS[NUM_CELL_FORMATS] = {
+	kernelsOf<Rgba8Format>("rgba8"), kernelsOf<Rgba16Format>("rgba16"), kernelsOf<FloatFormat>("float")
+};
+
+CellFormatID cellFormat = RGBA8_FORMAT;
+
+const CellFormatKernels* cellKernels = CELL_FORMAT_KERNELS;
+uint8_t* cellGridCells = NULL;
+size_t cellGridNumCells = 0;
+int cellGridNumCols = 0;
+float cellToneKey = 128.f;
+
+unsigned long cellToneMaps = 0;
+double cellToneMapSeconds = 0.;
+
+//	benchmark: deposits timed per format, and its passes over the grid
+const int BENCH_DEPOSITS = 1 << 22;
+const int BENCH_PASSES = 8;
+const int BENCH_AMOUNT = 16;
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+CellFormatID cellFormatFromName(const char* name)
+{
+	for (int k=0; k<NUM_CELL_FORMATS; k++)
+		if (strcmp(name, CELL_FORMAT_KERNELS[k].name) == 0)
+			return (CellFormatID) k;
+	return NUM_CELL_FORMATS;
+}
+
+size_t cellFormatCellBytes(CellFormatID format)
+{
+	return CELL_FORMAT_KERNELS[format].cellBytes;
+}
+
+void cellGridInitialize(CellFormatID format, void* cells, int numRows, int numCols, float toneKey)
+{
+	cellFormat = format;
+	cellKernels = CELL_FORMAT_KERNELS + format;
+	cellGridCells = (uint8_t*) cells;
+	cellGridNumCells = (size_t) numRows * numCols;
+	cellGridNumCols = numCols;
+	cellToneKey = toneKey;
+}
+
+void cellGridDeposit(int row, int col, int channel, unsigned int amount)
+{
+	cellKernels->deposit(cellGridCells, (size_t) row * cellGridNumCols + col, channel, amount);
+}
+
+void cellGridBlend(size_t firstCell, const uint8_t* delta, size_t numCells)
+{
+	cellKernels->blend(cellGridCells + firstCell * cellKernels->cellBytes, delta, numCells);
+}
+
+void cellGridClear(void)
+{
+	memset(cellGridCells, 0, cellGridNumCells * cellKernels->cellBytes);
+}
+
+void cellGridToneMap(uint32_t* out)
+{
+	double start = nowSeconds();
+	cellKernels->toneMap(cellGridCells, out, cellGridNumCells, cellToneKey);
+	cellToneMapSeconds += nowSeconds() - start;
+	cellToneMaps++;
+}
+
+void cellGridPrintReport(FILE* out)
+{
+	fprintf(out, "Cell format %s: %.1f MiB of accumulators (%zu bytes per cell, over the RGBA8 grid), "
+			"channels saturate at %u\n", cellKernels->name, cellGridNumCells * cellKernels->cellBytes / 1048576.,
+			cellKernels->cellBytes, cellKernels->maxChannel);
+	if (cellToneMaps > 0)
+		fprintf(out, "  %lu frames tone-mapped, %.2f ms each (%.1f M cells/s)\n", cellToneMaps,
+				cellToneMapSeconds / cellToneMaps * 1e3, cellToneMaps * cellGridNumCells / cellToneMapSeconds * 1e-6);
+}
+
+void cellFormatBenchmark(int numRows, int numCols, FILE* out)
+{
+	size_t numCells = (size_t) numRows * numCols;
+	vector<uint8_t> delta(numCells * 4);
+	vector<uint32_t> pixels(numCells);
+	unsigned int seed = 1;
+	for (size_t k=0; k<delta.size(); k++)
+		delta[k] = (k & 3) == 3 ? 0 : (uint8_t) (nextRandom(&seed) % 64);
+
+	fprintf(out, "Cell formats on a %d x %d grid (deposits of %d; tone key %.0f)\n", numRows, numCols, BENCH_AMOUNT,
+			cellToneKey);
+	fprintf(out, "  %-7s %6s %9s %10s %12s %14s %14s\n", "format", "bytes", "grid MiB", "saturates",
+			"deposits/s", "blend cells/s", "tone cells/s");
+	for (int f=0; f<NUM_CELL_FORMATS; f++)
+	{
+		const CellFormatKernels* kernels = CELL_FORMAT_KERNELS + f;
+		//	64-byte aligned, as the arena's blocks are
+		void* cells = aligned_alloc(64, (numCells * kernels->cellBytes + 63) & ~(size_t) 63);
+		memset(cells, 0, numCells * kernels->cellBytes);
+
+		//	random cells: one cache miss per deposit on a large grid
+		seed = 1;
+		double start = nowSeconds();
+		for (int k=0; k<BENCH_DEPOSITS; k++)
+		{
+			unsigned int r = nextRandom(&seed);
+			kernels->deposit(cells, r % numCells, (r >> 20) % 3, BENCH_AMOUNT);
+		}
+		double depositRate = BENCH_DEPOSITS / (nowSeconds() - start);
+
+		start = nowSeconds();
+		for (int pass=0; pass<BENCH_PASSES; pass++)
+			kernels->blend(cells, delta.data(), numCells);
+		double blendRate = BENCH_PASSES * numCells / (nowSeconds() - start);
+
+		start = nowSeconds();
+		for (int pass=0; pass<BENCH_PASSES; pass++)
+			kernels->toneMap(cells, pixels.data(), numCells, cellToneKey);
+		double toneRate = BENCH_PASSES * numCells / (nowSeconds() - start);
+
+		fprintf(out, "  %-7s %6zu %9.1f %10u %10.1f M %12.1f M %12.1f M\n", kernels->name, kernels->cellBytes,
+				numCells * kernels->cellBytes / 1048576., (kernels->maxChannel + BENCH_AMOUNT - 1) / BENCH_AMOUNT, depositRate * 1e-6, blendRate * 1e-6,
+				toneRate * 1e-6);
+		free(cells);
+	}
+	fprintf(out, "  (saturates: deposits before a channel is full; the wide formats also keep the RGBA8 grid)\n");
+}
@@ -0,0 +1,306 @@
+//
+//  cellFormat.h
+//  GL threads
+//
+//  Cell formats of the accumulation grid.  The grid's cells are packed
+//	RGBA8: with TRAV_INK_INCR = 16, a channel saturates after 16 deposits,
+//	and a long run ends up all white.  A wider format accumulates the same
+//	deposits in a grid of its own, with 16 bits per channel (4096
+//	deposits) or floats (exact up to 2^24); the front end and the viewers
+//	then see it through a tone mapping to RGBA8, computed only when a
+//	frame is published.  The RGBA8 grid is kept as it is, since the
+//	movement policies, the decay pass and the shards all read it.
+//
+//	Each format is a class of static members (as the traveler policies
+//	are): a deposit, a blend of an RGBA8 delta into a row of cells with
+//	saturation, and the tone mapping, vectorized with SSE2.  The kernels
+//	are instantiated for each format and picked once, at startup.
+//
+
+#ifndef CELL_FORMAT_H
+#define CELL_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+typedef enum CellFormatID {
+								RGBA8_FORMAT = 0,
+								RGBA16_FORMAT,
+								FLOAT_FORMAT,
+								//
+								NUM_CELL_FORMATS
+} CellFormatID;
+
+//	format of the accumulation grid (RGBA8: the grid itself, no other)
+extern CellFormatID cellFormat;
+
+/** Tone mapping of a channel value v: 255 v / (v + key), so that key maps
+ *	to mid-level and the channel only tends to 255
+ */
+static inline uint32_t toneMapChannel(float v, float key)
+{
+	return (uint32_t) (255.f * v / (v + key) + 0.5f);
+}
+
+#if defined(__SSE2__)
+//	the same, on 4 channels at once
+static inline __m128i toneMapChannels(__m128 v, __m128 key)
+{
+	__m128 mapped = _mm_mul_ps(_mm_set1_ps(255.f), _mm_div_ps(v, _mm_add_ps(v, key)));
+	return _mm_cvttps_epi32(_mm_add_ps(mapped, _mm_set1_ps(0.5f)));
+}
+#endif
+
+/** The current format: a channel per byte, red in the low byte.  Its tone
+ *	mapping is the identity.
+ */
+struct Rgba8Format {
+	typedef uint32_t Cell;
+	static constexpr CellFormatID ID = RGBA8_FORMAT;
+	static constexpr unsigned int MAX_CHANNEL = 0xFF;
+
+	static inline void deposit(Cell* cell, int channel, unsigned int amount)
+	{
+		int shift = 8 * channel;
+		unsigned int level = (*cell >> shift) & 0xFF;
+		level = level + amount < MAX_CHANNEL ? level + amount : MAX_CHANNEL;
+		*cell = (*cell & ~(0xFFU << shift)) | (level << shift);
+	}
+
+	static void blend(Cell* cells, const uint8_t* delta, size_t numCells)
+	{
+		size_t k = 0;
+#if defined(__SSE2__)
+		for (; k+4 <= numCells; k+=4)
+		{
+			__m128i c = _mm_loadu_si128((const __m128i*) (cells + k));
+			__m128i d = _mm_loadu_si128((const __m128i*) (delta + 4*k));
+			_mm_storeu_si128((__m128i*) (cells + k), _mm_adds_epu8(c, d));
+		}
+#endif
+		for (; k<numCells; k++)
+			for (int c=0; c<4; c++)
+				if (delta[4*k + c] != 0)
+					deposit(cells + k, c, delta[4*k + c]);
+	}
+
+	static void toneMap(const Cell* cells, uint32_t* out, size_t numCells, float)
+	{
+		size_t k = 0;
+#if defined(__SSE2__)
+		const __m128i opaque = _mm_set1_epi32((int) 0xFF000000);
+		for (; k+4 <= numCells; k+=4)
+			_mm_storeu_si128((__m128i*) (out + k), _mm_or_si128(_mm_loadu_si128((const __m128i*) (cells + k)), opaque));
+#endif
+		for (; k<numCells; k++)
+			out[k] = cells[k] | 0xFF000000;
+	}
+};
+
+/** 16 bits per channel
+ */
+struct Rgba16Format {
+	typedef struct Cell {
+		uint16_t channel[4];
+	} Cell;
+	static constexpr CellFormatID ID = RGBA16_FORMAT;
+	static constexpr unsigned int MAX_CHANNEL = 0xFFFF;
+
+	static inline void deposit(Cell* cell, int channel, unsigned int amount)
+	{
+		unsigned int level = cell->channel[channel] + amount;
+		cell->channel[channel] = (uint16_t) (level < MAX_CHANNEL ? level : MAX_CHANNEL);
+	}
+
+	//	each 16 bytes of delta widen to two vectors of 2 cells
+	static void blend(Cell* cells, const uint8_t* delta, size_t numCells)
+	{
+		size_t k = 0;
+#if defined(__SSE2__)
+		const __m128i zero = _mm_setzero_si128();
+		for (; k+4 <= numCells; k+=4)
+		{
+			__m128i d = _mm_loadu_si128((const __m128i*) (delta + 4*k));
+			__m128i* c = (__m128i*) (cells + k);
+			_mm_storeu_si128(c, _mm_adds_epu16(_mm_loadu_si128(c), _mm_unpacklo_epi8(d, zero)));
+			_mm_storeu_si128(c + 1, _mm_adds_epu16(_mm_loadu_si128(c + 1), _mm_unpackhi_epi8(d, zero)));
+		}
+#endif
+		for (; k<numCells; k++)
+			for (int c=0; c<4; c++)
+				deposit(cells + k, c, delta[4*k + c]);
+	}
+
+	static void toneMap(const Cell* cells, uint32_t* out, size_t numCells, float key)
+	{
+		size_t k = 0;
+#if defined(__SSE2__)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i opaque = _mm_set1_epi32((int) 0xFF000000);
+		const __m128 k4 = _mm_set1_ps(key);
+		for (; k+4 <= numCells; k+=4)
+		{
+			const __m128i* c = (const __m128i*) (cells + k);
+			__m128i lo = _mm_loadu_si128(c), hi = _mm_loadu_si128(c + 1);
+			//	one vector of 4 channels per cell, back to 4 cells of bytes
+			__m128i c0 = toneMapChannels(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), k4);
+			__m128i c1 = toneMapChannels(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), k4);
+			__m128i c2 = toneMapChannels(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), k4);
+			__m128i c3 = toneMapChannels(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), k4);
+			__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+			_mm_storeu_si128((__m128i*) (out + k), _mm_or_si128(bytes, opaque));
+		}
+#endif
+		for (; k<numCells; k++)
+		{
+			uint32_t pixel = 0xFF000000;
+			for (int c=0; c<3; c++)
+				pixel |= toneMapChannel(cells[k].channel[c], key) << (8 * c);
+			out[k] = pixel;
+		}
+	}
+};
+
+/** A float per channel.  Deposits are whole numbers, exact up to 2^24, at
+ *	which the channels saturate.
+ */
+struct FloatFormat {
+	typedef struct Cell {
+		float channel[4];
+	} Cell;
+	static constexpr CellFormatID ID = FLOAT_FORMAT;
+	static constexpr unsigned int MAX_CHANNEL = 1U << 24;
+
+	static inline void deposit(Cell* cell, int channel, unsigned int amount)
+	{
+		float level = cell->channel[channel] + (float) amount;
+		cell->channel[channel] = level < (float) MAX_CHANNEL ? level : (float) MAX_CHANNEL;
+	}
+
+	//	each 16 bytes of delta widen to four vectors of 1 cell
+	static void blend(Cell* cells, const uint8_t* delta, size_t numCells)
+	{
+		size_t k = 0;
+#if defined(__SSE2__)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 cap = _mm_set1_ps((float) MAX_CHANNEL);
+		for (; k+4 <= numCells; k+=4)
+		{
+			__m128i d = _mm_loadu_si128((const __m128i*) (delta + 4*k));
+			__m128i d16[2] = {_mm_unpacklo_epi8(d, zero), _mm_unpackhi_epi8(d, zero)};
+			for (int h=0; h<2; h++)
+			{
+				float* lo = cells[k + 2*h].channel;
+				float* hi = cells[k + 2*h + 1].channel;
+				__m128 add = _mm_cvtepi32_ps(_mm_unpacklo_epi16(d16[h], zero));
+				_mm_storeu_ps(lo, _mm_min_ps(_mm_add_ps(_mm_loadu_ps(lo), add), cap));
+				add = _mm_cvtepi32_ps(_mm_unpackhi_epi16(d16[h], zero));
+				_mm_storeu_ps(hi, _mm_min_ps(_mm_add_ps(_mm_loadu_ps(hi), add), cap));
+			}
+		}
+#endif
+		for (; k<numCells; k++)
+			for (int c=0; c<4; c++)
+				deposit(cells + k, c, delta[4*k + c]);
+	}
+
+	static void toneMap(const Cell* cells, uint32_t* out, size_t numCells, float key)
+	{
+		size_t k = 0;
+#if defined(__SSE2__)
+		const __m128i opaque = _mm_set1_epi32((int) 0xFF000000);
+		const __m128 k4 = _mm_set1_ps(key);
+		for (; k+4 <= numCells; k+=4)
+		{
+			__m128i c0 = toneMapChannels(_mm_loadu_ps(cells[k].channel), k4);
+			__m128i c1 = toneMapChannels(_mm_loadu_ps(cells[k+1].channel), k4);
+			__m128i c2 = toneMapChannels(_mm_loadu_ps(cells[k+2].channel), k4);
+			__m128i c3 = toneMapChannels(_mm_loadu_ps(cells[k+3].channel), k4);
+			__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+			_mm_storeu_si128((__m128i*) (out + k), _mm_or_si128(bytes, opaque));
+		}
+#endif
+		for (; k<numCells; k++)
+		{
+			uint32_t pixel = 0xFF000000;
+			for (int c=0; c<3; c++)
+				pixel |= toneMapChannel(cells[k].channel[c], key) << (8 * c);
+			out[k] = pixel;
+		}
+	}
+};
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Looks up a format by name (rgba8, rgba16, float)
+ *  @param name     name of the format
+ *  @return the format (NUM_CELL_FORMATS if the name is unknown)
+ */
+CellFormatID cellFormatFromName(const char* name);
+
+/** Bytes of a cell of the accumulation grid
+ *  @param format   the format
+ *  @return the size of its cells
+ */
+size_t cellFormatCellBytes(CellFormatID format);
+
+/** Sets up the accumulation grid of a wide format (RGBA8: nothing to do)
+ *  @param format   format of the grid
+ *  @param cells    zero-filled block of numRows x numCols cells
+ *  @param numRows  number of rows
+ *  @param numCols  number of columns
+ *  @param toneKey  channel value shown at mid-level
+ */
+void cellGridInitialize(CellFormatID format, void* cells, int numRows, int numCols, float toneKey);
+
+/** Adds a deposit to the accumulation grid.  The caller holds the lock of
+ *	whoever writes the grid.
+ *  @param row      cell row
+ *  @param col      cell column
+ *  @param channel  0: red, 1: green, 2: blue
+ *  @param amount   amount added
+ */
+void cellGridDeposit(int row, int col, int channel, unsigned int amount);
+
+/** Adds a run of RGBA8 deltas (the paint buffers' merge) to the grid
+ *  @param firstCell    index of the first cell (row * numCols + col)
+ *  @param delta        4 bytes per cell
+ *  @param numCells     number of cells
+ */
+void cellGridBlend(size_t firstCell, const uint8_t* delta, size_t numCells);
+
+/** Clears the accumulation grid
+ */
+void cellGridClear(void);
+
+/** Tone-maps the whole accumulation grid to RGBA8.  Runs without a lock:
+ *	a cell read in the middle of a deposit shows some channels one
+ *	deposit older than the others.
+ *  @param out      numRows x numCols pixels
+ */
+void cellGridToneMap(uint32_t* out);
+
+/** Prints the format, its memory and the time spent tone-mapping
+ *  @param out      output stream
+ */
+void cellGridPrintReport(FILE* out);
+
+/** Times deposits, blends and tone mapping of each format on an
+ *	r x c grid, and prints them with the memory of each
+ *  @param numRows  number of rows
+ *  @param numCols  number of columns
+ *  @param out      output stream
+ */
+void cellFormatBenchmark(int numRows, int numCols, FILE* out);
+
+#endif // CELL_FORMAT_H
@@ -0,0 +1,266 @@
+//
+//  cellOccupancy.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <algorithm>
+#include <time.h>
+#include <pthread.h>
+//
+#include "cellOccupancy.h"
+#include "travelerPolicies.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+//	a traveler of the benchmark
+typedef struct BenchWalker {
+	int row;
+	int col;
+	TravelDirection dir;
+	int distance;
+	int waits;
+} BenchWalker;
+
+typedef struct OccupancyBenchThread {
+	int first;
+	int stride;
+	unsigned long moves;
+	unsigned long blocked;
+	unsigned long detours;
+} OccupancyBenchThread;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+//	owner words, numRows x numCols: 0 if free, traveler index + 1 otherwise
+uint32_t* occupancyOwners = NULL;
+int occupancyRows = 0, occupancyCols = 0;
+
+atomic<unsigned long> occupancyBlocked(0);
+atomic<unsigned long> occupancyDetours(0);
+
+//	densities of the benchmark (share of the cells holding a traveler)
+const double OCCUPANCY_BENCH_DENSITY[] = {0.01, 0.05, 0.10, 0.25, 0.50};
+const int OCCUPANCY_BENCH_NUM_DENSITIES = sizeof(OCCUPANCY_BENCH_DENSITY) / sizeof(double);
+const double OCCUPANCY_BENCH_SECONDS = 0.5;
+
+BenchWalker* benchWalkers = NULL;
+int benchNumWalkers = 0;
+atomic<bool> occupancyBenchStop(false);
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static bool atCorner(int row, int col)
+{
+	return (row == 0 || row == occupancyRows-1) && (col == 0 || col == occupancyCols-1);
+}
+
+//	A walker in a random free cell, heading somewhere
+static void placeWalker(BenchWalker* walker, unsigned int owner, const PolicyGrid* g)
+{
+	walker->row = 1 + policyRandom() % (occupancyRows-1);
+	walker->col = 1 + policyRandom() % (occupancyCols-1);
+	if (!occupancyClaimFrom(&walker->row, &walker->col, 1, occupancyRows, owner))
+	{
+		fprintf(stderr, "occupancy benchmark: no free cell\n");
+		exit(EXIT_FAILURE);
+	}
+	walker->dir = RandomTurnPolicy::turn<ColorPolicy<RED_TRAV> >(g, walker->col, walker->row,
+												static_cast<TravelDirection>(policyRandom() % NUM_TRAVEL_DIRECTIONS));
+	walker->distance = RandomTurnPolicy::distance(g, walker->col, walker->row, walker->dir);
+	walker->waits = 0;
+}
+
+//	Steps the thread's walkers in turn, as the traveler threads do, minus
+//	the sleeps and the ink
+static void* benchThread(void* data)
+{
+	OccupancyBenchThread* info = static_cast<OccupancyBenchThread*>(data);
+	const PolicyGrid g = {NULL, occupancyRows, occupancyCols};
+	unsigned long moves = 0, blocked = 0, detours = 0;
+	while (!occupancyBenchStop.load(memory_order_relaxed))
+	{
+		for (int k=info->first; k<benchNumWalkers; k+=info->stride)
+		{
+			BenchWalker* walker = benchWalkers + k;
+			int row = walker->row + (walker->dir == SOUTH) - (walker->dir == NORTH);
+			int col = walker->col + (walker->dir == EAST) - (walker->dir == WEST);
+			if (!occupancyClaim(row, col, k))
+			{
+				blocked++;
+				if (++walker->waits == OCCUPANCY_MAX_WAITS)
+				{
+					detours++;
+					walker->dir = RandomTurnPolicy::turn<ColorPolicy<RED_TRAV> >(&g, walker->col, walker->row, walker->dir);
+					walker->distance = RandomTurnPolicy::distance(&g, walker->col, walker->row, walker->dir);
+					walker->waits = 0;
+				}
+				continue;
+			}
+			occupancyRelease(walker->row, walker->col, k);
+			walker->row = row;
+			walker->col = col;
+			walker->waits = 0;
+			moves++;
+			if (atCorner(row, col))
+			{
+				occupancyRelease(row, col, k);
+				placeWalker(walker, k, &g);
+			}
+			else if (--walker->distance == 0)
+			{
+				walker->dir = RandomTurnPolicy::turn<ColorPolicy<RED_TRAV> >(&g, col, row, walker->dir);
+				walker->distance = RandomTurnPolicy::distance(&g, col, row, walker->dir);
+			}
+		}
+	}
+	info->moves = moves;
+	info->blocked = blocked;
+	info->detours = detours;
+	return NULL;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void occupancyInitialize(int numRows, int numCols)
+{
+	occupancyRows = numRows;
+	occupancyCols = numCols;
+	occupancyOwners = (uint32_t*) calloc((size_t) numRows * numCols, sizeof(uint32_t));
+	if (occupancyOwners == NULL)
+	{
+		fprintf(stderr, "could not allocate the occupancy grid\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void occupancyFree(void)
+{
+	free(occupancyOwners);
+	occupancyOwners = NULL;
+}
+
+bool occupancyClaim(int row, int col, unsigned int owner)
+{
+	uint32_t* word = occupancyOwners + (size_t) row * occupancyCols + col;
+	uint32_t expected = 0;
+	if (__atomic_compare_exchange_n(word, &expected, owner + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return true;
+	return expected == owner + 1;
+}
+
+void occupancyRelease(int row, int col, unsigned int owner)
+{
+	uint32_t* word = occupancyOwners + (size_t) row * occupancyCols + col;
+	uint32_t expected = owner + 1;
+	__atomic_compare_exchange_n(word, &expected, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+bool occupancyClaimFrom(int* row, int* col, int firstRow, int endRow, unsigned int owner)
+{
+	int numRows = endRow - firstRow, numCols = occupancyCols - 1;
+	if (numRows <= 0 || numCols <= 0)
+		return false;
+	int start = (*row - firstRow) * numCols + (*col - 1);
+	for (int k=0; k<numRows * numCols; k++)
+	{
+		int cell = (start + k) % (numRows * numCols);
+		if (occupancyClaim(firstRow + cell / numCols, 1 + cell % numCols, owner))
+		{
+			*row = firstRow + cell / numCols;
+			*col = 1 + cell % numCols;
+			return true;
+		}
+	}
+	return false;
+}
+
+void occupancyRecordBlocked(void)
+{
+	occupancyBlocked.fetch_add(1, memory_order_relaxed);
+}
+
+void occupancyRecordDetour(void)
+{
+	occupancyDetours.fetch_add(1, memory_order_relaxed);
+}
+
+void occupancyPrintReport(FILE* out, unsigned long moves, int numLiveTravelers)
+{
+	unsigned long blocked = occupancyBlocked.load(), detours = occupancyDetours.load();
+	size_t numCells = (size_t) occupancyRows * occupancyCols, occupied = 0;
+	for (size_t k=0; k<numCells; k++)
+		occupied += __atomic_load_n(occupancyOwners + k, __ATOMIC_RELAXED) != 0;
+	fprintf(out, "Exclusive cells: %lu moves, %lu blocked (%.2f%% of attempts), %lu detours\n", moves, blocked,
+			moves + blocked > 0 ? 100. * blocked / (moves + blocked) : 0., detours);
+	fprintf(out, "  %zu cells occupied for %d live travelers (density %.2f%%)\n", occupied, numLiveTravelers,
+			100. * occupied / numCells);
+}
+
+void occupancyBenchmark(int numRows, int numCols, int numThreads, FILE* out)
+{
+	occupancyInitialize(numRows, numCols);
+	const PolicyGrid g = {NULL, numRows, numCols};
+	size_t numCells = (size_t) numRows * numCols;
+	benchWalkers = (BenchWalker*) malloc(numCells * sizeof(BenchWalker));
+	OccupancyBenchThread* info = new OccupancyBenchThread[numThreads];
+	pthread_t* threads = new pthread_t[numThreads];
+
+	fprintf(out, "Occupancy benchmark: %dx%d grid, %d threads, %.1f s per density\n", numRows, numCols,
+			numThreads, OCCUPANCY_BENCH_SECONDS);
+	for (int d=0; d<OCCUPANCY_BENCH_NUM_DENSITIES; d++)
+	{
+		for (size_t k=0; k<numCells; k++)
+			occupancyOwners[k] = 0;
+		benchNumWalkers = max(1, (int) (OCCUPANCY_BENCH_DENSITY[d] * (numRows-1) * (numCols-1)));
+		for (int k=0; k<benchNumWalkers; k++)
+			placeWalker(benchWalkers + k, k, &g);
+
+		occupancyBenchStop = false;
+		for (int t=0; t<numThreads; t++)
+		{
+			info[t].first = t;
+			info[t].stride = numThreads;
+			if (pthread_create(threads + t, nullptr, benchThread, info + t) != 0)
+			{
+				fprintf(stderr, "could not create benchmark thread %d\n", t);
+				exit(EXIT_FAILURE);
+			}
+		}
+		struct timespec delay;
+		delay.tv_sec = (time_t) OCCUPANCY_BENCH_SECONDS;
+		delay.tv_nsec = (long) ((OCCUPANCY_BENCH_SECONDS - delay.tv_sec) * 1e9);
+		nanosleep(&delay, NULL);
+		occupancyBenchStop = true;
+
+		unsigned long moves = 0, blocked = 0, detours = 0;
+		for (int t=0; t<numThreads; t++)
+		{
+			pthread_join(threads[t], NULL);
+			moves += info[t].moves;
+			blocked += info[t].blocked;
+			detours += info[t].detours;
+		}
+		fprintf(out, "  density %5.1f%% %8d travelers %8.2f M moves/s   blocked %5.1f%% of attempts %10lu detours\n",
+				100. * OCCUPANCY_BENCH_DENSITY[d], benchNumWalkers, moves / OCCUPANCY_BENCH_SECONDS * 1e-6,
+				moves + blocked > 0 ? 100. * blocked / (moves + blocked) : 0., detours);
+	}
+
+	delete [] threads;
+	delete [] info;
+	free(benchWalkers);
+	occupancyFree();
+}
@@ -0,0 +1,87 @@
+//
+//  cellOccupancy.h
+//  GL threads
+//
+//  Exclusive cells: at most one traveler per cell.  Each cell has an owner
+//	word (0 when free, the traveler's index + 1 otherwise) that a traveler
+//	claims with a compare-and-swap before it steps in, and releases once it
+//	has stepped out.  A traveler holds the cell it stands on and tries for
+//	the one ahead, never waiting on a second claim: when the cell ahead
+//	stays taken for OCCUPANCY_MAX_WAITS tries, it gives up and detours, so
+//	travelers that block each other (head to head, or in a cycle) cannot
+//	deadlock.
+//
+
+#ifndef CELL_OCCUPANCY_H
+#define CELL_OCCUPANCY_H
+
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+//	failed claims of the same cell before the traveler detours
+const int OCCUPANCY_MAX_WAITS = 4;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Allocates the owner words, all cells free
+ *  @param numRows  grid rows
+ *  @param numCols  grid columns
+ */
+void occupancyInitialize(int numRows, int numCols);
+
+void occupancyFree(void);
+
+/** Claims a cell for a traveler (lock-free, never waits)
+ *  @param row      cell row
+ *  @param col      cell col
+ *  @param owner    index of the traveler
+ *  @return true if the cell was free (or already the traveler's)
+ */
+bool occupancyClaim(int row, int col, unsigned int owner);
+
+/** Releases a cell held by a traveler
+ *  @param row      cell row
+ *  @param col      cell col
+ *  @param owner    index of the traveler
+ */
+void occupancyRelease(int row, int col, unsigned int owner);
+
+/** Claims the first free cell of a band of rows, from (row, col) on, row
+ *	after row and wrapping around (columns 1 and up, as travelers spawn)
+ *  @param row      in: first cell tried, out: cell claimed
+ *  @param col      in: first cell tried, out: cell claimed
+ *  @param firstRow first row of the band
+ *  @param endRow   row after the band
+ *  @param owner    index of the traveler
+ *  @return false if every cell of the band is taken
+ */
+bool occupancyClaimFrom(int* row, int* col, int firstRow, int endRow, unsigned int owner);
+
+//	counters of the report
+void occupancyRecordBlocked(void);
+void occupancyRecordDetour(void);
+
+/** Prints the blocked-move rate and detours, and checks the owner words
+ *	against the live travelers
+ *  @param out              output stream
+ *  @param moves            cells moved by all travelers
+ *  @param numLiveTravelers live travelers
+ */
+void occupancyPrintReport(FILE* out, unsigned long moves, int numLiveTravelers);
+
+/** Walks more and more travelers (1% to 50% of the cells) on a private
+ *	grid, without sleeps or ink, and prints the throughput and the share of
+ *	blocked moves at each density
+ *  @param numRows      rows of the grid
+ *  @param numCols      columns of the grid
+ *  @param numThreads   threads sharing the travelers
+ *  @param out          output stream
+ */
+void occupancyBenchmark(int numRows, int numCols, int numThreads, FILE* out);
+
+#endif // CELL_OCCUPANCY_H
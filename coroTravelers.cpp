@@ -0,0 +1,305 @@
+//
+//  coroTravelers.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+//
+#include "coroTravelers.h"
+#include "timingWheel.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//	Simulation functions and settings (main.cpp)
+//---------------------------------------------------------------------------
+
+extern int NUM_ROWS, NUM_COLS;
+extern int numLiveThreads;
+extern int travelerSleepTime;
+
+bool getInk(TravelerType type);
+void advanceTraveler(TravelerInfo* tt, unsigned int index);
+void storeTraveler(unsigned int index, const TravelerInfo* tt);
+void loadTraveler(unsigned int index, TravelerInfo* tt);
+TravelDirection generateDirection(int col, int row, TravelDirection dir);
+unsigned newDistance(int col, int row, TravelDirection dir);
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+typedef chrono::steady_clock Clock;
+typedef pair<Clock::time_point, coroutine_handle<> > TimerEntry;
+
+//	earliest deadline on top
+struct LaterDeadline {
+	bool operator()(const TimerEntry& a, const TimerEntry& b) const
+	{
+		return a.first > b.first;
+	}
+};
+
+//	Executor: the ready queue and the timer queue share one lock.
+//	The executor threads are still running when the application calls
+//	exit(), so these objects are never destroyed.
+mutex& execLock = *new mutex;
+condition_variable& execCond = *new condition_variable;
+deque<coroutine_handle<> >& readyQueue = *new deque<coroutine_handle<> >;
+priority_queue<TimerEntry, vector<TimerEntry>, LaterDeadline>& timerQueue =
+	*new priority_queue<TimerEntry, vector<TimerEntry>, LaterDeadline>;
+int coroNumWorkers = 0;
+
+//	travelers waiting for ink, per color
+mutex* inkWaitLock = new mutex[NUM_TRAV_TYPES];
+deque<coroutine_handle<> >* inkWaiters = new deque<coroutine_handle<> >[NUM_TRAV_TYPES];
+
+atomic<unsigned long> coroStarted(0);
+atomic<unsigned long> coroFinished(0);
+atomic<unsigned long> coroInkWaits(0);
+atomic<unsigned long> coroTimerWaits(0);
+atomic<size_t> coroFrameBytes(0);
+
+//---------------------------------------------------------------------------
+//  Executor
+//---------------------------------------------------------------------------
+
+static void schedule(coroutine_handle<> handle)
+{
+	{
+		lock_guard<mutex> lock(execLock);
+		readyQueue.push_back(handle);
+	}
+	execCond.notify_one();
+}
+
+static void scheduleAt(Clock::time_point deadline, coroutine_handle<> handle)
+{
+	bool earliest;
+	{
+		lock_guard<mutex> lock(execLock);
+		earliest = timerQueue.empty() || deadline < timerQueue.top().first;
+		timerQueue.push(TimerEntry(deadline, handle));
+	}
+	//	only a new earliest deadline changes what the idle workers wait for
+	if (earliest)
+		execCond.notify_one();
+}
+
+static void executorWorker(void)
+{
+	unique_lock<mutex> lock(execLock);
+	while (true)
+	{
+		Clock::time_point now = Clock::now();
+		while (!timerQueue.empty() && timerQueue.top().first <= now)
+		{
+			readyQueue.push_back(timerQueue.top().second);
+			timerQueue.pop();
+		}
+
+		if (!readyQueue.empty())
+		{
+			coroutine_handle<> handle = readyQueue.front();
+			readyQueue.pop_front();
+			lock.unlock();
+			//	Once resumed, the coroutine may be queued and resumed again by
+			//	another worker (or finish and free itself): don't touch it.
+			handle.resume();
+			lock.lock();
+		}
+		else if (!timerQueue.empty())
+			execCond.wait_until(lock, timerQueue.top().first);
+		else
+			execCond.wait(lock);
+	}
+}
+
+//---------------------------------------------------------------------------
+//  Coroutine type and awaitables
+//---------------------------------------------------------------------------
+
+//	A traveler coroutine.  It starts suspended (the executor starts it) and
+//	frees its own frame when it completes.
+struct TravelerTask {
+	struct promise_type {
+		TravelerTask get_return_object()
+		{
+			return TravelerTask{coroutine_handle<promise_type>::from_promise(*this)};
+		}
+		suspend_always initial_suspend() noexcept { return {}; }
+		suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { terminate(); }
+
+		static void* operator new(size_t size)
+		{
+			coroFrameBytes.store(size, memory_order_relaxed);
+			return ::operator new(size);
+		}
+		static void operator delete(void* ptr)
+		{
+			::operator delete(ptr);
+		}
+	};
+
+	coroutine_handle<promise_type> handle;
+};
+
+//	co_await InkAwaitable(type) is true if one unit of ink was taken.  If
+//	the tank is empty, the traveler waits for a refill of its color, and
+//	the co_await is false: try again.
+struct InkAwaitable {
+	TravelerType type;
+	bool acquired;
+
+	explicit InkAwaitable(TravelerType theType) : type(theType), acquired(false) {}
+
+	bool await_ready()
+	{
+		acquired = getInk(type);
+		return acquired;
+	}
+
+	bool await_suspend(coroutine_handle<> handle)
+	{
+		//	Retry under the waiters' lock: a refill made since await_ready
+		//	either shows up here, or its notification will find us queued.
+		lock_guard<mutex> lock(inkWaitLock[type]);
+		acquired = getInk(type);
+		if (acquired)
+			return false;
+		inkWaiters[type].push_back(handle);
+		coroInkWaits.fetch_add(1, memory_order_relaxed);
+		return true;
+	}
+
+	bool await_resume() { return acquired; }
+};
+
+//	wheel callback: the timer's argument is the sleeping coroutine
+static void resumeFromWheel(void* address)
+{
+	schedule(coroutine_handle<>::from_address(address));
+}
+
+//	co_await SleepAwaitable(us) resumes the traveler after us microseconds
+//	(0: just yields to the other travelers).  When the timing wheel runs,
+//	the timer lives in the awaitable, i.e. in the coroutine frame.
+struct SleepAwaitable {
+	long delay;
+	WheelTimer timer;
+
+	explicit SleepAwaitable(long theDelay) : delay(theDelay) {}
+
+	bool await_ready() { return false; }
+
+	void await_suspend(coroutine_handle<> handle)
+	{
+		if (delay <= 0)
+			schedule(handle);
+		else
+		{
+			coroTimerWaits.fetch_add(1, memory_order_relaxed);
+			if (timingWheelRunning())
+				timingWheelSchedule(&timer, delay, resumeFromWheel, handle.address());
+			else
+				scheduleAt(Clock::now() + chrono::microseconds(delay), handle);
+		}
+	}
+
+	void await_resume() {}
+};
+
+//---------------------------------------------------------------------------
+//  Traveler coroutine
+//---------------------------------------------------------------------------
+
+static bool isCorner(int col, int row)
+{
+	return (col == 0 || col == NUM_COLS-1) && (row == 0 || row == NUM_ROWS-1);
+}
+
+/** Same behavior as runTravelerThread with random turns, written
+ *	sequentially.  Like the threads, the coroutine works on a copy of its
+ *	traveler (in its frame) and publishes it after each step.
+ *  @param index    index of the traveler
+ */
+static TravelerTask travelerCoroutine(unsigned int index)
+{
+	TravelerInfo traveler;
+	TravelerInfo* tt = &traveler;
+	loadTraveler(index, tt);
+	tt->dir = generateDirection(tt->col, tt->row, travelerDir(tt));
+	while (!isCorner(tt->col, tt->row))
+	{
+		tt->distance = newDistance(tt->col, tt->row, travelerDir(tt));
+		for (int i=0; i<tt->distance; i++)
+		{
+			while (!co_await InkAwaitable(travelerType(tt)))
+				;
+			advanceTraveler(tt, index);
+			co_await SleepAwaitable(travelerSleepTime);
+		}
+		tt->dir = generateDirection(tt->col, tt->row, travelerDir(tt));
+	}
+
+	tt->isLive = false;
+	storeTraveler(index, tt);
+	__atomic_fetch_sub(&numLiveThreads, 1, __ATOMIC_RELAXED);
+	coroFinished.fetch_add(1, memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void coroStartTravelers(int numTravelers, int numWorkers)
+{
+	{
+		lock_guard<mutex> lock(execLock);
+		for (int k=0; k<numTravelers; k++)
+			readyQueue.push_back(travelerCoroutine(k).handle);
+	}
+	coroStarted = numTravelers;
+
+	coroNumWorkers = numWorkers;
+	for (int k=0; k<numWorkers; k++)
+		thread(executorWorker).detach();
+}
+
+void coroNotifyInk(TravelerType type, int amount)
+{
+	//	each unit refilled can satisfy one waiter
+	vector<coroutine_handle<> > woken;
+	{
+		lock_guard<mutex> lock(inkWaitLock[type]);
+		while (amount-- > 0 && !inkWaiters[type].empty())
+		{
+			woken.push_back(inkWaiters[type].front());
+			inkWaiters[type].pop_front();
+		}
+	}
+	for (unsigned int k=0; k<woken.size(); k++)
+		schedule(woken[k]);
+}
+
+void coroPrintReport(FILE* out)
+{
+	fprintf(out, "Coroutine travelers: %lu started, %lu finished, %d executor thread%s\n",
+			coroStarted.load(), coroFinished.load(), coroNumWorkers, coroNumWorkers > 1 ? "s" : "");
+	fprintf(out, "  frame size %zu bytes + %zu bytes of traveler info per traveler\n",
+			coroFrameBytes.load(), sizeof(TravelerInfo));
+	fprintf(out, "  ink waits %lu, timer waits %lu\n", coroInkWaits.load(), coroTimerWaits.load());
+}
@@ -0,0 +1,42 @@
+//
+//  coroTravelers.h
+//  GL threads
+//
+//  Coroutine execution mode for the travelers.  Each traveler is a C++20
+//	coroutine that reads like the thread version ("get ink, move, sleep,
+//	repeat") but co_awaits its ink and its step delay instead of blocking.
+//	All the coroutines run on a small executor: a few worker threads, a
+//	ready queue, and a timer queue.  A suspended traveler costs its
+//	coroutine frame (a few hundred bytes) instead of a thread stack.
+//
+
+#ifndef CORO_TRAVELERS_H
+#define CORO_TRAVELERS_H
+
+#include <cstdio>
+//
+#include "gl_frontEnd.h"
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Starts the executor and one coroutine per traveler of the traveler table
+ *  @param numTravelers number of travelers
+ *  @param numWorkers   executor threads
+ */
+void coroStartTravelers(int numTravelers, int numWorkers);
+
+/** Wakes up travelers waiting for ink of a given color.  Called after
+ *	every successful refill.
+ *  @param type         color of the ink refilled
+ *  @param amount       units refilled (at most that many travelers wake up)
+ */
+void coroNotifyInk(TravelerType type, int amount);
+
+/** Prints the executor counters and the coroutine frame size
+ *  @param out          output stream
+ */
+void coroPrintReport(FILE* out);
+
+#endif // CORO_TRAVELERS_H
@@ -0,0 +1,400 @@
+//
+//  decayPass.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+//
+#include "decayPass.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+//	A tile is TILE_ROWS rows of TILE_COLS cells.  Its commit (the only part
+//	of the pass that holds the grid's lock) touches 16 KB.
+const int TILE_ROWS = 16;
+const int TILE_COLS = 256;
+
+//	the passes of the pool
+typedef enum DecayPhase {
+	SNAPSHOT_PHASE = 0,
+	KERNEL_PHASE
+} DecayPhase;
+
+//	cells are 0xAABBGGRR: the alpha byte never fades
+const uint32_t ALPHA_MASK = 0xFF000000;
+
+uint32_t* decayCells = NULL;
+uint32_t* decaySnapshot = NULL;
+int decayNumRows = 0, decayNumCols = 0;
+int decayNumTiles = 0, decayTilesPerRow = 0;
+pthread_mutex_t* decayCommitLock = NULL;
+AdaptiveLock* decayAdaptiveLock = NULL;
+
+//	The kernel computes new = ((sum << decayShiftIn) * decayFade16) >> 24,
+//	with sum the channel (no blur) or 4 x the channel + its 4 neighbours
+bool decayBlur = false;
+uint16_t decayFade16 = 65535;
+int decayShiftIn = 8;
+double decayFade = 1.;
+int decayIntervalMs = 0;
+
+//	worker pool: each phase is a generation, its tiles are handed out by
+//	an atomic counter
+pthread_mutex_t decay_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t decayWorkCond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t decayDoneCond = PTHREAD_COND_INITIALIZER;
+unsigned long decayGeneration = 0;
+DecayPhase decayPhase = SNAPSHOT_PHASE;
+atomic<int> decayNextTile(0);
+int decayWorkersDone = 0;
+int decayNumWorkers = 0;
+//	one pass at a time
+pthread_mutex_t decay_pass_lock = PTHREAD_MUTEX_INITIALIZER;
+
+unsigned long decayPasses = 0;
+double decaySnapshotSeconds = 0.;
+double decayKernelSeconds = 0.;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static double nowSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+//	one channel, scalar version of the kernel
+static uint32_t fadeChannel(unsigned int sum)
+{
+	return (uint32_t) ((((sum << decayShiftIn) * (uint32_t) decayFade16) >> 16) >> 8);
+}
+
+static uint32_t kernelCell(const uint32_t* row, const uint32_t* up, const uint32_t* down, int col)
+{
+	int left = max(col - 1, 0), right = min(col + 1, decayNumCols - 1);
+	uint32_t result = 0;
+	for (int shift=0; shift<24; shift+=8)
+	{
+		unsigned int sum = (row[col] >> shift) & 0xFF;
+		if (decayBlur)
+			sum = 4 * sum + ((up[col] >> shift) & 0xFF) + ((down[col] >> shift) & 0xFF) +
+				  ((row[left] >> shift) & 0xFF) + ((row[right] >> shift) & 0xFF);
+		result |= fadeChannel(sum) << shift;
+	}
+	return result;
+}
+
+#if defined(__SSE2__)
+//	the kernel on 8 channels widened to 16 bits
+static inline __m128i kernelHalf(__m128i center, __m128i up, __m128i down, __m128i left, __m128i right,
+								 __m128i fade, __m128i shiftIn)
+{
+	__m128i sum = center;
+	if (decayBlur)
+		sum = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(center, 2), _mm_add_epi16(up, down)),
+							_mm_add_epi16(left, right));
+	return _mm_srli_epi16(_mm_mulhi_epu16(_mm_sll_epi16(sum, shiftIn), fade), 8);
+}
+#endif
+
+/** Computes the new colors of a span of a row from the snapshot
+ *  @param out          new colors
+ *  @param row          snapshot row, with the rows above and below (the row
+ *                      itself on the border)
+ *  @param first, end   columns
+ */
+static void kernelSpan(uint32_t* out, const uint32_t* row, const uint32_t* up, const uint32_t* down,
+					   int first, int end)
+{
+	int col = first;
+#if defined(__SSE2__)
+	__m128i zero = _mm_setzero_si128();
+	__m128i fade = _mm_set1_epi16((short) decayFade16);
+	__m128i shiftIn = _mm_cvtsi32_si128(decayShiftIn);
+	//	scalar on the first column, whose left neighbour is itself
+	for (; col < end && col < 1; col++)
+		out[col - first] = kernelCell(row, up, down, col);
+	//	4 cells at a time while the right neighbours exist
+	for (; col + 4 <= end && col + 4 < decayNumCols; col += 4)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i*) (row + col));
+		__m128i u = decayBlur ? _mm_loadu_si128((const __m128i*) (up + col)) : zero;
+		__m128i d = decayBlur ? _mm_loadu_si128((const __m128i*) (down + col)) : zero;
+		__m128i l = decayBlur ? _mm_loadu_si128((const __m128i*) (row + col - 1)) : zero;
+		__m128i r = decayBlur ? _mm_loadu_si128((const __m128i*) (row + col + 1)) : zero;
+		__m128i lo = kernelHalf(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(u, zero), _mm_unpacklo_epi8(d, zero),
+								_mm_unpacklo_epi8(l, zero), _mm_unpacklo_epi8(r, zero), fade, shiftIn);
+		__m128i hi = kernelHalf(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(u, zero), _mm_unpackhi_epi8(d, zero),
+								_mm_unpackhi_epi8(l, zero), _mm_unpackhi_epi8(r, zero), fade, shiftIn);
+		_mm_storeu_si128((__m128i*) (out + col - first), _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for (; col < end; col++)
+		out[col - first] = kernelCell(row, up, down, col);
+}
+
+/** cell = new + (cell - snapshot), with saturation: whatever was deposited
+ *	since the snapshot is kept
+ */
+static void commitSpan(uint32_t* cells, const uint32_t* snapshot, const uint32_t* newCells, int numCells)
+{
+	int k = 0;
+#if defined(__SSE2__)
+	__m128i alpha = _mm_set1_epi32((int) ALPHA_MASK);
+	for (; k+4 <= numCells; k+=4)
+	{
+		__m128i cur = _mm_loadu_si128((const __m128i*) (cells + k));
+		__m128i snap = _mm_loadu_si128((const __m128i*) (snapshot + k));
+		__m128i fresh = _mm_loadu_si128((const __m128i*) (newCells + k));
+		__m128i result = _mm_adds_epu8(fresh, _mm_subs_epu8(cur, snap));
+		_mm_storeu_si128((__m128i*) (cells + k), _mm_or_si128(result, alpha));
+	}
+#endif
+	for (; k<numCells; k++)
+	{
+		uint32_t result = 0;
+		for (int shift=0; shift<24; shift+=8)
+		{
+			int cur = (cells[k] >> shift) & 0xFF, snap = (snapshot[k] >> shift) & 0xFF;
+			int fresh = (newCells[k] >> shift) & 0xFF;
+			result |= (uint32_t) min(255, fresh + max(0, cur - snap)) << shift;
+		}
+		cells[k] = result | ALPHA_MASK;
+	}
+}
+
+static void runTile(DecayPhase phase, int tile, uint32_t* scratch)
+{
+	int firstRow = (tile / decayTilesPerRow) * TILE_ROWS;
+	int endRow = min(firstRow + TILE_ROWS, decayNumRows);
+	int firstCol = (tile % decayTilesPerRow) * TILE_COLS;
+	int numCols = min(firstCol + TILE_COLS, decayNumCols) - firstCol;
+
+	if (phase == SNAPSHOT_PHASE)
+	{
+		for (int r=firstRow; r<endRow; r++)
+		{
+			size_t offset = (size_t) r * decayNumCols + firstCol;
+			memcpy(decaySnapshot + offset, decayCells + offset, numCols * sizeof(uint32_t));
+		}
+		return;
+	}
+
+	for (int r=firstRow; r<endRow; r++)
+	{
+		const uint32_t* row = decaySnapshot + (size_t) r * decayNumCols;
+		const uint32_t* up = r > 0 ? row - decayNumCols : row;
+		const uint32_t* down = r < decayNumRows-1 ? row + decayNumCols : row;
+		kernelSpan(scratch + (r - firstRow) * TILE_COLS, row, up, down, firstCol, firstCol + numCols);
+	}
+
+	if (decayAdaptiveLock != NULL)
+		adaptiveLock(decayAdaptiveLock);
+	else if (decayCommitLock != NULL)
+		pthread_mutex_lock(decayCommitLock);
+	for (int r=firstRow; r<endRow; r++)
+	{
+		size_t offset = (size_t) r * decayNumCols + firstCol;
+		commitSpan(decayCells + offset, decaySnapshot + offset, scratch + (r - firstRow) * TILE_COLS, numCols);
+	}
+	if (decayAdaptiveLock != NULL)
+		adaptiveUnlock(decayAdaptiveLock);
+	else if (decayCommitLock != NULL)
+		pthread_mutex_unlock(decayCommitLock);
+}
+
+static void* decayWorker(void* data)
+{
+	uint32_t* scratch = (uint32_t*) malloc(TILE_ROWS * TILE_COLS * sizeof(uint32_t));
+	//	generation 0 is "no work yet", even if the first phase was posted
+	//	before this thread started
+	unsigned long seen = 0;
+	pthread_mutex_lock(&decay_lock);
+	while (true)
+	{
+		while (decayGeneration == seen)
+			pthread_cond_wait(&decayWorkCond, &decay_lock);
+		seen = decayGeneration;
+		DecayPhase phase = decayPhase;
+		pthread_mutex_unlock(&decay_lock);
+
+		int tile;
+		while ((tile = decayNextTile.fetch_add(1)) < decayNumTiles)
+			runTile(phase, tile, scratch);
+
+		pthread_mutex_lock(&decay_lock);
+		if (++decayWorkersDone == decayNumWorkers)
+			pthread_cond_signal(&decayDoneCond);
+	}
+	return NULL;
+}
+
+static void runPhase(DecayPhase phase)
+{
+	pthread_mutex_lock(&decay_lock);
+	decayPhase = phase;
+	decayNextTile = 0;
+	decayWorkersDone = 0;
+	decayGeneration++;
+	pthread_cond_broadcast(&decayWorkCond);
+	while (decayWorkersDone < decayNumWorkers)
+		pthread_cond_wait(&decayDoneCond, &decay_lock);
+	pthread_mutex_unlock(&decay_lock);
+}
+
+static void* decayThread(void* data)
+{
+	while (true)
+	{
+		usleep(decayIntervalMs * 1000);
+		decayRunPass();
+	}
+	return NULL;
+}
+
+//	bytes of memory traffic of a phase, per byte of grid
+const double SNAPSHOT_TRAFFIC = 2.;	//	read grid, write snapshot
+const double KERNEL_TRAFFIC = 3.;	//	read snapshot, read and write grid
+
+static void printBandwidth(FILE* out, unsigned long passes, double snapshotSeconds, double kernelSeconds)
+{
+	double gridBytes = (double) decayNumRows * decayNumCols * sizeof(uint32_t);
+	double copyRate = SNAPSHOT_TRAFFIC * gridBytes * passes / snapshotSeconds;
+	double kernelRate = KERNEL_TRAFFIC * gridBytes * passes / kernelSeconds;
+	fprintf(out, "  %.2f ms per pass: snapshot %.2f GB/s (parallel copy), kernel + commit %.2f GB/s (%.0f%% of copy)\n",
+			1e3 * (snapshotSeconds + kernelSeconds) / passes, copyRate * 1e-9, kernelRate * 1e-9,
+			100. * kernelRate / copyRate);
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void decayInitialize(int** grid, int numRows, int numCols, int numWorkers, pthread_mutex_t* commitLock)
+{
+	decayCells = (uint32_t*) grid[0];
+	decayNumRows = numRows;
+	decayNumCols = numCols;
+	decayTilesPerRow = (numCols + TILE_COLS - 1) / TILE_COLS;
+	decayNumTiles = decayTilesPerRow * ((numRows + TILE_ROWS - 1) / TILE_ROWS);
+	decayCommitLock = commitLock;
+	decaySnapshot = (uint32_t*) malloc((size_t) numRows * numCols * sizeof(uint32_t));
+
+	decayNumWorkers = max(1, numWorkers);
+	for (int k=0; k<decayNumWorkers; k++)
+	{
+		pthread_t threadID;
+		if (pthread_create(&threadID, nullptr, decayWorker, NULL) != 0)
+		{
+			fprintf(stderr, "could not create decay worker %d\n", k);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+void decayUseAdaptiveLock(AdaptiveLock* commitLock)
+{
+	decayAdaptiveLock = commitLock;
+}
+
+void decaySetParameters(double fade, bool blur)
+{
+	decayFade = min(1., max(0., fade));
+	decayFade16 = (uint16_t) min(65535., decayFade * 65536.);
+	decayBlur = blur;
+	//	the blur weights add up to 8
+	decayShiftIn = blur ? 5 : 8;
+}
+
+void decayRunPass(void)
+{
+	pthread_mutex_lock(&decay_pass_lock);
+	double start = nowSeconds();
+	runPhase(SNAPSHOT_PHASE);
+	double snapshotDone = nowSeconds();
+	runPhase(KERNEL_PHASE);
+	double end = nowSeconds();
+
+	decayPasses++;
+	decaySnapshotSeconds += snapshotDone - start;
+	decayKernelSeconds += end - snapshotDone;
+	pthread_mutex_unlock(&decay_pass_lock);
+}
+
+void decayStart(int intervalMs)
+{
+	decayIntervalMs = max(1, intervalMs);
+	pthread_t threadID;
+	if (pthread_create(&threadID, nullptr, decayThread, NULL) != 0)
+	{
+		fprintf(stderr, "could not create the decay thread\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void decayPrintReport(FILE* out)
+{
+	fprintf(out, "Decay: fade %.3f%s every %d ms, %d worker%s, %lu passes\n", decayFade,
+			decayBlur ? " with blur" : "", decayIntervalMs, decayNumWorkers, decayNumWorkers > 1 ? "s" : "",
+			decayPasses);
+	if (decayPasses > 0)
+		printBandwidth(out, decayPasses, decaySnapshotSeconds, decayKernelSeconds);
+}
+
+void decayBenchmark(int numRows, int numCols, int numWorkers, FILE* out)
+{
+	const int NUM_PASSES = 10;
+	uint32_t* cells = (uint32_t*) malloc((size_t) numRows * numCols * sizeof(uint32_t));
+	int** grid = (int**) malloc(numRows * sizeof(int*));
+	unsigned int seed = 1;
+	for (size_t k=0; k<(size_t) numRows * numCols; k++)
+	{
+		seed = seed * 1103515245u + 12345u;
+		cells[k] = ALPHA_MASK | (seed >> 8);
+	}
+	for (int i=0; i<numRows; i++)
+		grid[i] = (int*) (cells + (size_t) i * numCols);
+
+	decayInitialize(grid, numRows, numCols, numWorkers, NULL);
+	fprintf(out, "Decay benchmark: %dx%d grid (%.1f MB), %d worker%s, %d passes\n", numRows, numCols,
+			(double) numRows * numCols * sizeof(uint32_t) * 1e-6, decayNumWorkers, decayNumWorkers > 1 ? "s" : "",
+			NUM_PASSES);
+	for (int blur=0; blur<2; blur++)
+	{
+		decaySetParameters(0.95, blur != 0);
+		//	warm-up pass (first touch of the snapshot)
+		decayRunPass();
+		unsigned long passes = decayPasses;
+		double snapshotSeconds = decaySnapshotSeconds, kernelSeconds = decayKernelSeconds;
+		for (int k=0; k<NUM_PASSES; k++)
+			decayRunPass();
+		fprintf(out, "fade%s:\n", blur ? " + blur" : "");
+		printBandwidth(out, decayPasses - passes, decaySnapshotSeconds - snapshotSeconds,
+					   decayKernelSeconds - kernelSeconds);
+	}
+
+	//	the workers are idle between passes: nothing reads the grid any more
+	free(decaySnapshot);
+	free(grid);
+	free(cells);
+	decaySnapshot = NULL;
+	decayCells = NULL;
+}
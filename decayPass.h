@@ -0,0 +1,71 @@
+//
+//  decayPass.h
+//  GL threads
+//
+//  Trail decay and diffusion.  At a fixed rate, every channel of every
+//	cell fades by a constant factor, optionally after a blur with its four
+//	neighbours.  A pass runs in two phases on a small worker pool, one
+//	tile at a time: the grid is copied into a snapshot buffer, then each
+//	tile's new colors are computed from the snapshot (vectorized) and
+//	committed to the grid together with whatever the travelers deposited
+//	since the snapshot.  Travelers keep painting during the whole pass;
+//	only the commit of a tile (4096 cells) takes the grid's write lock.
+//
+
+#ifndef DECAY_PASS_H
+#define DECAY_PASS_H
+
+#include <cstdio>
+#include <pthread.h>
+//
+#include "adaptiveLock.h"
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Allocates the snapshot buffer and starts the worker pool
+ *  @param grid         grid (rows must be contiguous, starting at grid[0])
+ *  @param numRows      number of rows
+ *  @param numCols      number of columns
+ *  @param numWorkers   worker threads
+ *  @param commitLock   lock held by the grid's writers (NULL: none)
+ */
+void decayInitialize(int** grid, int numRows, int numCols, int numWorkers, pthread_mutex_t* commitLock);
+
+/** Commits the tiles under an adaptive lock instead of commitLock (when
+ *	the grid's writers take one, see adaptiveLock.h)
+ *  @param commitLock   the lock
+ */
+void decayUseAdaptiveLock(AdaptiveLock* commitLock);
+
+/** Sets the kernel
+ *  @param fade         factor applied to each channel at every pass (0..1)
+ *  @param blur         average each cell with its neighbours first
+ */
+void decaySetParameters(double fade, bool blur);
+
+/** Runs one pass over the whole grid (returns when it is done)
+ */
+void decayRunPass(void);
+
+/** Starts a thread running a pass at a fixed rate
+ *  @param intervalMs   time between two passes (in milliseconds)
+ */
+void decayStart(int intervalMs);
+
+/** Prints the pass count, pass time, and the bandwidth of both phases
+ *  @param out          output stream
+ */
+void decayPrintReport(FILE* out);
+
+/** Runs passes on a synthetic grid, with and without blur, and prints the
+ *	bandwidth achieved against the bandwidth of a plain parallel copy
+ *  @param numRows      number of rows
+ *  @param numCols      number of columns
+ *  @param numWorkers   worker threads
+ *  @param out          output stream
+ */
+void decayBenchmark(int numRows, int numCols, int numWorkers, FILE* out);
+
+#endif // DECAY_PASS_H
@@ -0,0 +1,159 @@
+//
+//  framePacer.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <algorithm>
+#include <time.h>
+//
+#include "framePacer.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+//	frames kept for the percentiles
+const int PACER_SAMPLES = 256;
+//	slowest pacing, and longest time without a redraw (in milliseconds)
+const int PACER_MAX_INTERVAL_MS = 200;
+const int PACER_MAX_SKIP_MS = 1000;
+//	share of the interval (render time + timer lateness) above which the
+//	interval grows, and below which it shrinks back toward the cap
+const double PACER_HIGH_LOAD = 0.5;
+const double PACER_LOW_LOAD = 0.25;
+//	time between two recomputations of the statistics (in milliseconds)
+const int PACER_STATS_INTERVAL_MS = 250;
+
+int pacerMinIntervalMs = 20;
+double pacerIntervalMs = 20.;
+uint64_t pacerNextTickNs = 0;
+uint64_t pacerLatenessNs = 0;
+uint64_t pacerFrameStartNs = 0;
+uint64_t pacerLastDrawNs = 0;
+
+double pacerRenderMs[PACER_SAMPLES];
+double pacerGapMs[PACER_SAMPLES];
+unsigned long pacerNumRender = 0, pacerNumGaps = 0;
+
+FrameStats pacerStats;
+uint64_t pacerStatsNs = 0;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static uint64_t nowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+//	Grows the interval if the render loop takes too large a share of it
+static void adaptInterval(double renderMs)
+{
+	double load = (renderMs + pacerLatenessNs * 1e-6) / pacerIntervalMs;
+	if (load > PACER_HIGH_LOAD)
+		pacerIntervalMs = min((double) PACER_MAX_INTERVAL_MS, pacerIntervalMs * 1.5);
+	else if (load < PACER_LOW_LOAD)
+		pacerIntervalMs = max((double) pacerMinIntervalMs, pacerIntervalMs * 0.9);
+}
+
+//	Percentiles 50, 95, 99 of the samples kept
+static void percentiles(const double* samples, unsigned long numSamples, double result[3])
+{
+	int n = (int) min(numSamples, (unsigned long) PACER_SAMPLES);
+	if (n == 0)
+	{
+		result[0] = result[1] = result[2] = 0.;
+		return;
+	}
+	double sorted[PACER_SAMPLES];
+	copy(samples, samples + n, sorted);
+	sort(sorted, sorted + n);
+	const double RANKS[3] = {0.50, 0.95, 0.99};
+	for (int k=0; k<3; k++)
+		result[k] = sorted[(int) (RANKS[k] * (n - 1) + 0.5)];
+}
+
+static void updateStats(uint64_t now)
+{
+	percentiles(pacerRenderMs, pacerNumRender, pacerStats.renderMs);
+	percentiles(pacerGapMs, pacerNumGaps, pacerStats.intervalMs);
+	int n = (int) min(pacerNumGaps, (unsigned long) PACER_SAMPLES);
+	double total = 0.;
+	for (int k=0; k<n; k++)
+		total += pacerGapMs[k];
+	pacerStats.fps = total > 0. ? 1e3 * n / total : 0.;
+	pacerStats.pacingMs = (int) (pacerIntervalMs + 0.5);
+	pacerStats.version++;
+	pacerStatsNs = now;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void framePacerInitialize(int maxFps)
+{
+	pacerMinIntervalMs = max(1, 1000 / max(1, maxFps));
+	pacerIntervalMs = pacerMinIntervalMs;
+	pacerStats.pacingMs = pacerMinIntervalMs;
+}
+
+bool framePacerBeginFrame(bool changed)
+{
+	uint64_t now = nowNs();
+	pacerLatenessNs = pacerNextTickNs > 0 && now > pacerNextTickNs ? now - pacerNextTickNs : 0;
+
+	if (!changed && pacerLastDrawNs > 0 && now - pacerLastDrawNs < PACER_MAX_SKIP_MS * 1000000ULL)
+	{
+		pacerStats.framesSkipped++;
+		adaptInterval(0.);
+		return false;
+	}
+	pacerFrameStartNs = now;
+	return true;
+}
+
+void framePacerEndFrame(void)
+{
+	uint64_t now = nowNs();
+	double renderMs = (now - pacerFrameStartNs) * 1e-6;
+	pacerRenderMs[pacerNumRender++ % PACER_SAMPLES] = renderMs;
+	if (pacerLastDrawNs > 0)
+		pacerGapMs[pacerNumGaps++ % PACER_SAMPLES] = (pacerFrameStartNs - pacerLastDrawNs) * 1e-6;
+	pacerLastDrawNs = pacerFrameStartNs;
+	pacerStats.framesDrawn++;
+	adaptInterval(renderMs);
+
+	if (now - pacerStatsNs >= PACER_STATS_INTERVAL_MS * 1000000ULL)
+		updateStats(now);
+}
+
+int framePacerDelayMs(void)
+{
+	int delay = (int) (pacerIntervalMs + 0.5);
+	pacerNextTickNs = nowNs() + delay * 1000000ULL;
+	return delay;
+}
+
+const FrameStats* framePacerStats(void)
+{
+	return &pacerStats;
+}
+
+void framePacerPrintReport(FILE* out)
+{
+	updateStats(nowNs());
+	fprintf(out, "Render loop: %lu frames drawn, %lu ticks skipped, pacing %d ms (cap %d ms), %.1f fps\n",
+			pacerStats.framesDrawn, pacerStats.framesSkipped, pacerStats.pacingMs, pacerMinIntervalMs,
+			pacerStats.fps);
+	fprintf(out, "  render time    p50 %6.2f  p95 %6.2f  p99 %6.2f ms\n",
+			pacerStats.renderMs[0], pacerStats.renderMs[1], pacerStats.renderMs[2]);
+	fprintf(out, "  frame interval p50 %6.2f  p95 %6.2f  p99 %6.2f ms\n",
+			pacerStats.intervalMs[0], pacerStats.intervalMs[1], pacerStats.intervalMs[2]);
+}
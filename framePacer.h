@@ -0,0 +1,75 @@
+//
+//  framePacer.h
+//  GL threads
+//
+//  Pacing of the front end's redraws.  The render loop ticks at an interval
+//	that starts at the frame-rate cap, and only redraws when the snapshot
+//	it consumed differs from the one on screen (or after a second without a
+//	redraw).  When frames cost a large share of the interval, or the timer
+//	fires late because the simulation keeps the CPUs busy, the interval
+//	grows; it shrinks back to the cap once there is room again.  Render
+//	times and frame intervals are kept for the last frames, and their
+//	percentiles recomputed a few times per second.
+//
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <cstdint>
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+/** Frame statistics over the last frames drawn
+ *  @var version        bumped each time the statistics are recomputed
+ *  @var renderMs       50th, 95th and 99th percentiles of the render time
+ *  @var intervalMs     same, for the time between two frames drawn
+ *  @var fps            frames drawn per second
+ *  @var pacingMs       current tick interval
+ *  @var framesDrawn    frames drawn since the start
+ *  @var framesSkipped  ticks without a redraw since the start
+ */
+typedef struct FrameStats {
+	unsigned int version;
+	double renderMs[3];
+	double intervalMs[3];
+	double fps;
+	int pacingMs;
+	unsigned long framesDrawn;
+	unsigned long framesSkipped;
+} FrameStats;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Sets the frame-rate cap
+ *  @param maxFps       frames per second at most
+ */
+void framePacerInitialize(int maxFps);
+
+/** Called at each tick of the render loop
+ *  @param changed      the snapshot just consumed differs from the one drawn
+ *  @return true if the frame should be drawn (then call framePacerEndFrame)
+ */
+bool framePacerBeginFrame(bool changed);
+
+/** Records the end of the frame started by framePacerBeginFrame
+ */
+void framePacerEndFrame(void);
+
+/** Time until the next tick
+ *  @return the delay (in milliseconds)
+ */
+int framePacerDelayMs(void);
+
+const FrameStats* framePacerStats(void);
+
+/** Prints the frame counts and the percentiles
+ *  @param out          output stream
+ */
+void framePacerPrintReport(FILE* out);
+
+#endif // FRAME_PACER_H
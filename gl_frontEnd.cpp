@@ -8,8 +8,11 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstdio>
+#include <algorithm>
 //
 #include "gl_frontEnd.h"
+#include "framePacer.h"
+#include "inkHistory.h"
 
 //---------------------------------------------------------------------------
 //	ink access functions.
@@ -29,6 +32,12 @@ void myResize(int w, int h);
 void drawnTankFrame(int LEVEL_WIDTH, int LEVEL_HEIGHT);
 void fillTank(int y, int LEVEL_WIDTH);
 void displayTextualInfo(const char* infoStr, int x, int y, int isLarge);
+void displayCachedLabel(int labelIndex, const char* format, int value, int x, int y, int isLarge);
+void displayCachedText(int labelIndex, int version, const char* infoStr, int x, int y, int isLarge);
+void drawTravelerDensity(const GridFrame* frame, int level, int numRows, int numCols, float DH, float DV);
+void drawInkHistory(int left, int bottom, int width, int height);
+void drawSparkline(const InkSample* samples, int numSamples, int series, int channel, float maxValue,
+				   int width, int height);
 void myMouse(int b, int s, int x, int y);
 void myGridPaneMouse(int b, int s, int x, int y);
 void myStatePaneMouse(int b, int s, int x, int y);
@@ -89,6 +98,10 @@ const int STATE_PANE_HEIGHT = 600;
 const int H_PADDING = 0;
 const int WINDOW_WIDTH = 1000;
 const int WINDOW_HEIGHT = 600;
+//	Smallest cells (in pixels) that get grid lines, and travelers drawn
+//	one by one
+const float MIN_LINED_CELL_SIZE = 4.f;
+const float MIN_TRAVELER_CELL_SIZE = 6.f;
 
 
 //---------------------------------------------------------------------------
@@ -97,6 +110,7 @@ const int WINDOW_HEIGHT = 600;
 
 void (*gridDisplayFunc)(void);
 void (*stateDisplayFunc)(void);
+bool (*frameSourceFunc)(void);
 void myTimerFunc(int value);
 
 //	We use a window split into two panes/subwindows.  The subwindows
@@ -109,7 +123,42 @@ int	gMainWindow,
 
 extern int MAX_LEVEL;
 extern int MAX_ADD_INK;
-extern int MAX_NUM_TRAVELER_THREADS;
+extern bool textCacheOn;
+
+//	Cached text.  Each glyph of both fonts is a display list, and each label
+//	of the state pane a display list calling the glyphs' lists.  A label is
+//	only rebuilt when the value it shows changes.  Display lists belong to
+//	the context of the state pane, where they are created on first use.
+typedef struct TextLabel {
+	GLuint list;
+	int value;
+	bool built;
+} TextLabel;
+
+enum StateLabelID {	RED_LEVEL_LABEL = 0,
+					GREEN_LEVEL_LABEL,
+					BLUE_LEVEL_LABEL,
+					RED_MAX_LABEL,
+					GREEN_MAX_LABEL,
+					BLUE_MAX_LABEL,
+					LIVE_THREADS_LABEL,
+					FRAME_TIME_LABEL,
+					FRAME_RATE_LABEL,
+					//
+					NUM_STATE_LABELS
+};
+
+//	series of the ink history's sparklines
+enum SparklineSeries {	LEVEL_SERIES = 0,
+						CONSUMED_SERIES,
+						REFILLED_SERIES,
+						LIVE_THREADS_SERIES
+};
+
+const int NUM_GLYPHS = 128;
+GLuint gGlyphBase[2] = {0, 0};
+TextLabel gStateLabels[NUM_STATE_LABELS];
+unsigned long gStateLabelsBuilt = 0;
 
 //---------------------------------------------------------------------------
 //	Drawing functions
@@ -158,69 +207,152 @@ void drawGrid(int**grid, int numRows, int numCols)
 	glEnd();
 }
 
-void drawGridAndTravelers(int**grid, int numRows, int numCols, TravelerInfo *travelList)
+//	Draws a frame copied from the published grid (see gridReader.h), from
+//	the level of the pyramid that has no more cells than the pane has pixels
+void drawGridAndTravelers(const GridFrame* frame, const GridPyramid* pyramid)
 {
-	const int	DH = GRID_PANE_WIDTH / numCols,
-				DV = GRID_PANE_HEIGHT / numRows;
+	const int	level = gridPyramidLevelFor(pyramid, GRID_PANE_WIDTH, GRID_PANE_HEIGHT);
+	const int	numRows = pyramid->numRows[level],
+				numCols = pyramid->numCols[level];
+	const float	DH = (float) GRID_PANE_WIDTH / numCols,
+				DV = (float) GRID_PANE_HEIGHT / numRows;
+	const unsigned int* cells = gridPyramidCells(pyramid, frame, level);
 	
 	//	Display the grid as a series of quad strips
 	for (int i=0; i<numRows; i++)
 	{
+		const unsigned int* row = cells + (size_t) i*numCols;
 		glBegin(GL_QUAD_STRIP);
 			for (int j=0; j<numCols; j++)
 			{
 				
-				glColor4f((grid[i][j] & 0x000000FF)/255.f, ((grid[i][j] & 0x0000FF00) >> 8)/255.f,
-						  ((grid[i][j] & 0x00FF0000) >> 16)/255.f, 1.f);
+				glColor4f((row[j] & 0x000000FF)/255.f, ((row[j] & 0x0000FF00) >> 8)/255.f,
+						  ((row[j] & 0x00FF0000) >> 16)/255.f, 1.f);
 
-				glVertex2i(j*DH, i*DV);
-				glVertex2i(j*DH, (i+1)*DV);
-				glVertex2i((j+1)*DH, i*DV);
-				glVertex2i((j+1)*DH, (i+1)*DV);
+				glVertex2f(j*DH, i*DV);
+				glVertex2f(j*DH, (i+1)*DV);
+				glVertex2f((j+1)*DH, i*DV);
+				glVertex2f((j+1)*DH, (i+1)*DV);
 			}
 		glEnd();
 	}
 	
-	//	Then draw a grid of lines on top of the squares
-	glColor4f(0.5f, 0.5f, 0.5f, 1.f);
-	glBegin(GL_LINES);
-		//	Horizontal
-		for (int i=0; i<= numRows; i++)
-		{
-			glVertex2i(0, i*DV);
-			glVertex2i(GRID_PANE_WIDTH, i*DV);
-		}
-		//	Vertical
-		for (int j=0; j<= numCols; j++)
+	//	Then draw a grid of lines on top of the squares, if they are large
+	//	enough for the lines not to hide them
+	if (DH >= MIN_LINED_CELL_SIZE && DV >= MIN_LINED_CELL_SIZE)
+	{
+		glColor4f(0.5f, 0.5f, 0.5f, 1.f);
+		glBegin(GL_LINES);
+			//	Horizontal
+			for (int i=0; i<= numRows; i++)
+			{
+				glVertex2f(0.f, i*DV);
+				glVertex2f(GRID_PANE_WIDTH, i*DV);
+			}
+			//	Vertical
+			for (int j=0; j<= numCols; j++)
+			{
+				glVertex2f(j*DH, 0.f);
+				glVertex2f(j*DH, GRID_PANE_HEIGHT);
+			}
+		glEnd();
+	}
+	
+	//	Draw the travelers, one by one if each has a cell of its own on screen
+	if (level == 0 && DH >= MIN_TRAVELER_CELL_SIZE && DV >= MIN_TRAVELER_CELL_SIZE)
+	{
+		for (int k=0; k< frame->numTravelers; k++)
 		{
-			glVertex2i(j*DH, 0);
-			glVertex2i(j*DH, GRID_PANE_HEIGHT);
+			const PublishedTraveler* traveler = frame->travelers + k;
+			if (traveler->isLive)
+			{
+				glPushMatrix();
+				glTranslatef((traveler->col + 0.5f)*DH, (traveler->row + 0.5f)*DV, 0.f);
+				glRotatef(traveler->dir * 90.f, 0.f, 0.f, 1.f);
+				//	a traveler waiting for the cell ahead is filled in orange
+				if (traveler->flags & PUBLISHED_TRAVELER_BLOCKED)
+					glColor4f(1.f, 0.5f, 0.f, 1.f);
+				else
+					glColor4f(0.f, 0.f, 0.f, 1.f);
+				glBegin(GL_POLYGON);
+					glVertex2f(DH/6.f, -DV/4.f);
+					glVertex2f(0.f, DV/4.f);
+					glVertex2f(-DH/6.f, -DV/4.f);
+				glEnd();
+				glColor4f(1.f, 1.f, 1.f, 1.f);
+				glBegin(GL_LINE_LOOP);
+					glVertex2f(DH/6.f, -DV/4.f);
+					glVertex2f(0.f, DV/4.f);
+					glVertex2f(-DH/6.f, -DV/4.f);
+				glEnd();
+				glPopMatrix();
+			}
 		}
-	glEnd();
+	}
+	//	otherwise as the density of travelers per block
+	else
+		drawTravelerDensity(frame, level, numRows, numCols, DH, DV);
+}
+
+//	Draws a white square over each block of the level that holds live
+//	travelers (orange if one of them is blocked), more opaque where more of
+//	them overlap.  Both passes only visit the travelers, so the cost does
+//	not depend on the size of the grid.
+void drawTravelerDensity(const GridFrame* frame, int level, int numRows, int numCols, float DH, float DV)
+{
+	static unsigned int* blockCount = NULL;
+	static bool* blockBlocked = NULL;
+	static size_t blockCapacity = 0;
+	size_t numBlocks = (size_t) numRows * numCols;
+	if (numBlocks > blockCapacity)
+	{
+		free(blockCount);
+		free(blockBlocked);
+		blockCount = (unsigned int*) calloc(numBlocks, sizeof(unsigned int));
+		blockBlocked = (bool*) calloc(numBlocks, sizeof(bool));
+		blockCapacity = numBlocks;
+	}
 	
-	//	Draw the travelers
-	for (int k=0; k< MAX_NUM_TRAVELER_THREADS; k++)
+	unsigned int maxCount = 0;
+	for (int k=0; k< frame->numTravelers; k++)
 	{
-		if (travelList[k].isLive)
+		const PublishedTraveler* traveler = frame->travelers + k;
+		if (traveler->isLive && traveler->row < frame->numRows && traveler->col < frame->numCols)
 		{
-			glPushMatrix();
-			glTranslatef((travelList[k].col + 0.5f)*DH, (travelList[k].row + 0.5f)*DV, 0.f);
-			glRotatef(travelList[k].dir * 90.f, 0.f, 0.f, 1.f);
-			glColor4f(0.f, 0.f, 0.f, 1.f);
-			glBegin(GL_POLYGON);
-				glVertex2f(DH/6.f, -DV/4.f);
-				glVertex2f(0.f, DV/4.f);
-				glVertex2f(-DH/6.f, -DV/4.f);
-			glEnd();
-			glColor4f(1.f, 1.f, 1.f, 1.f);
-			glBegin(GL_LINE_LOOP);
-				glVertex2f(DH/6.f, -DV/4.f);
-				glVertex2f(0.f, DV/4.f);
-				glVertex2f(-DH/6.f, -DV/4.f);
-			glEnd();
-			glPopMatrix();
+			size_t block = (size_t) (traveler->row >> level) * numCols + (traveler->col >> level);
+			unsigned int count = ++blockCount[block];
+			if (count > maxCount)
+				maxCount = count;
+			if (traveler->flags & PUBLISHED_TRAVELER_BLOCKED)
+				blockBlocked[block] = true;
 		}
 	}
+	
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBegin(GL_QUADS);
+		for (int k=0; k< frame->numTravelers; k++)
+		{
+			const PublishedTraveler* traveler = frame->travelers + k;
+			if (traveler->isLive && traveler->row < frame->numRows && traveler->col < frame->numCols)
+			{
+				int i = traveler->row >> level, j = traveler->col >> level;
+				unsigned int* count = blockCount + (size_t) i * numCols + j;
+				if (*count == 0)
+					continue;
+				bool* blocked = blockBlocked + (size_t) i * numCols + j;
+				//	at least half opaque, so that a lone traveler shows
+				glColor4f(1.f, *blocked ? 0.5f : 1.f, *blocked ? 0.f : 1.f, 0.5f + 0.5f * *count / maxCount);
+				*count = 0;
+				*blocked = false;
+				glVertex2f(j*DH, i*DV);
+				glVertex2f(j*DH, (i+1)*DV);
+				glVertex2f((j+1)*DH, (i+1)*DV);
+				glVertex2f((j+1)*DH, i*DV);
+			}
+		}
+	glEnd();
+	glDisable(GL_BLEND);
 }
 
 
@@ -313,7 +445,130 @@ void displayTextualInfo(const char* infoStr, int xPos, int yPos, int isLarge)
     glPopMatrix();
 }
 
+//	Same as displayTextualInfo, from the cache: one display list call per
+//	label, the string being formatted and compiled only when value changes
+void displayCachedLabel(int labelIndex, const char* format, int value, int xPos, int yPos, int isLarge)
+{
+	TextLabel* label = gStateLabels + labelIndex;
+	if (!label->built || label->value != value)
+	{
+		char infoStr[256];
+		snprintf(infoStr, sizeof(infoStr), format, value);
+		displayCachedText(labelIndex, value, infoStr, xPos, yPos, isLarge);
+	}
+	else
+		glCallList(label->list);
+}
 
+//	Same, for a string built by the caller: recompiled when version changes
+void displayCachedText(int labelIndex, int version, const char* infoStr, int xPos, int yPos, int isLarge)
+{
+	//	The glyphs, built once
+	if (gGlyphBase[isLarge] == 0)
+	{
+		gGlyphBase[isLarge] = glGenLists(NUM_GLYPHS);
+		for (int c=0; c<NUM_GLYPHS; c++)
+		{
+			glNewList(gGlyphBase[isLarge] + c, GL_COMPILE);
+			//	the bitmap advances the raster position by the glyph's width
+			glutBitmapCharacter(isLarge ? LARGE_DISPLAY_FONT : SMALL_DISPLAY_FONT, c);
+			glEndList();
+		}
+	}
+	
+	TextLabel* label = gStateLabels + labelIndex;
+	if (label->list == 0)
+		label->list = glGenLists(1);
+	if (!label->built || label->value != version)
+	{
+		glNewList(label->list, GL_COMPILE);
+			glColor4fv(kTextColor);
+			glRasterPos2i(xPos, yPos);
+			for (const char* c=infoStr; *c != 0; c++)
+				glCallList(gGlyphBase[isLarge] + (*c & (NUM_GLYPHS-1)));
+		glEndList();
+		label->value = version;
+		label->built = true;
+		gStateLabelsBuilt++;
+	}
+	glCallList(label->list);
+}
+
+
+
+//	Draws one series of the ink history (a SparklineSeries, of a tank), the
+//	last sample on the right edge
+void drawSparkline(const InkSample* samples, int numSamples, int series, int channel, float maxValue,
+				   int width, int height)
+{
+	glBegin(GL_LINE_STRIP);
+		for (int k=0; k<numSamples; k++)
+		{
+			const InkSample* sample = samples + k;
+			float value;
+			switch (series)
+			{
+				case LEVEL_SERIES:		value = sample->level[channel];				break;
+				case CONSUMED_SERIES:	value = sample->consumedPerSec[channel];	break;
+				case REFILLED_SERIES:	value = sample->refilledPerSec[channel];	break;
+				default:				value = sample->numLiveThreads;				break;
+			}
+			glVertex2f(width - numSamples + k, height * std::min(1.f, value / maxValue));
+		}
+	glEnd();
+}
+
+//	Draws the ink history as sparklines, one sample per pixel: the levels
+//	of the tanks (and the live travelers, in gray) in the upper box, and
+//	the consumption (bright) and refill (dim) rates in the lower one.  The
+//	history is copied from the sampler's ring, without taking ink_lock.
+void drawInkHistory(int left, int bottom, int width, int height)
+{
+	static InkSample samples[INK_HISTORY_SIZE];
+	static int numSamples = 0;
+	static uint64_t sampleCount = 0;
+	if (inkHistoryCount() != sampleCount)
+	{
+		sampleCount = inkHistoryCount();
+		numSamples = inkHistoryCopy(samples, std::min(width, INK_HISTORY_SIZE));
+	}
+	const float COLORS[INK_HISTORY_CHANNELS][3] = {{1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.2f, 0.4f, 1.f}};
+	const int BOX_GAP = 10;
+	const int boxHeight = (height - BOX_GAP) / 2;
+
+	//	scales: tank capacity, most travelers and highest rate shown
+	float maxLive = 1.f, maxRate = 1.f;
+	for (int k=0; k<numSamples; k++)
+	{
+		maxLive = std::max(maxLive, (float) samples[k].numLiveThreads);
+		for (int c=0; c<INK_HISTORY_CHANNELS; c++)
+			maxRate = std::max(maxRate, std::max(samples[k].consumedPerSec[c], samples[k].refilledPerSec[c]));
+	}
+
+	glPushMatrix();
+	glTranslatef(left, bottom + boxHeight + BOX_GAP, 0);
+	drawnTankFrame(width, boxHeight);
+	glColor4f(0.6f, 0.6f, 0.6f, 1.f);
+	drawSparkline(samples, numSamples, LIVE_THREADS_SERIES, 0, maxLive, width, boxHeight);
+	for (int c=0; c<INK_HISTORY_CHANNELS; c++)
+	{
+		glColor4f(COLORS[c][0], COLORS[c][1], COLORS[c][2], 1.f);
+		drawSparkline(samples, numSamples, LEVEL_SERIES, c, MAX_LEVEL, width, boxHeight);
+	}
+	glPopMatrix();
+
+	glPushMatrix();
+	glTranslatef(left, bottom, 0);
+	drawnTankFrame(width, boxHeight);
+	for (int c=0; c<INK_HISTORY_CHANNELS; c++)
+	{
+		glColor4f(0.5f * COLORS[c][0], 0.5f * COLORS[c][1], 0.5f * COLORS[c][2], 1.f);
+		drawSparkline(samples, numSamples, REFILLED_SERIES, c, maxRate, width, boxHeight);
+		glColor4f(COLORS[c][0], COLORS[c][1], COLORS[c][2], 1.f);
+		drawSparkline(samples, numSamples, CONSUMED_SERIES, c, maxRate, width, boxHeight);
+	}
+	glPopMatrix();
+}
 
 void drawState(int numLiveThreads, int redLevel, int greenLevel, int blueLevel)
 {
@@ -340,6 +595,9 @@ void drawState(int numLiveThreads, int redLevel, int greenLevel, int blueLevel)
 	int LEVEL_TXT_Y = LEVEL_BOTTOM / 2;
 	int MAX_LEVEL_TXT_Y = LEVEL_BOTTOM + LEVEL_HEIGHT +  LEVEL_BOTTOM / 4;
 	int TOP_LEVEL_TXT_Y = 4*STATE_PANE_HEIGHT / 5;
+	int FRAME_TXT_Y = TOP_LEVEL_TXT_Y - 40;
+	int HISTORY_BOTTOM = MAX_LEVEL_TXT_Y + 20;
+	int HISTORY_TOP = FRAME_TXT_Y - 30;
 
 	
 	//	Draw the red level tank
@@ -368,23 +626,65 @@ void drawState(int numLiveThreads, int redLevel, int greenLevel, int blueLevel)
 	fillTank(yBlue, LEVEL_WIDTH);
 	drawnTankFrame(LEVEL_WIDTH, LEVEL_HEIGHT);
 	glPopMatrix();
+
+	//	Recent history of the tanks, between the tanks and the frame times
+	drawInkHistory(RED_LEFT, HISTORY_BOTTOM, BLUE_LEFT + LEVEL_WIDTH - RED_LEFT, HISTORY_TOP - HISTORY_BOTTOM);
 	
-	//	Build, then display text info for the red, green, and blue tanks
-	char infoStr[256];
-	sprintf(infoStr, "Red level: %d", redLevel);
-	displayTextualInfo(infoStr, RED_LEFT, LEVEL_TXT_Y, 0);
-	sprintf(infoStr, "Green level: %d", greenLevel);
-	displayTextualInfo(infoStr, GREEN_LEFT, LEVEL_TXT_Y, 0);
-	sprintf(infoStr, "Blue level: %d", blueLevel);
-	displayTextualInfo(infoStr, BLUE_LEFT, LEVEL_TXT_Y, 0);
-	sprintf(infoStr, "Max level: %d", MAX_LEVEL);
-	displayTextualInfo(infoStr, RED_LEFT, MAX_LEVEL_TXT_Y, 0);
-	displayTextualInfo(infoStr, GREEN_LEFT, MAX_LEVEL_TXT_Y, 0);
-	displayTextualInfo(infoStr, BLUE_LEFT, MAX_LEVEL_TXT_Y, 0);
+	//	Display text info for the red, green, and blue tanks
+	if (textCacheOn)
+	{
+		displayCachedLabel(RED_LEVEL_LABEL, "Red level: %d", redLevel, RED_LEFT, LEVEL_TXT_Y, 0);
+		displayCachedLabel(GREEN_LEVEL_LABEL, "Green level: %d", greenLevel, GREEN_LEFT, LEVEL_TXT_Y, 0);
+		displayCachedLabel(BLUE_LEVEL_LABEL, "Blue level: %d", blueLevel, BLUE_LEFT, LEVEL_TXT_Y, 0);
+		displayCachedLabel(RED_MAX_LABEL, "Max level: %d", MAX_LEVEL, RED_LEFT, MAX_LEVEL_TXT_Y, 0);
+		displayCachedLabel(GREEN_MAX_LABEL, "Max level: %d", MAX_LEVEL, GREEN_LEFT, MAX_LEVEL_TXT_Y, 0);
+		displayCachedLabel(BLUE_MAX_LABEL, "Max level: %d", MAX_LEVEL, BLUE_LEFT, MAX_LEVEL_TXT_Y, 0);
+		
+		//	display info about number of live threads
+		displayCachedLabel(LIVE_THREADS_LABEL, "Live Threads: %d", numLiveThreads, RED_LEFT, TOP_LEVEL_TXT_Y, 1);
+	}
+	//	or build the strings, then display them glyph by glyph
+	else
+	{
+		char infoStr[256];
+		sprintf(infoStr, "Red level: %d", redLevel);
+		displayTextualInfo(infoStr, RED_LEFT, LEVEL_TXT_Y, 0);
+		sprintf(infoStr, "Green level: %d", greenLevel);
+		displayTextualInfo(infoStr, GREEN_LEFT, LEVEL_TXT_Y, 0);
+		sprintf(infoStr, "Blue level: %d", blueLevel);
+		displayTextualInfo(infoStr, BLUE_LEFT, LEVEL_TXT_Y, 0);
+		sprintf(infoStr, "Max level: %d", MAX_LEVEL);
+		displayTextualInfo(infoStr, RED_LEFT, MAX_LEVEL_TXT_Y, 0);
+		displayTextualInfo(infoStr, GREEN_LEFT, MAX_LEVEL_TXT_Y, 0);
+		displayTextualInfo(infoStr, BLUE_LEFT, MAX_LEVEL_TXT_Y, 0);
+		
+		//	display info about number of live threads
+		sprintf(infoStr, "Live Threads: %d", numLiveThreads);
+		displayTextualInfo(infoStr, RED_LEFT, TOP_LEVEL_TXT_Y, 1);
+	}
 	
-	//	display info about number of live threads
-	sprintf(infoStr, "Live Threads: %d", numLiveThreads);
-	displayTextualInfo(infoStr, RED_LEFT, TOP_LEVEL_TXT_Y, 1);
+	//	Frame times of the render loop, rebuilt when the pacer updates them
+	const FrameStats* stats = framePacerStats();
+	static char frameTimeStr[128], frameRateStr[128];
+	static unsigned int statsVersion = 0;
+	if (stats->version != statsVersion || frameTimeStr[0] == 0)
+	{
+		snprintf(frameTimeStr, sizeof(frameTimeStr), "Frame p50/95/99: %.1f / %.1f / %.1f ms",
+				 stats->renderMs[0], stats->renderMs[1], stats->renderMs[2]);
+		snprintf(frameRateStr, sizeof(frameRateStr), "%.0f fps, tick %d ms, %lu skipped",
+				 stats->fps, stats->pacingMs, stats->framesSkipped);
+		statsVersion = stats->version;
+	}
+	if (textCacheOn)
+	{
+		displayCachedText(FRAME_TIME_LABEL, statsVersion, frameTimeStr, RED_LEFT, FRAME_TXT_Y, 0);
+		displayCachedText(FRAME_RATE_LABEL, statsVersion, frameRateStr, RED_LEFT, FRAME_TXT_Y - 20, 0);
+	}
+	else
+	{
+		displayTextualInfo(frameTimeStr, RED_LEFT, FRAME_TXT_Y, 0);
+		displayTextualInfo(frameRateStr, RED_LEFT, FRAME_TXT_Y - 20, 0);
+	}
 }
 
 
@@ -562,7 +862,7 @@ void myMenuHandler(int choice)
 
 
 void initializeFrontEnd(int argc, char** argv, void (*gridDisplayCB)(void),
-						void (*stateDisplayCB)(void))
+						void (*stateDisplayCB)(void), bool (*frameSourceCB)(void))
 {
 	//	Initialize glut and create a new window
 	glutInit(&argc, argv);
@@ -578,10 +878,11 @@ void initializeFrontEnd(int argc, char** argv, void (*gridDisplayCB)(void),
 	glutDisplayFunc(myDisplay);
 	glutReshapeFunc(myResize);
 	glutMouseFunc(myMouse);
-    glutTimerFunc(20, myTimerFunc, 0);
+    glutTimerFunc(framePacerDelayMs(), myTimerFunc, 0);
 	
 	gridDisplayFunc = gridDisplayCB;
 	stateDisplayFunc = stateDisplayCB;
+	frameSourceFunc = frameSourceCB;
 	
 	//	create the two panes as glut subwindows
 	gSubwindow[GRID_PANE] = glutCreateSubWindow(gMainWindow,
@@ -611,12 +912,16 @@ void initializeFrontEnd(int argc, char** argv, void (*gridDisplayCB)(void),
 	glutDisplayFunc(stateDisplayCB);
 }
 
+//	The render loop: consumes the last published frame, redraws if the
+//	pacer says so, and re-arms itself after the pacer's current interval
 void myTimerFunc(int value)
 {
-    //  possibly I do something to update the scene
-
-    //    And finally I perform the rendering
-    glutSetWindow(gMainWindow);
-    myDisplay();
-    glutTimerFunc(20, myTimerFunc, 0);  // forces the function to get called back 20ms later
+	bool changed = frameSourceFunc();
+	if (framePacerBeginFrame(changed))
+	{
+		glutSetWindow(gMainWindow);
+		myDisplay();
+		framePacerEndFrame();
+	}
+    glutTimerFunc(framePacerDelayMs(), myTimerFunc, 0);
 }
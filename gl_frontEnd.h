@@ -9,6 +9,10 @@
 #ifndef GL_FRONT_END_H
 #define GL_FRONT_END_H
 #include <pthread.h>
+#include <cstdint>
+//
+#include "gridReader.h"
+#include "gridPyramid.h"
 
 
 //------------------------------------------------------------------------------
@@ -52,40 +56,69 @@ typedef enum TravelDirection {
 } TravelDirection;
 
 //	The 
-using TravelerType = enum {
+//	(named, so that functions taking a TravelerType can be shared between
+//	translation units)
+typedef enum TravelerType {
 								RED_TRAV = 0,
 								GREEN_TRAV,
 								BLUE_TRAV,
 								//
 								NUM_TRAV_TYPES
-};
+} TravelerType;
 using ProducerType = TravelerType;
 
 //	Traveler info data type
+//	The traveler table has one entry per traveler (up to millions of them in
+//	coroutine mode), so an entry is packed into 8 bytes: positions on 16 bits
+//	(grids are at most 65535 x 65535), direction, type and liveness in one
+//	byte.  Entries are written with a single 8-byte store (storeTraveler), so
+//	a reader never sees half a move.  What the simulation never reads after
+//	startup lives in the cold table (TravelerDebugInfo).
 /** Traveler info struct
- *  @var type       type of traveler
  *  @var row        row location of traveler
  *  @var col        col location of traveler
- *  @var isLive     thread is live bool
  *  @var distance   distance travel for traveler
- *  @var index      index of traveler
- *  @var threadID   thread id of traveler
+ *  @var dir        direction of traveler (a TravelDirection)
+ *  @var type       type of traveler (a TravelerType)
+ *  @var isLive     thread is live bool
+ *  @var isBlocked  waiting for the cell ahead (exclusive cells)
+ *  @var isMixed    paints the ink mix recipe (type: its main color)
  */
-typedef struct TravelerInfo {
-								TravelerType type;
+typedef struct alignas(8) TravelerInfo {
 								//	location of the traveler
-								int row;
-								int col;
+								uint16_t row;
+								uint16_t col;
+								uint16_t distance;
 								//	in which direciton is the traveler going
-								TravelDirection dir;
+								uint8_t dir : 2;
+								uint8_t type : 2;
 								// initialized to 1, set to 0 if terminates
-								int isLive;
-								int distance;
+								uint8_t isLive : 1;
+								uint8_t isBlocked : 1;
+								uint8_t isMixed : 1;
+								uint8_t unused;
+} TravelerInfo;
 
+inline TravelDirection travelerDir(const TravelerInfo* tt)
+{
+	return static_cast<TravelDirection>(tt->dir);
+}
+
+inline TravelerType travelerType(const TravelerInfo* tt)
+{
+	return static_cast<TravelerType>(tt->type);
+}
+
+/** Traveler debug info struct (cold table, same indices as the travelers)
+ *  @var index      index of traveler
+ *  @var threadID   thread id of traveler (0 in coroutine mode)
+ *  @var node       NUMA node the traveler is bound to (-1 if unbound)
+ */
+typedef struct TravelerDebugInfo {
 								unsigned int index;
 								pthread_t threadID;
-//                                pthread_mutex_t* thread_lock;
-} TravelerInfo;
+								int node;
+} TravelerDebugInfo;
 
 
 /** Producer struct
@@ -102,9 +135,9 @@ typedef struct Producer {
 //-----------------------------------------------------------------------------
 
 void drawGrid(int**grid, int numRows, int numCols);
-void drawGridAndTravelers(int**grid, int numRows, int numCols, TravelerInfo *travelList);
+void drawGridAndTravelers(const GridFrame* frame, const GridPyramid* pyramid);
 void drawState(int numLiveThreads, int redLevel, int greenLevel, int blueLevel);
-void initializeFrontEnd(int argc, char** argv, void (*gridCB)(void), void (*stateCB)(void));
+void initializeFrontEnd(int argc, char** argv, void (*gridCB)(void), void (*stateCB)(void), bool (*frameCB)(void));
 void speedupProducers(void);
 void slowdownProducers(void);
 
@@ -0,0 +1,202 @@
+//
+//  gridPublish.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+//
+#include "gl_frontEnd.h"
+#include "gridPublish.h"
+#include "phaseCounters.h"
+#include "cellFormat.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//	Simulation state (main.cpp)
+//---------------------------------------------------------------------------
+
+extern int** grid;
+extern int NUM_ROWS, NUM_COLS;
+extern int MAX_NUM_TRAVELER_THREADS;
+extern TravelerInfo* travelList;
+extern unsigned int travelerReadEpoch;
+extern int numLiveThreads;
+extern int redLevel, greenLevel, blueLevel;
+extern int MAX_LEVEL;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+char publishSegmentName[256] = "";
+void* publishBase = NULL;
+size_t publishLength = 0;
+GridShmHeader* publishHeader = NULL;
+unsigned int* publishCells = NULL;
+PublishedTraveler* publishTravelers = NULL;
+GridReader* publishLocalReader = NULL;
+
+int publishIntervalMs = 20;
+atomic<bool> publishRunning(false);
+pthread_t publishThreadID;
+//	serializes writers (publisher thread vs. gridPublishNow)
+pthread_mutex_t publish_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static void writeFrame(void)
+{
+	pthread_mutex_lock(&publish_lock);
+	GridShmHeader* header = publishHeader;
+
+	//	seqlock: odd while the frame is being written
+	uint64_t seq = header->sequence.load(memory_order_relaxed);
+	header->sequence.store(seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	//	Cells are copied without grid_lock: each cell is a single word, so
+	//	at worst a frame shows some cells one deposit older than others,
+	//	and the travelers never wait for the publisher.  A wide cell format
+	//	is tone-mapped here, the only place its cells are shown.
+	if (cellFormat != RGBA8_FORMAT)
+		cellGridToneMap(publishCells);
+	else
+		memcpy(publishCells, grid[0], (size_t) NUM_ROWS * NUM_COLS * sizeof(unsigned int));
+
+	int numTravelers = min(MAX_NUM_TRAVELER_THREADS, (int) header->maxTravelers);
+	for (int k=0; k<numTravelers; k++)
+	{
+		//	one 8-byte load: never half a move
+		TravelerInfo traveler;
+		__atomic_load(travelList + k, &traveler, __ATOMIC_RELAXED);
+		publishTravelers[k].row = traveler.row;
+		publishTravelers[k].col = traveler.col;
+		publishTravelers[k].dir = traveler.dir;
+		publishTravelers[k].type = traveler.type;
+		publishTravelers[k].isLive = traveler.isLive;
+		publishTravelers[k].flags = traveler.isBlocked ? PUBLISHED_TRAVELER_BLOCKED : 0;
+	}
+	//	the travelers write their entries again for the next frame (the
+	//	moving ones are at most one frame behind)
+	__atomic_fetch_add(&travelerReadEpoch, 1, __ATOMIC_RELAXED);
+	header->numTravelers = numTravelers;
+	header->numLiveThreads = numLiveThreads;
+	header->redLevel = redLevel;
+	header->greenLevel = greenLevel;
+	header->blueLevel = blueLevel;
+	header->maxLevel = MAX_LEVEL;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	header->timestampNs = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+	header->sequence.store(seq + 2, memory_order_release);
+	pthread_mutex_unlock(&publish_lock);
+}
+
+static void* publishThread(void* data)
+{
+	//	writing the frame is the simulation's share of rendering
+	while (publishRunning.load())
+	{
+		phaseEnter(RENDER_PHASE);
+		writeFrame();
+		phaseEnter(WAIT_PHASE);
+		usleep(publishIntervalMs * 1000);
+	}
+	phaseLeave();
+	return NULL;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+bool gridPublishStart(const char* name, int intervalMs)
+{
+	if (publishBase != NULL)
+		return true;
+
+	publishLength = gridShmSize(NUM_ROWS, NUM_COLS, MAX_NUM_TRAVELER_THREADS);
+	shm_unlink(name);
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0)
+	{
+		perror("shm_open");
+		return false;
+	}
+	if (ftruncate(fd, (off_t) publishLength) != 0)
+	{
+		perror("ftruncate");
+		close(fd);
+		shm_unlink(name);
+		return false;
+	}
+	publishBase = mmap(NULL, publishLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (publishBase == MAP_FAILED)
+	{
+		perror("mmap");
+		publishBase = NULL;
+		shm_unlink(name);
+		return false;
+	}
+	snprintf(publishSegmentName, sizeof(publishSegmentName), "%s", name);
+
+	char* bytes = static_cast<char*>(publishBase);
+	publishHeader = static_cast<GridShmHeader*>(publishBase);
+	publishCells = reinterpret_cast<unsigned int*>(bytes + gridShmCellsOffset());
+	publishTravelers = reinterpret_cast<PublishedTraveler*>(bytes + gridShmTravelersOffset(NUM_ROWS, NUM_COLS));
+	publishHeader->version = GRID_SHM_VERSION;
+	publishHeader->numRows = NUM_ROWS;
+	publishHeader->numCols = NUM_COLS;
+	publishHeader->maxTravelers = MAX_NUM_TRAVELER_THREADS;
+	publishHeader->sequence.store(0);
+	publishIntervalMs = intervalMs > 0 ? intervalMs : 1;
+
+	//	the first frame is complete before anyone can validate the segment
+	writeFrame();
+	atomic_thread_fence(memory_order_release);
+	publishHeader->magic = GRID_SHM_MAGIC;
+	publishLocalReader = gridReaderOpenMapped(publishBase);
+
+	publishRunning = true;
+	if (pthread_create(&publishThreadID, nullptr, publishThread, NULL) != 0)
+	{
+		publishRunning = false;
+		fprintf(stderr, "could not create the grid publisher thread\n");
+		return false;
+	}
+	return true;
+}
+
+void gridPublishStop(void)
+{
+	if (publishBase == NULL)
+		return;
+	if (publishRunning.exchange(false))
+		pthread_join(publishThreadID, NULL);
+	shm_unlink(publishSegmentName);
+}
+
+void gridPublishNow(void)
+{
+	if (publishBase != NULL)
+		writeFrame();
+}
+
+GridReader* gridPublishLocalReader(void)
+{
+	return publishLocalReader;
+}
@@ -0,0 +1,41 @@
+//
+//  gridPublish.h
+//  GL threads
+//
+//  Writer side of the published grid (see gridShared.h).  A publisher
+//	thread copies the grid and the traveler table into a named POSIX
+//	shared-memory segment at a fixed rate.  The front end and external
+//	viewers read frames from there instead of from the simulation globals.
+//
+
+#ifndef GRID_PUBLISH_H
+#define GRID_PUBLISH_H
+
+#include "gridReader.h"
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Creates the segment and starts the publisher thread
+ *  @param name         shm name (starts with '/')
+ *  @param intervalMs   time between two frames (in milliseconds)
+ *  @return true if the segment could be created
+ */
+bool gridPublishStart(const char* name, int intervalMs);
+
+/** Stops the publisher thread and removes the segment's name.  Safe to call
+ *	when nothing was started.
+ */
+void gridPublishStop(void);
+
+/** Writes a frame right away (from the calling thread)
+ */
+void gridPublishNow(void);
+
+/** Reader on this process's own mapping of the segment
+ *  @return the reader, NULL if publication isn't started
+ */
+GridReader* gridPublishLocalReader(void);
+
+#endif // GRID_PUBLISH_H
@@ -0,0 +1,164 @@
+//
+//  gridPyramid.cpp
+//  GL threads
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+//
+#include "gridPyramid.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+//	cells compared at once when looking for changes
+const int PYRAMID_DIFF_CHUNK = 64;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static void markDirty(GridPyramid* pyramid, int level, int row, int col)
+{
+	if (level >= pyramid->numLevels)
+		return;
+	uint32_t index = (uint32_t) row * pyramid->numCols[level] + col;
+	if (!pyramid->dirty[level][index])
+	{
+		pyramid->dirty[level][index] = 1;
+		pyramid->dirtyList[level][pyramid->numDirty[level]++] = index;
+	}
+}
+
+//	Average color of the (up to) 2x2 block of the level below
+static unsigned int averageBlock(const unsigned int* below, int belowRows, int belowCols, int row, int col)
+{
+	unsigned int red = 0, green = 0, blue = 0, count = 0;
+	for (int i=2*row; i<min(2*row+2, belowRows); i++)
+		for (int j=2*col; j<min(2*col+2, belowCols); j++)
+		{
+			unsigned int cell = below[(size_t) i*belowCols + j];
+			red += cell & 0xFF;
+			green += (cell >> 8) & 0xFF;
+			blue += (cell >> 16) & 0xFF;
+			count++;
+		}
+	return 0xFF000000 | (blue/count << 16) | (green/count << 8) | red/count;
+}
+
+static void allocateLevels(GridPyramid* pyramid, int numRows, int numCols)
+{
+	gridPyramidFree(pyramid);
+	pyramid->numRows[0] = numRows;
+	pyramid->numCols[0] = numCols;
+	pyramid->numLevels = 1;
+	while (pyramid->numLevels < MAX_PYRAMID_LEVELS &&
+		   (pyramid->numRows[pyramid->numLevels-1] > 1 || pyramid->numCols[pyramid->numLevels-1] > 1))
+	{
+		int level = pyramid->numLevels++;
+		pyramid->numRows[level] = (pyramid->numRows[level-1] + 1) / 2;
+		pyramid->numCols[level] = (pyramid->numCols[level-1] + 1) / 2;
+		size_t numCells = (size_t) pyramid->numRows[level] * pyramid->numCols[level];
+		pyramid->cells[level] = (unsigned int*) calloc(numCells, sizeof(unsigned int));
+		pyramid->dirty[level] = (uint8_t*) calloc(numCells, sizeof(uint8_t));
+		pyramid->dirtyList[level] = (uint32_t*) malloc(numCells * sizeof(uint32_t));
+		pyramid->numDirty[level] = 0;
+	}
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void gridPyramidInit(GridPyramid* pyramid)
+{
+	memset(pyramid, 0, sizeof(GridPyramid));
+}
+
+void gridPyramidFree(GridPyramid* pyramid)
+{
+	for (int level=1; level<pyramid->numLevels; level++)
+	{
+		free(pyramid->cells[level]);
+		free(pyramid->dirty[level]);
+		free(pyramid->dirtyList[level]);
+	}
+	gridPyramidInit(pyramid);
+}
+
+void gridPyramidUpdate(GridPyramid* pyramid, const GridFrame* frame, const GridFrame* previous)
+{
+	const int numRows = frame->numRows, numCols = frame->numCols;
+	bool rebuild = pyramid->numLevels == 0 || pyramid->numRows[0] != numRows || pyramid->numCols[0] != numCols ||
+					previous == NULL || previous->cells == NULL ||
+					previous->numRows != numRows || previous->numCols != numCols;
+	if (pyramid->numLevels == 0 || pyramid->numRows[0] != numRows || pyramid->numCols[0] != numCols)
+		allocateLevels(pyramid, numRows, numCols);
+
+	//	Flag the blocks of level 1 that hold a changed cell
+	pyramid->cellsChanged = 0;
+	if (rebuild)
+	{
+		pyramid->cellsChanged = (uint64_t) numRows * numCols;
+		for (int i=0; pyramid->numLevels > 1 && i<pyramid->numRows[1]; i++)
+			for (int j=0; j<pyramid->numCols[1]; j++)
+				markDirty(pyramid, 1, i, j);
+	}
+	else
+	{
+		for (int i=0; i<numRows; i++)
+		{
+			const unsigned int* cur = frame->cells + (size_t) i*numCols;
+			const unsigned int* prev = previous->cells + (size_t) i*numCols;
+			for (int j0=0; j0<numCols; j0+=PYRAMID_DIFF_CHUNK)
+			{
+				int n = min(PYRAMID_DIFF_CHUNK, numCols - j0);
+				if (memcmp(cur + j0, prev + j0, n * sizeof(unsigned int)) == 0)
+					continue;
+				for (int j=j0; j<j0+n; j++)
+					if (cur[j] != prev[j])
+					{
+						markDirty(pyramid, 1, i/2, j/2);
+						pyramid->cellsChanged++;
+					}
+			}
+		}
+	}
+
+	//	Recompute the flagged cells, level by level, flagging their parents
+	pyramid->cellsUpdated = 0;
+	for (int level=1; level<pyramid->numLevels; level++)
+	{
+		const unsigned int* below = level == 1 ? frame->cells : pyramid->cells[level-1];
+		const int cols = pyramid->numCols[level];
+		for (uint32_t k=0; k<pyramid->numDirty[level]; k++)
+		{
+			uint32_t index = pyramid->dirtyList[level][k];
+			int row = index / cols, col = index % cols;
+			pyramid->cells[level][index] = averageBlock(below, pyramid->numRows[level-1], pyramid->numCols[level-1],
+														row, col);
+			pyramid->dirty[level][index] = 0;
+			markDirty(pyramid, level+1, row/2, col/2);
+		}
+		pyramid->cellsUpdated += pyramid->numDirty[level];
+		pyramid->numDirty[level] = 0;
+	}
+}
+
+int gridPyramidLevelFor(const GridPyramid* pyramid, int width, int height)
+{
+	int level = 0;
+	while (level < pyramid->numLevels-1 &&
+		   (pyramid->numCols[level] > width || pyramid->numRows[level] > height))
+		level++;
+	return level;
+}
+
+const unsigned int* gridPyramidCells(const GridPyramid* pyramid, const GridFrame* frame, int level)
+{
+	return level == 0 ? frame->cells : pyramid->cells[level];
+}
@@ -0,0 +1,83 @@
+//
+//  gridPyramid.h
+//  GL threads
+//
+//  Multi-resolution copy of a grid frame, for drawing grids that have more
+//	cells than the pane has pixels.  Level 0 is the frame itself; each cell
+//	of level L is the average color of a 2x2 block of level L-1 (so a cell
+//	of level L averages a 2^L x 2^L block of the grid).  When a new frame
+//	comes in, only the cells that changed since the previous frame are
+//	propagated up, through the blocks that contain them.
+//
+
+#ifndef GRID_PYRAMID_H
+#define GRID_PYRAMID_H
+
+#include <cstdint>
+//
+#include "gridReader.h"
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+//	enough for a 65535 x 65535 grid
+const int MAX_PYRAMID_LEVELS = 17;
+
+/** The pyramid
+ *  @var numLevels      levels, including level 0
+ *  @var numRows        rows of each level
+ *  @var numCols        columns of each level
+ *  @var cells          packed RGBA cells of each level (cells[0] is unused:
+ *                      level 0 is the frame's cells)
+ *  @var dirty          per level, flags of the cells to recompute
+ *  @var dirtyList      per level, the cells flagged, in flagging order
+ *  @var numDirty       entries in each dirtyList
+ *  @var cellsChanged   grid cells that differed at the last update (all of
+ *                      them when it rebuilt the pyramid)
+ *  @var cellsUpdated   cells recomputed by the last update (all levels)
+ */
+typedef struct GridPyramid {
+	int numLevels;
+	int numRows[MAX_PYRAMID_LEVELS];
+	int numCols[MAX_PYRAMID_LEVELS];
+	unsigned int* cells[MAX_PYRAMID_LEVELS];
+	uint8_t* dirty[MAX_PYRAMID_LEVELS];
+	uint32_t* dirtyList[MAX_PYRAMID_LEVELS];
+	uint32_t numDirty[MAX_PYRAMID_LEVELS];
+	uint64_t cellsChanged;
+	uint64_t cellsUpdated;
+} GridPyramid;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+void gridPyramidInit(GridPyramid* pyramid);
+void gridPyramidFree(GridPyramid* pyramid);
+
+/** Brings the pyramid up to date with a new frame
+ *  @param pyramid      the pyramid
+ *  @param frame        new frame
+ *  @param previous     frame the pyramid was last updated with (NULL, or a
+ *                      frame of other dimensions: the pyramid is rebuilt)
+ */
+void gridPyramidUpdate(GridPyramid* pyramid, const GridFrame* frame, const GridFrame* previous);
+
+/** Level to draw the grid from at a given resolution
+ *  @param pyramid      the pyramid
+ *  @param width        pixels across
+ *  @param height       pixels down
+ *  @return the finest level that has at most width x height cells
+ */
+int gridPyramidLevelFor(const GridPyramid* pyramid, int width, int height);
+
+/** Cells of a level
+ *  @param pyramid      the pyramid
+ *  @param frame        frame of the last update
+ *  @param level        the level
+ *  @return numRows[level] x numCols[level] packed RGBA cells
+ */
+const unsigned int* gridPyramidCells(const GridPyramid* pyramid, const GridFrame* frame, int level);
+
+#endif // GRID_PYRAMID_H
@@ -0,0 +1,150 @@
+//
+//  gridReader.cpp
+//  GL threads
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+//
+#include "gridReader.h"
+
+using namespace std;
+
+struct GridReader {
+	GridShmHeader* header;
+	const unsigned int* cells;
+	const PublishedTraveler* travelers;
+	//	length of our own mapping (0 if the segment was mapped by someone else)
+	size_t mappedLength;
+};
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+GridReader* gridReaderOpen(const char* name)
+{
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(GridShmHeader))
+	{
+		close(fd);
+		return NULL;
+	}
+	void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return NULL;
+
+	GridShmHeader* header = static_cast<GridShmHeader*>(base);
+	if (header->magic != GRID_SHM_MAGIC || header->version != GRID_SHM_VERSION ||
+		gridShmSize(header->numRows, header->numCols, header->maxTravelers) > (size_t) st.st_size)
+	{
+		munmap(base, st.st_size);
+		return NULL;
+	}
+
+	GridReader* reader = gridReaderOpenMapped(base);
+	reader->mappedLength = st.st_size;
+	return reader;
+}
+
+GridReader* gridReaderOpenMapped(void* base)
+{
+	GridReader* reader = (GridReader*) malloc(sizeof(GridReader));
+	char* bytes = static_cast<char*>(base);
+	reader->header = static_cast<GridShmHeader*>(base);
+	reader->cells = reinterpret_cast<const unsigned int*>(bytes + gridShmCellsOffset());
+	reader->travelers = reinterpret_cast<const PublishedTraveler*>(bytes +
+							gridShmTravelersOffset(reader->header->numRows, reader->header->numCols));
+	reader->mappedLength = 0;
+	return reader;
+}
+
+void gridReaderClose(GridReader* reader)
+{
+	if (reader == NULL)
+		return;
+	if (reader->mappedLength > 0)
+		munmap(reader->header, reader->mappedLength);
+	free(reader);
+}
+
+uint64_t gridReaderGeneration(const GridReader* reader)
+{
+	return reader->header->sequence.load(memory_order_acquire) / 2;
+}
+
+void gridFrameInit(GridFrame* frame)
+{
+	memset(frame, 0, sizeof(GridFrame));
+}
+
+void gridFrameFree(GridFrame* frame)
+{
+	free(frame->cells);
+	free(frame->travelers);
+	gridFrameInit(frame);
+}
+
+bool gridReaderCopyFrame(const GridReader* reader, GridFrame* frame, int maxAttempts)
+{
+	const GridShmHeader* header = reader->header;
+	const int numRows = header->numRows, numCols = header->numCols;
+	const int maxTravelers = header->maxTravelers;
+
+	//	the dimensions never change: size the buffers once
+	if (frame->cells == NULL || frame->numRows != numRows || frame->numCols != numCols)
+	{
+		free(frame->cells);
+		frame->cells = (unsigned int*) malloc((size_t) numRows * numCols * sizeof(unsigned int));
+		frame->numRows = numRows;
+		frame->numCols = numCols;
+	}
+	if (frame->travelers == NULL || frame->capacity != maxTravelers)
+	{
+		free(frame->travelers);
+		frame->travelers = (PublishedTraveler*) malloc(maxTravelers * sizeof(PublishedTraveler));
+		frame->capacity = maxTravelers;
+	}
+
+	for (int attempt=0; attempt<maxAttempts; attempt++)
+	{
+		uint64_t before = header->sequence.load(memory_order_acquire);
+		if (before & 1)
+		{
+			//	writer in the middle of a frame
+			sched_yield();
+			continue;
+		}
+
+		int numTravelers = header->numTravelers;
+		if (numTravelers > maxTravelers)
+			numTravelers = maxTravelers;
+		memcpy(frame->cells, reader->cells, (size_t) numRows * numCols * sizeof(unsigned int));
+		memcpy(frame->travelers, reader->travelers, numTravelers * sizeof(PublishedTraveler));
+		frame->numTravelers = numTravelers;
+		frame->numLiveThreads = header->numLiveThreads;
+		frame->redLevel = header->redLevel;
+		frame->greenLevel = header->greenLevel;
+		frame->blueLevel = header->blueLevel;
+		frame->maxLevel = header->maxLevel;
+		frame->timestampNs = header->timestampNs;
+
+		//	the copies above must complete before sequence is read again
+		atomic_thread_fence(memory_order_acquire);
+		if (header->sequence.load(memory_order_relaxed) == before)
+		{
+			frame->generation = before / 2;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,91 @@
+//
+//  gridReader.h
+//  GL threads
+//
+//  Reader side of the published grid (see gridShared.h).  Copying a frame
+//	out of the segment makes no system call and never blocks the
+//	simulation: the reader just retries if the writer was busy.
+//
+
+#ifndef GRID_READER_H
+#define GRID_READER_H
+
+#include <cstdint>
+//
+#include "gridShared.h"
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+/** A consistent copy of one published frame
+ *  @var generation     frame number
+ *  @var numRows        grid rows
+ *  @var numCols        grid columns
+ *  @var numTravelers   valid entries in travelers
+ *  @var numLiveThreads live travelers
+ *  @var redLevel       red tank level
+ *  @var greenLevel     green tank level
+ *  @var blueLevel      blue tank level
+ *  @var maxLevel       tank capacity
+ *  @var timestampNs    CLOCK_MONOTONIC time at which the frame was written
+ *  @var cells          numRows x numCols packed RGBA cells
+ *  @var travelers      traveler table
+ *  @var capacity       entries allocated in travelers
+ */
+typedef struct GridFrame {
+	uint64_t generation;
+	int numRows;
+	int numCols;
+	int numTravelers;
+	int numLiveThreads;
+	int redLevel;
+	int greenLevel;
+	int blueLevel;
+	int maxLevel;
+	uint64_t timestampNs;
+	unsigned int* cells;
+	PublishedTraveler* travelers;
+	int capacity;
+} GridFrame;
+
+//	Opaque handle on an attached segment
+typedef struct GridReader GridReader;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Attaches to a published grid
+ *  @param name     shm name of the segment (starts with '/')
+ *  @return the reader, or NULL if there is no such segment
+ */
+GridReader* gridReaderOpen(const char* name);
+
+/** Attaches to a segment already mapped in this process
+ *  @param base     start of the segment
+ *  @return the reader
+ */
+GridReader* gridReaderOpenMapped(void* base);
+
+void gridReaderClose(GridReader* reader);
+
+/** Generation of the last frame completely written (cheap: no copy)
+ *  @param reader   the reader
+ *  @return the generation
+ */
+uint64_t gridReaderGeneration(const GridReader* reader);
+
+/** Copies the current frame.  The frame's buffers are (re)allocated as
+ *	needed; initialize the frame with gridFrameInit before the first call.
+ *  @param reader       the reader
+ *  @param frame        receives the copy
+ *  @param maxAttempts  attempts before giving up on a busy writer
+ *  @return true if a consistent frame was copied
+ */
+bool gridReaderCopyFrame(const GridReader* reader, GridFrame* frame, int maxAttempts);
+
+void gridFrameInit(GridFrame* frame);
+void gridFrameFree(GridFrame* frame);
+
+#endif // GRID_READER_H
@@ -0,0 +1,96 @@
+//
+//  gridShared.h
+//  GL threads
+//
+//  Layout of the shared-memory segment in which the simulation publishes
+//	the grid and the traveler table for external viewers.  This header must
+//	stay free of GL (and of the rest of the simulation), since viewers
+//	include it without linking either.
+//
+//	The segment is:	a header, the grid cells (numRows x numCols packed
+//	RGBA ints, row after row), then maxTravelers traveler entries.
+//
+//	Consistency is guaranteed by a seqlock: the writer makes `sequence` odd
+//	before it touches the frame and even again when it's done.  A reader
+//	copies the frame, then checks that `sequence` was even and unchanged
+//	across the copy, and retries otherwise.  sequence/2 is the number of
+//	the frame (the "generation").
+//
+
+#ifndef GRID_SHARED_H
+#define GRID_SHARED_H
+
+#include <atomic>
+#include <cstdint>
+
+const uint32_t GRID_SHM_MAGIC = 0x47524944;	//	"GRID"
+const uint32_t GRID_SHM_VERSION = 1;
+
+/** Published traveler (8 bytes)
+ *  @var row        row location of traveler
+ *  @var col        col location of traveler
+ *  @var dir        TravelDirection (SOUTH=0, WEST, NORTH, EAST)
+ *  @var type       TravelerType (RED_TRAV=0, GREEN_TRAV, BLUE_TRAV)
+ *  @var isLive     0 once the traveler has terminated
+ *  @var flags      PUBLISHED_TRAVELER_* bits, the others reserved
+ */
+typedef struct PublishedTraveler {
+	uint16_t row;
+	uint16_t col;
+	uint8_t dir;
+	uint8_t type;
+	uint8_t isLive;
+	uint8_t flags;
+} PublishedTraveler;
+
+//	the traveler waits for the cell ahead (exclusive cells)
+const uint8_t PUBLISHED_TRAVELER_BLOCKED = 0x01;
+
+/** Segment header
+ *  @var magic          GRID_SHM_MAGIC once the segment is initialized
+ *  @var version        GRID_SHM_VERSION
+ *  @var numRows        grid rows
+ *  @var numCols        grid columns
+ *  @var maxTravelers   size of the traveler table
+ *  @var sequence       seqlock word (odd while a frame is being written)
+ *  @var numTravelers   valid entries in the traveler table
+ *  @var numLiveThreads live travelers
+ *  @var redLevel       red tank level
+ *  @var greenLevel     green tank level
+ *  @var blueLevel      blue tank level
+ *  @var maxLevel       tank capacity
+ *  @var timestampNs    CLOCK_MONOTONIC time at which the frame was written
+ */
+typedef struct alignas(64) GridShmHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numRows;
+	uint32_t numCols;
+	uint32_t maxTravelers;
+	alignas(64) std::atomic<uint64_t> sequence;
+	uint32_t numTravelers;
+	int32_t numLiveThreads;
+	int32_t redLevel;
+	int32_t greenLevel;
+	int32_t blueLevel;
+	int32_t maxLevel;
+	uint64_t timestampNs;
+} GridShmHeader;
+
+inline size_t gridShmCellsOffset(void)
+{
+	return sizeof(GridShmHeader);
+}
+
+inline size_t gridShmTravelersOffset(uint32_t numRows, uint32_t numCols)
+{
+	size_t end = gridShmCellsOffset() + (size_t) numRows * numCols * sizeof(uint32_t);
+	return (end + 63) & ~((size_t) 63);
+}
+
+inline size_t gridShmSize(uint32_t numRows, uint32_t numCols, uint32_t maxTravelers)
+{
+	return gridShmTravelersOffset(numRows, numCols) + maxTravelers * sizeof(PublishedTraveler);
+}
+
+#endif // GRID_SHARED_H
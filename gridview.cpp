@@ -0,0 +1,141 @@
+//
+//  gridview.cpp
+//  GL threads
+//
+//  Command-line viewer for a grid published with `travel -publish <name>`.
+//	Prints the state of the simulation and a character map of the grid,
+//	downsampled to fit a terminal.  With -ansi, draws the grid in color in
+//	place instead, updating only what changed (see termRender.h).  Links
+//	neither GL nor the simulation.
+//
+//	usage:	gridview [-ansi] <name> [interval in ms] [number of frames]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+//
+#include "gridReader.h"
+#include "termRender.h"
+
+using namespace std;
+
+const int MAX_MAP_WIDTH = 78;
+const int MAX_MAP_HEIGHT = 32;
+
+//	direction characters, indexed by TravelDirection (row 0 printed on top)
+const char DIR_CHAR[4] = {'v', '<', '^', '>'};
+//	dominant-channel characters: dim, then bright
+const char DIM_CHAR[3] = {'r', 'g', 'b'};
+const char BRIGHT_CHAR[3] = {'R', 'G', 'B'};
+
+//	set by ^C, so that the terminal is restored on the way out
+volatile sig_atomic_t stopRequested = 0;
+
+void requestStop(int sig)
+{
+	stopRequested = 1;
+}
+
+/** Prints one frame
+ *  @param frame    the frame
+ */
+void printFrame(const GridFrame* frame)
+{
+	const int blockW = (frame->numCols + MAX_MAP_WIDTH - 1) / MAX_MAP_WIDTH;
+	const int blockH = (frame->numRows + MAX_MAP_HEIGHT - 1) / MAX_MAP_HEIGHT;
+	const int mapW = (frame->numCols + blockW - 1) / blockW;
+	const int mapH = (frame->numRows + blockH - 1) / blockH;
+
+	printf("frame %llu  grid %dx%d  live travelers %d  ink R %d G %d B %d (max %d)\n",
+			(unsigned long long) frame->generation, frame->numRows, frame->numCols,
+			frame->numLiveThreads, frame->redLevel, frame->greenLevel, frame->blueLevel,
+			frame->maxLevel);
+
+	char* map = (char*) malloc(mapW * mapH);
+	for (int bi=0; bi<mapH; bi++)
+		for (int bj=0; bj<mapW; bj++)
+		{
+			unsigned long sum[3] = {0, 0, 0};
+			int count = 0;
+			for (int i=bi*blockH; i<(bi+1)*blockH && i<frame->numRows; i++)
+				for (int j=bj*blockW; j<(bj+1)*blockW && j<frame->numCols; j++)
+				{
+					unsigned int cell = frame->cells[i*frame->numCols + j];
+					sum[0] += cell & 0xFF;
+					sum[1] += (cell >> 8) & 0xFF;
+					sum[2] += (cell >> 16) & 0xFF;
+					count++;
+				}
+			int best = 0;
+			for (int c=1; c<3; c++)
+				if (sum[c] > sum[best])
+					best = c;
+			unsigned long avg = sum[best] / count;
+			map[bi*mapW + bj] = avg < 8 ? '.' : (avg < 128 ? DIM_CHAR[best] : BRIGHT_CHAR[best]);
+		}
+
+	for (int k=0; k<frame->numTravelers; k++)
+	{
+		const PublishedTraveler* t = frame->travelers + k;
+		if (t->isLive && t->row < frame->numRows && t->col < frame->numCols)
+			map[(t->row / blockH)*mapW + t->col / blockW] = DIR_CHAR[t->dir & 3];
+	}
+
+	for (int bi=0; bi<mapH; bi++)
+		printf("%.*s\n", mapW, map + bi*mapW);
+	free(map);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+	bool ansiOn = argc > 1 && strcmp(argv[1], "-ansi") == 0;
+	if (ansiOn)
+	{
+		argv++;
+		argc--;
+	}
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s [-ansi] <name> [interval in ms] [number of frames]\n", argv[0]);
+		return 1;
+	}
+	int intervalMs = argc > 2 ? atoi(argv[2]) : (ansiOn ? 100 : 500);
+	int numFrames = argc > 3 ? atoi(argv[3]) : 0;
+
+	GridReader* reader = gridReaderOpen(argv[1]);
+	if (reader == NULL)
+	{
+		fprintf(stderr, "no grid published as %s\n", argv[1]);
+		return 1;
+	}
+
+	TermRenderer* renderer = ansiOn ? termRendererCreate(STDOUT_FILENO) : NULL;
+	signal(SIGINT, requestStop);
+
+	GridFrame frame;
+	gridFrameInit(&frame);
+	for (int k=0; (numFrames == 0 || k < numFrames) && !stopRequested; k++)
+	{
+		if (!gridReaderCopyFrame(reader, &frame, 100))
+			fprintf(stderr, "could not get a consistent frame\n");
+		else if (renderer != NULL)
+			termRendererDraw(renderer, &frame);
+		else
+			printFrame(&frame);
+		usleep(intervalMs * 1000);
+	}
+
+	if (renderer != NULL)
+	{
+		termRendererRestore(renderer);
+		termRendererPrintReport(renderer, stderr);
+		termRendererDestroy(renderer);
+	}
+	gridFrameFree(&frame);
+	gridReaderClose(reader);
+	return 0;
+}
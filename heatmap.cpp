@@ -0,0 +1,265 @@
+//
+//  heatmap.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+//
+#include "heatmap.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+//	The counters of a cell, together: one cache line touched per deposit
+typedef struct CellCounters {
+	uint32_t count[NUM_HEAT_QUANTITIES];
+} CellCounters;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+CellCounters* heatCounters = NULL;
+int heatNumRows = 0, heatNumCols = 0;
+int heatIntervalMs = 0;
+
+//	Latest snapshot, and the snapshots that can be reused.  A snapshot's
+//	refs counts its readers, plus one while it is the latest.
+pthread_mutex_t heat_lock = PTHREAD_MUTEX_INITIALIZER;
+HeatmapSnapshot* heatCurrent = NULL;
+vector<HeatmapSnapshot*>& heatSnapshots = *new vector<HeatmapSnapshot*>;
+//	one snapshot built at a time
+pthread_mutex_t heat_build_lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t heatGeneration = 0;
+double heatBuildSeconds = 0.;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static uint64_t nowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static HeatmapSnapshot* newSnapshot(void)
+{
+	HeatmapSnapshot* snapshot = (HeatmapSnapshot*) calloc(1, sizeof(HeatmapSnapshot));
+	size_t numEntries = (size_t) (heatNumRows + 1) * (heatNumCols + 1);
+	for (int q=0; q<NUM_HEAT_QUANTITIES; q++)
+		snapshot->sat[q] = (uint32_t*) calloc(numEntries, sizeof(uint32_t));
+	snapshot->numRows = heatNumRows;
+	snapshot->numCols = heatNumCols;
+	heatSnapshots.push_back(snapshot);
+	return snapshot;
+}
+
+//	Caller holds heat_build_lock: a snapshot nobody holds, or a new one
+static HeatmapSnapshot* freeSnapshot(void)
+{
+	pthread_mutex_lock(&heat_lock);
+	HeatmapSnapshot* snapshot = NULL;
+	for (unsigned int k=0; k<heatSnapshots.size() && snapshot == NULL; k++)
+		if (heatSnapshots[k]->refs == 0)
+			snapshot = heatSnapshots[k];
+	if (snapshot == NULL)
+		snapshot = newSnapshot();
+	pthread_mutex_unlock(&heat_lock);
+	return snapshot;
+}
+
+/** Builds the summed-area tables of all the quantities in one pass over
+ *	the counters, and ranks the hottest cells
+ */
+static void buildSnapshot(HeatmapSnapshot* snapshot)
+{
+	int width = heatNumCols + 1;
+	//	min-heap of the hottest cells seen so far
+	priority_queue<pair<uint32_t, int>, vector<pair<uint32_t, int> >, greater<pair<uint32_t, int> > > hottest;
+
+	for (int r=0; r<heatNumRows; r++)
+	{
+		uint32_t rowSum[NUM_HEAT_QUANTITIES] = {0};
+		const CellCounters* counters = heatCounters + (size_t) r * heatNumCols;
+		for (int c=0; c<heatNumCols; c++)
+		{
+			size_t above = (size_t) r * width + c + 1;
+			for (int q=0; q<NUM_HEAT_QUANTITIES; q++)
+			{
+				//	wraps around modulo 2^32, which rectangle totals undo
+				rowSum[q] += __atomic_load_n(&counters[c].count[q], __ATOMIC_RELAXED);
+				snapshot->sat[q][above + width] = snapshot->sat[q][above] + rowSum[q];
+			}
+
+			uint32_t visits = __atomic_load_n(&counters[c].count[HEAT_VISITS], __ATOMIC_RELAXED);
+			if (visits == 0)
+				continue;
+			if ((int) hottest.size() < HEAT_TOP_CELLS)
+				hottest.push(make_pair(visits, r * heatNumCols + c));
+			else if (visits > hottest.top().first)
+			{
+				hottest.pop();
+				hottest.push(make_pair(visits, r * heatNumCols + c));
+			}
+		}
+	}
+
+	snapshot->numHottest = (int) hottest.size();
+	for (int k=snapshot->numHottest-1; k>=0; k--)
+	{
+		snapshot->hottest[k].row = hottest.top().second / heatNumCols;
+		snapshot->hottest[k].col = hottest.top().second % heatNumCols;
+		snapshot->hottest[k].visits = hottest.top().first;
+		hottest.pop();
+	}
+}
+
+static void* snapshotThread(void* data)
+{
+	while (true)
+	{
+		usleep(heatIntervalMs * 1000);
+		heatmapSnapshotNow();
+	}
+	return NULL;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void heatmapInitialize(int numRows, int numCols)
+{
+	heatNumRows = numRows;
+	heatNumCols = numCols;
+	heatCounters = (CellCounters*) calloc((size_t) numRows * numCols, sizeof(CellCounters));
+}
+
+void heatmapRecord(int row, int col, int channel, int amount)
+{
+	CellCounters* counters = heatCounters + (size_t) row * heatNumCols + col;
+	__atomic_fetch_add(&counters->count[HEAT_VISITS], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&counters->count[HEAT_RED + channel], amount, __ATOMIC_RELAXED);
+}
+
+void heatmapStart(int intervalMs)
+{
+	heatIntervalMs = max(1, intervalMs);
+	pthread_t threadID;
+	if (pthread_create(&threadID, nullptr, snapshotThread, NULL) != 0)
+	{
+		fprintf(stderr, "could not create the heatmap snapshot thread\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void heatmapSnapshotNow(void)
+{
+	pthread_mutex_lock(&heat_build_lock);
+	uint64_t start = nowNs();
+	HeatmapSnapshot* snapshot = freeSnapshot();
+	buildSnapshot(snapshot);
+	snapshot->generation = ++heatGeneration;
+	snapshot->timestampNs = nowNs();
+	heatBuildSeconds += (snapshot->timestampNs - start) * 1e-9;
+
+	pthread_mutex_lock(&heat_lock);
+	if (heatCurrent != NULL)
+		heatCurrent->refs--;
+	heatCurrent = snapshot;
+	snapshot->refs = 1;
+	pthread_mutex_unlock(&heat_lock);
+	pthread_mutex_unlock(&heat_build_lock);
+}
+
+const HeatmapSnapshot* heatmapAcquire(void)
+{
+	pthread_mutex_lock(&heat_lock);
+	HeatmapSnapshot* snapshot = heatCurrent;
+	if (snapshot != NULL)
+		snapshot->refs++;
+	pthread_mutex_unlock(&heat_lock);
+	return snapshot;
+}
+
+void heatmapRelease(const HeatmapSnapshot* snapshot)
+{
+	if (snapshot == NULL)
+		return;
+	pthread_mutex_lock(&heat_lock);
+	const_cast<HeatmapSnapshot*>(snapshot)->refs--;
+	pthread_mutex_unlock(&heat_lock);
+}
+
+uint32_t heatmapRectSum(const HeatmapSnapshot* snapshot, HeatQuantity quantity,
+						int row0, int col0, int row1, int col1)
+{
+	row0 = max(row0, 0);
+	col0 = max(col0, 0);
+	row1 = min(row1, snapshot->numRows);
+	col1 = min(col1, snapshot->numCols);
+	if (row0 >= row1 || col0 >= col1)
+		return 0;
+
+	const uint32_t* sat = snapshot->sat[quantity];
+	size_t width = snapshot->numCols + 1;
+	return sat[row1 * width + col1] - sat[row0 * width + col1] - sat[row1 * width + col0] + sat[row0 * width + col0];
+}
+
+void heatmapPrintReport(FILE* out)
+{
+	//	a final snapshot, so that the report covers the whole run
+	heatmapSnapshotNow();
+	const HeatmapSnapshot* snapshot = heatmapAcquire();
+	int rows = snapshot->numRows, cols = snapshot->numCols;
+	const char* names[NUM_HEAT_QUANTITIES] = {"visits", "red ink", "green ink", "blue ink"};
+
+	fprintf(out, "Heatmap: %llu snapshots, %.2f ms per snapshot\n", (unsigned long long) snapshot->generation,
+			1e3 * heatBuildSeconds / snapshot->generation);
+	fprintf(out, "  %-10s %12s %12s %12s %12s %12s\n", "", "grid", "top-left", "top-right", "bottom-left",
+			"bottom-right");
+	for (int q=0; q<NUM_HEAT_QUANTITIES; q++)
+	{
+		HeatQuantity quantity = static_cast<HeatQuantity>(q);
+		fprintf(out, "  %-10s %12u %12u %12u %12u %12u\n", names[q],
+				heatmapRectSum(snapshot, quantity, 0, 0, rows, cols),
+				heatmapRectSum(snapshot, quantity, 0, 0, rows/2, cols/2),
+				heatmapRectSum(snapshot, quantity, 0, cols/2, rows/2, cols),
+				heatmapRectSum(snapshot, quantity, rows/2, 0, rows, cols/2),
+				heatmapRectSum(snapshot, quantity, rows/2, cols/2, rows, cols));
+	}
+	fprintf(out, "  hottest cells:");
+	for (int k=0; k<min(5, snapshot->numHottest); k++)
+		fprintf(out, " (%d,%d) %u", snapshot->hottest[k].row, snapshot->hottest[k].col, snapshot->hottest[k].visits);
+	fprintf(out, "\n");
+
+	//	time random rectangle queries
+	const int NUM_QUERIES = 1000000;
+	unsigned int seed = 1;
+	uint32_t checksum = 0;
+	uint64_t start = nowNs();
+	for (int k=0; k<NUM_QUERIES; k++)
+	{
+		seed = seed * 1103515245u + 12345u;
+		int row0 = (seed >> 8) % rows, col0 = (seed >> 16) % cols;
+		checksum += heatmapRectSum(snapshot, HEAT_VISITS, row0, col0, row0 + 1 + (seed % rows), col0 + 1 + (seed % cols));
+	}
+	double queryNs = (double) (nowNs() - start) / NUM_QUERIES;
+	fprintf(out, "  %.1f ns per rectangle query (checksum %u)\n", queryNs, checksum);
+	heatmapRelease(snapshot);
+}
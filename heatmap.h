@@ -0,0 +1,118 @@
+//
+//  heatmap.h
+//  GL threads
+//
+//  Per-cell visit and deposit analytics.  The paint path counts, for every
+//	cell, the visits of travelers and the ink deposited per channel (with
+//	relaxed atomic increments: travelers never wait).  At a fixed rate, a
+//	snapshot thread turns the counters into summed-area tables, so that the
+//	total of any rectangle is 4 lookups, and ranks the hottest cells.
+//	Queries run against a snapshot, which stays valid (and unchanged) until
+//	released, whatever the simulation does meanwhile.
+//
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <cstdint>
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+typedef enum HeatQuantity {
+								HEAT_VISITS = 0,
+								HEAT_RED,
+								HEAT_GREEN,
+								HEAT_BLUE,
+								//
+								NUM_HEAT_QUANTITIES
+} HeatQuantity;
+
+/** A hot cell
+ *  @var row, col   cell
+ *  @var visits     visits counted in the snapshot
+ */
+typedef struct HeatCell {
+	int row;
+	int col;
+	uint32_t visits;
+} HeatCell;
+
+//	number of hottest cells ranked in each snapshot
+const int HEAT_TOP_CELLS = 16;
+
+/** Snapshot of the counters.  The summed-area tables have (numRows+1) x
+ *	(numCols+1) entries, sat[q][r * (numCols+1) + c] being the total of the
+ *	cells above and left of (r, c).  They are kept modulo 2^32, which gives
+ *	exact rectangle totals up to 2^32 - 1.
+ *  @var numRows, numCols   grid dimensions
+ *  @var generation         snapshot number
+ *  @var timestampNs        time of the snapshot (CLOCK_MONOTONIC, ns)
+ *  @var sat                summed-area table of each quantity
+ *  @var hottest            most visited cells, hottest first
+ *  @var numHottest         number of entries in hottest
+ */
+typedef struct HeatmapSnapshot {
+	int numRows;
+	int numCols;
+	uint64_t generation;
+	uint64_t timestampNs;
+	uint32_t* sat[NUM_HEAT_QUANTITIES];
+	HeatCell hottest[HEAT_TOP_CELLS];
+	int numHottest;
+	//	readers holding the snapshot (under the heatmap's snapshot lock)
+	int refs;
+} HeatmapSnapshot;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Allocates the counters
+ *  @param numRows      number of rows
+ *  @param numCols      number of columns
+ */
+void heatmapInitialize(int numRows, int numCols);
+
+/** Counts a visit and its deposit (called from the paint path)
+ *  @param row, col     cell painted
+ *  @param channel      channel of the ink (0: red, 1: green, 2: blue)
+ *  @param amount       ink deposited
+ */
+void heatmapRecord(int row, int col, int channel, int amount);
+
+/** Starts the snapshot thread
+ *  @param intervalMs   time between two snapshots (in milliseconds)
+ */
+void heatmapStart(int intervalMs);
+
+/** Takes a snapshot right away (from the calling thread)
+ */
+void heatmapSnapshotNow(void);
+
+/** Latest snapshot, held until heatmapRelease
+ *  @return the snapshot, NULL if none was taken yet
+ */
+const HeatmapSnapshot* heatmapAcquire(void);
+
+void heatmapRelease(const HeatmapSnapshot* snapshot);
+
+/** Total of a quantity over a rectangle of cells, in O(1)
+ *  @param snapshot     snapshot queried
+ *  @param quantity     visits, or ink of one channel
+ *  @param row0, col0   first cell of the rectangle
+ *  @param row1, col1   end of the rectangle (excluded)
+ *  @return the total (clipped to the grid; 0 for an empty rectangle)
+ */
+uint32_t heatmapRectSum(const HeatmapSnapshot* snapshot, HeatQuantity quantity,
+						int row0, int col0, int row1, int col1);
+
+/** Prints the latest snapshot's totals per quadrant, its hottest cells,
+ *	and the snapshot and query times
+ *  @param out          output stream
+ */
+void heatmapPrintReport(FILE* out);
+
+#endif // HEATMAP_H
@@ -0,0 +1,193 @@
+//
+//  inkHistory.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+//
+#include "inkHistory.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//	Simulation state (main.cpp)
+//---------------------------------------------------------------------------
+
+extern int numLiveThreads;
+extern int redLevel, greenLevel, blueLevel;
+extern int MAX_LEVEL;
+//	running totals of the ink functions, per tank
+extern unsigned long inkConsumed[], inkRefilled[];
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+const char* HISTORY_CHANNEL_NAME[INK_HISTORY_CHANNELS] = {"red", "green", "blue"};
+//	columns of the sparklines of the summary
+const int HISTORY_SPARK_WIDTH = 60;
+//	eighth blocks, in UTF-8, from the lowest
+const char* HISTORY_SPARK_CHAR[8] = {"\xe2\x96\x81", "\xe2\x96\x82", "\xe2\x96\x83", "\xe2\x96\x84",
+									 "\xe2\x96\x85", "\xe2\x96\x86", "\xe2\x96\x87", "\xe2\x96\x88"};
+
+InkSample historyRing[INK_HISTORY_SIZE];
+//	samples written so far: sample k is in slot k % INK_HISTORY_SIZE
+atomic<uint64_t> historyCount(0);
+int historyIntervalMs = 100;
+
+//	totals at the previous sample
+unsigned long historyConsumed[INK_HISTORY_CHANNELS], historyRefilled[INK_HISTORY_CHANNELS];
+uint64_t historyLastNs = 0;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static uint64_t nowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+//	Takes a sample (sampler thread only)
+static void takeSample(void)
+{
+	uint64_t count = historyCount.load(memory_order_relaxed);
+	InkSample* sample = historyRing + count % INK_HISTORY_SIZE;
+	uint64_t now = nowNs();
+	double seconds = historyLastNs > 0 ? (now - historyLastNs) * 1e-9 : 0.;
+
+	const int* LEVELS[INK_HISTORY_CHANNELS] = {&redLevel, &greenLevel, &blueLevel};
+	sample->timestampNs = now;
+	sample->numLiveThreads = __atomic_load_n(&numLiveThreads, __ATOMIC_RELAXED);
+	for (int c=0; c<INK_HISTORY_CHANNELS; c++)
+	{
+		sample->level[c] = __atomic_load_n(LEVELS[c], __ATOMIC_RELAXED);
+		unsigned long consumed = __atomic_load_n(inkConsumed + c, __ATOMIC_RELAXED);
+		unsigned long refilled = __atomic_load_n(inkRefilled + c, __ATOMIC_RELAXED);
+		sample->consumedPerSec[c] = seconds > 0. ? (consumed - historyConsumed[c]) / seconds : 0.f;
+		sample->refilledPerSec[c] = seconds > 0. ? (refilled - historyRefilled[c]) / seconds : 0.f;
+		historyConsumed[c] = consumed;
+		historyRefilled[c] = refilled;
+	}
+	historyLastNs = now;
+	historyCount.store(count + 1, memory_order_release);
+}
+
+static void* samplerThread(void* data)
+{
+	while (true)
+	{
+		takeSample();
+		usleep(historyIntervalMs * 1000);
+	}
+	return NULL;
+}
+
+//	Level of each column of a sparkline: the mean of the samples it covers
+static void printSparkline(FILE* out, const InkSample* samples, int numSamples, int channel, double maxValue)
+{
+	int width = min(numSamples, HISTORY_SPARK_WIDTH);
+	for (int k=0; k<width; k++)
+	{
+		int first = (int) ((long) k * numSamples / width), end = (int) ((long) (k+1) * numSamples / width);
+		double total = 0.;
+		for (int s=first; s<end; s++)
+			total += channel >= 0 ? samples[s].level[channel] : samples[s].numLiveThreads;
+		double value = total / max(1, end - first);
+		int step = maxValue > 0. ? (int) (7.99 * value / maxValue) : 0;
+		fputs(HISTORY_SPARK_CHAR[min(7, max(0, step))], out);
+	}
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void inkHistoryStart(int intervalMs)
+{
+	historyIntervalMs = max(1, intervalMs);
+	pthread_t threadID;
+	if (pthread_create(&threadID, nullptr, samplerThread, NULL) != 0)
+	{
+		fprintf(stderr, "could not create the ink sampler thread\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+uint64_t inkHistoryCount(void)
+{
+	return historyCount.load(memory_order_acquire);
+}
+
+int inkHistoryCopy(InkSample* samples, int maxSamples)
+{
+	uint64_t end = historyCount.load(memory_order_acquire);
+	int n = (int) min((uint64_t) min(maxSamples, INK_HISTORY_SIZE), end);
+	uint64_t first = end - n;
+	for (int k=0; k<n; k++)
+		samples[k] = historyRing[(first + k) % INK_HISTORY_SIZE];
+
+	//	The writer may be filling slot `now` (overwriting sample now - SIZE):
+	//	the samples before now + 1 - SIZE may be torn in the copy
+	atomic_thread_fence(memory_order_acquire);
+	uint64_t now = historyCount.load(memory_order_relaxed);
+	uint64_t oldestValid = now + 1 > (uint64_t) INK_HISTORY_SIZE ? now + 1 - INK_HISTORY_SIZE : 0;
+	if (oldestValid > first)
+	{
+		int dropped = (int) min((uint64_t) n, oldestValid - first);
+		memmove(samples, samples + dropped, (n - dropped) * sizeof(InkSample));
+		n -= dropped;
+	}
+	return n;
+}
+
+void inkHistoryPrintSummary(FILE* out)
+{
+	static InkSample samples[INK_HISTORY_SIZE];
+	int n = inkHistoryCopy(samples, INK_HISTORY_SIZE);
+	if (n == 0)
+		return;
+	double span = (samples[n-1].timestampNs - samples[0].timestampNs) * 1e-9;
+	fprintf(out, "Ink history: %d samples every %d ms (last %.1f s), levels out of %d\n", n, historyIntervalMs,
+			span, MAX_LEVEL);
+
+	for (int c=0; c<INK_HISTORY_CHANNELS; c++)
+	{
+		int minLevel = samples[0].level[c], maxLevel = samples[0].level[c], numEmpty = 0, emptySpells = 0;
+		double total = 0., consumed = 0., refilled = 0.;
+		for (int k=0; k<n; k++)
+		{
+			minLevel = min(minLevel, samples[k].level[c]);
+			maxLevel = max(maxLevel, samples[k].level[c]);
+			total += samples[k].level[c];
+			numEmpty += samples[k].level[c] == 0;
+			emptySpells += samples[k].level[c] == 0 && (k == 0 || samples[k-1].level[c] > 0);
+			consumed += samples[k].consumedPerSec[c];
+			refilled += samples[k].refilledPerSec[c];
+		}
+		fprintf(out, "  %-5s level %3d..%-3d mean %5.1f  empty %5.1f%% (%d spells)  consumed %7.1f/s  refilled %7.1f/s  ",
+				HISTORY_CHANNEL_NAME[c], minLevel, maxLevel, total / n, 100. * numEmpty / n, emptySpells,
+				consumed / n, refilled / n);
+		printSparkline(out, samples, n, c, MAX_LEVEL);
+		fputc('\n', out);
+	}
+
+	int minLive = samples[0].numLiveThreads, maxLive = samples[0].numLiveThreads;
+	for (int k=0; k<n; k++)
+	{
+		minLive = min(minLive, samples[k].numLiveThreads);
+		maxLive = max(maxLive, samples[k].numLiveThreads);
+	}
+	fprintf(out, "  live travelers %d..%d  ", minLive, maxLive);
+	printSparkline(out, samples, n, -1, maxLive);
+	fputc('\n', out);
+}
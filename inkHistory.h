@@ -0,0 +1,72 @@
+//
+//  inkHistory.h
+//  GL threads
+//
+//  Time series of the ink tanks.  A sampler thread records, at a fixed
+//	rate, the level of each tank, the live travelers, and the ink consumed
+//	and refilled per second since the previous sample, into a ring of the
+//	last INK_HISTORY_SIZE samples.  The sampler never takes ink_lock: it
+//	reads the levels and the running totals of the ink functions with
+//	relaxed loads.  The ring has a single writer; readers copy it without
+//	locking and drop whatever the writer overwrote during the copy, as the
+//	readers of the published grid do.
+//
+
+#ifndef INK_HISTORY_H
+#define INK_HISTORY_H
+
+#include <cstdint>
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+//	samples kept in the ring
+const int INK_HISTORY_SIZE = 512;
+//	tanks sampled (one per TravelerType)
+const int INK_HISTORY_CHANNELS = 3;
+
+/** One sample
+ *  @var timestampNs        CLOCK_MONOTONIC time of the sample
+ *  @var level              level of each tank
+ *  @var numLiveThreads     live travelers
+ *  @var consumedPerSec     ink acquired by travelers per second, per tank
+ *  @var refilledPerSec     ink added by producers per second, per tank
+ */
+typedef struct InkSample {
+	uint64_t timestampNs;
+	int level[INK_HISTORY_CHANNELS];
+	int numLiveThreads;
+	float consumedPerSec[INK_HISTORY_CHANNELS];
+	float refilledPerSec[INK_HISTORY_CHANNELS];
+} InkSample;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Starts the sampler thread
+ *  @param intervalMs   time between two samples (in milliseconds)
+ */
+void inkHistoryStart(int intervalMs);
+
+/** Number of samples taken so far (cheap: tells readers whether to copy)
+ *  @return the count
+ */
+uint64_t inkHistoryCount(void);
+
+/** Copies the latest samples, oldest first
+ *  @param samples      receives the samples
+ *  @param maxSamples   room in samples
+ *  @return number of samples copied
+ */
+int inkHistoryCopy(InkSample* samples, int maxSamples);
+
+/** Prints, per tank, the range and mean of the level, the time spent
+ *	empty, the consumption and refill rates, and a sparkline of the level
+ *  @param out          output stream
+ */
+void inkHistoryPrintSummary(FILE* out);
+
+#endif // INK_HISTORY_H
@@ -0,0 +1,218 @@
+//
+//  inkMix.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+//
+#include "inkMix.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//	Simulation state (main.cpp)
+//---------------------------------------------------------------------------
+
+extern int redLevel, greenLevel, blueLevel;
+extern int MAX_LEVEL;
+bool acquireRedInk(int theRed);
+bool refillRedInk(int theRed);
+bool refillGreenInk(int theGreen);
+bool refillBlueInk(int theBlue);
+bool acquireInkMix(int theRed, int theGreen, int theBlue);
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+typedef enum InkMixBenchCase {
+								LOCKED_SINGLE_CASE = 0,
+								LOCKED_MIXED_CASE,
+								PACKED_SINGLE_CASE,
+								PACKED_MIXED_CASE,
+								//
+								NUM_INK_MIX_CASES
+} InkMixBenchCase;
+
+/** A benchmark thread
+ *  @var benchCase  what it times
+ *  @var pairs      take/give pairs done
+ *  @var failures   takes that found a tank short
+ */
+typedef struct alignas(64) InkMixBenchThread {
+	InkMixBenchCase benchCase;
+	unsigned long pairs;
+	unsigned long failures;
+} InkMixBenchThread;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+int inkMixRecipe[3] = {1, 0, 2};
+int inkMixChannel = 2;
+int inkMixShare = 0;
+
+const char* INK_MIX_CASE_NAME[NUM_INK_MIX_CASES] = {"locked single", "locked mixed", "packed CAS single",
+													"packed CAS mixed"};
+const double INK_MIX_BENCH_SECONDS = 0.5;
+//	bits of a tank in the packed word (three tanks: 63 bits)
+const int PACKED_TANK_BITS = 21;
+const int BENCH_LEVEL = 1 << 20;
+
+atomic<uint64_t> packedTanks(0);
+atomic<bool> mixBenchGo(false), mixBenchStop(false);
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static uint64_t pack(int red, int green, int blue)
+{
+	return (uint64_t) red | ((uint64_t) green << PACKED_TANK_BITS) | ((uint64_t) blue << (2 * PACKED_TANK_BITS));
+}
+
+/** Takes a recipe from the packed tanks, all or nothing.  No borrow can
+ *	cross fields, since every field is checked to cover its share first.
+ */
+static bool packedTake(uint64_t need)
+{
+	const uint64_t FIELD = (1ULL << PACKED_TANK_BITS) - 1;
+	uint64_t levels = packedTanks.load(memory_order_relaxed);
+	do
+	{
+		for (int c=0; c<3; c++)
+			if (((levels >> (c * PACKED_TANK_BITS)) & FIELD) < ((need >> (c * PACKED_TANK_BITS)) & FIELD))
+				return false;
+	} while (!packedTanks.compare_exchange_weak(levels, levels - need, memory_order_acquire, memory_order_relaxed));
+	return true;
+}
+
+static void* benchThread(void* data)
+{
+	InkMixBenchThread* self = (InkMixBenchThread*) data;
+	const int* r = inkMixRecipe;
+	const uint64_t single = pack(1, 0, 0), mixed = pack(r[0], r[1], r[2]);
+	while (!mixBenchGo.load(memory_order_acquire))
+		;
+	while (!mixBenchStop.load(memory_order_relaxed))
+	{
+		bool taken;
+		switch (self->benchCase)
+		{
+			case LOCKED_SINGLE_CASE:
+				if ((taken = acquireRedInk(1)))
+					refillRedInk(1);
+				break;
+			case LOCKED_MIXED_CASE:
+				//	given back as the producers would, one tank at a time
+				if ((taken = acquireInkMix(r[0], r[1], r[2])))
+				{
+					if (r[0] > 0)
+						refillRedInk(r[0]);
+					if (r[1] > 0)
+						refillGreenInk(r[1]);
+					if (r[2] > 0)
+						refillBlueInk(r[2]);
+				}
+				break;
+			case PACKED_SINGLE_CASE:
+				if ((taken = packedTake(single)))
+					packedTanks.fetch_add(single, memory_order_release);
+				break;
+			default:
+				if ((taken = packedTake(mixed)))
+					packedTanks.fetch_add(mixed, memory_order_release);
+				break;
+		}
+		self->pairs += taken;
+		self->failures += !taken;
+	}
+	return NULL;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+bool inkMixParse(const char* text)
+{
+	int amount[3];
+	char end;
+	if (sscanf(text, "%d,%d,%d%c", amount, amount+1, amount+2, &end) != 3)
+		return false;
+	int total = 0;
+	for (int c=0; c<3; c++)
+	{
+		if (amount[c] < 0 || amount[c] > MAX_LEVEL)
+			return false;
+		total += amount[c];
+	}
+	if (total == 0)
+		return false;
+	inkMixChannel = 0;
+	for (int c=0; c<3; c++)
+	{
+		inkMixRecipe[c] = amount[c];
+		if (amount[c] > amount[inkMixChannel])
+			inkMixChannel = c;
+	}
+	return true;
+}
+
+void inkMixBenchmark(int numThreads, FILE* out)
+{
+	//	tanks that never run dry: the takes are all timed
+	MAX_LEVEL = 2 * BENCH_LEVEL;
+	redLevel = greenLevel = blueLevel = BENCH_LEVEL;
+	fprintf(out, "Ink take/give pairs, %d thread(s), %.1f s each, recipe %d red + %d green + %d blue\n", numThreads,
+			INK_MIX_BENCH_SECONDS, inkMixRecipe[0], inkMixRecipe[1], inkMixRecipe[2]);
+
+	double rate[NUM_INK_MIX_CASES];
+	for (int benchCase=0; benchCase<NUM_INK_MIX_CASES; benchCase++)
+	{
+		packedTanks = pack(BENCH_LEVEL, BENCH_LEVEL, BENCH_LEVEL);
+		mixBenchGo = false;
+		mixBenchStop = false;
+		vector<InkMixBenchThread> threads(numThreads);
+		vector<pthread_t> threadIDs(numThreads);
+		for (int k=0; k<numThreads; k++)
+		{
+			threads[k] = {(InkMixBenchCase) benchCase, 0, 0};
+			if (pthread_create(&threadIDs[k], nullptr, benchThread, &threads[k]) != 0)
+			{
+				fprintf(stderr, "could not create ink benchmark thread %d\n", k);
+				exit(EXIT_FAILURE);
+			}
+		}
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		mixBenchGo.store(true, memory_order_release);
+		usleep((useconds_t) (INK_MIX_BENCH_SECONDS * 1e6));
+		mixBenchStop = true;
+		unsigned long pairs = 0, failures = 0;
+		for (int k=0; k<numThreads; k++)
+		{
+			pthread_join(threadIDs[k], NULL);
+			pairs += threads[k].pairs;
+			failures += threads[k].failures;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+		rate[benchCase] = pairs / seconds;
+		fprintf(out, "  %-18s %8.2f M pairs/s", INK_MIX_CASE_NAME[benchCase], rate[benchCase] * 1e-6);
+		//	each mixed case against the single-color case of its kind
+		if (benchCase == LOCKED_MIXED_CASE || benchCase == PACKED_MIXED_CASE)
+			fprintf(out, "  (%.2fx single)", rate[benchCase] / rate[benchCase-1]);
+		if (failures > 0)
+			fprintf(out, "  %lu takes failed", failures);
+		fputc('\n', out);
+	}
+}
@@ -0,0 +1,54 @@
+//
+//  inkMix.h
+//  GL threads
+//
+//  Mixed-color travelers.  A mixed traveler paints every cell with a
+//	recipe of inks (say 1 red + 2 blue), which it must take from several
+//	tanks at once: taking from one tank, then failing on the next, would
+//	hold ink it cannot spend (and, with a lock per tank, two travelers
+//	taking in opposite orders would deadlock).  acquireInkMix (main.cpp)
+//	takes the whole recipe or nothing, under ink_lock.
+//
+//	The benchmark compares that primitive with the single-color path, and
+//	with a lock-free version (the three levels packed in one 64-bit word,
+//	taken by compare-and-swap) that the simulation could switch to.
+//
+
+#ifndef INK_MIX_H
+#define INK_MIX_H
+
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+//	ink of each tank taken per cell by a mixed traveler (at most MAX_LEVEL:
+//	a full tank), and the channel of the most of it (its color in the
+//	traveler table).  A cell gets TRAV_INK_INCR per unit of each ink, and a
+//	channel saturates at 255: amounts above 255 / TRAV_INK_INCR all paint a
+//	full channel.
+extern int inkMixRecipe[3];
+extern int inkMixChannel;
+//	percentage of the travelers spawned mixed (0: none)
+extern int inkMixShare;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Sets the recipe from "r,g,b"
+ *  @param text     the recipe (amounts from 0 to MAX_LEVEL, not all 0)
+ *  @return false if the text is not a recipe, or one a full tank cannot
+ *          hold
+ */
+bool inkMixParse(const char* text);
+
+/** Times take/give pairs on the tanks, single-color and mixed, through the
+ *	locked functions of main.cpp and through packed compare-and-swap
+ *  @param numThreads   threads taking ink at once
+ *  @param out          output stream
+ */
+void inkMixBenchmark(int numThreads, FILE* out);
+
+#endif // INK_MIX_H
@@ -23,6 +23,47 @@
  |		- 'r' --> add red ink												|
  |		- 'g' --> add green ink												|
  |		- 'b' --> add blue ink												|
+ |																			|
+ |	Command line options (anything else is passed on to glut):				|
+ |		-numa			bind travelers and grid bands to NUMA nodes			|
+ |		-numareport		print the per-node remote-access ratio on exit		|
+ |		-headless <s>	run for s seconds without the GL front end			|
+ |		-grid <r> <c>	grid dimensions										|
+ |		-travelers <n>	number of traveler threads							|
+ |		-stepdelay <us>	traveler sleep time per step						|
+ |		-producersleep <us>	initial producer sleep time						|
+ |		-shards <k>		run as k shard processes (headless)					|
+ |		-publish <name>	publish the grid in shm segment <name> for viewers	|
+ |		-spawnrate <r>	recycle dead travelers' slots, respawning r per s	|
+ |		-coro <w>		run travelers as coroutines on w executor threads	|
+ |		-wheel <us>		sleep through a shared timing wheel (tick in us)	|
+ |		-timerreport	print sleep lateness and system calls on exit		|
+ |		-layoutbench <n>	benchmark the traveler table layouts on n threads	|
+ |		-paintbuffer	buffer deposits per thread, merge them with SIMD	|
+ |		-paintbench <n>	benchmark buffered vs locked deposits on n threads	|
+ |		-decay <f>		fade the trails by a factor f every decay period	|
+ |		-blur			blur the trails with their neighbours as they fade	|
+ |		-decaybench <r> <c>	benchmark the decay pass on an r x c grid		|
+ |		-heatmap		count visits and deposits per cell, report on exit	|
+ |		-plaintext		draw the state pane's text without the glyph cache	|
+ |		-fps <n>		cap the front end's frame rate at n per second		|
+ |		-movement <m>	random, straight, seek (ink) or fill (space)		|
+ |		-policybench <n>	time n steps of each policy instantiation		|
+ |		-exclusive		at most one traveler per cell						|
+ |		-occupancybench <n>	blocked moves vs density, on n threads			|
+ |		-inksample <ms>	sample the ink tanks every ms, summarize on exit	|
+ |		-scenario <file>	run the timed actions of a scenario file		|
+ |		-phasecounters	count cycles, misses... per phase, report on exit	|
+ |		-trajectory <file>	export every move, columnar (see trajstat)		|
+ |		-sweep <spec>	run a parameter sweep of the simulation (sweep.h)	|
+ |		-sweepjobs <n>	simulations of the sweep run at once				|
+ |		-mix <r,g,b>	spawn mixed travelers painting this recipe of inks	|
+ |		-mixshare <p>	percentage of the travelers spawned mixed (50)		|
+ |		-inkmixbench <n>	mixed vs single-color ink takes on n threads	|
+ |		-cellformat <f>	accumulate in rgba8, rgba16 or float cells			|
+ |		-cellformatbench <r> <c>	memory and speed of each cell format	|
+ |		-adaptivelock	spin, yield, then park on the ink and grid locks	|
+ |		-lockbench <n>	adaptive vs current waits on n threads				|
  +-------------------------------------------------------------------------*/
 
 #include <iostream>
@@ -30,11 +71,35 @@
 #include <vector>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <time.h>
 #include <unistd.h>
+#include <atomic>
 
 //
 #include "gl_frontEnd.h"
+#include "numaPlacement.h"
+#include "shardSim.h"
+#include "gridPublish.h"
+#include "travelerPool.h"
+#include "coroTravelers.h"
+#include "timingWheel.h"
+#include "travelerLayout.h"
+#include "paintBuffer.h"
+#include "cellFormat.h"
+#include "adaptiveLock.h"
+#include "decayPass.h"
+#include "heatmap.h"
+#include "framePacer.h"
+#include "travelerPolicies.h"
+#include "cellOccupancy.h"
+#include "inkHistory.h"
+#include "scenario.h"
+#include "phaseCounters.h"
+#include "trajectory.h"
+#include "sweep.h"
+#include "startup.h"
+#include "inkMix.h"
 
 using namespace std;
 
@@ -43,21 +108,43 @@ using namespace std;
 //==================================================================================
 void displayGridPane(void);
 void displayStatePane(void);
+bool consumeFrame(void);
 void initializeApplication(void);
+void parseCommandLine(int* argc, char** argv);
+void printReports(void);
+void startSimulation(void);
+void runSweepCombination(const SweepConfig* config, double seconds, SweepResults* results);
 
 // TravelDirection newDirection(TravelerInfo* tt, int distance);
 void* runTravelerThread(void* data);
+void spawnTraveler(unsigned int slot);
+void spawnTravelerSeeded(unsigned int slot, unsigned int* seed);
+void fillGridRows(long first, long end, void* arg);
+void spawnTravelers(long first, long end, void* arg);
+void createTravelerThreads(long first, long end, void* arg);
 // int getAcceptableDirections(unsigned int x, unsigned int y, TravelDirection dirs[NUM_TRAVEL_DIRECTIONS]);
 // void moveTravelerToPosition(TravelDirection dir, unsigned int x, unsigned int y, TravelerInfo* tt);
 
 TravelDirection generateDirection(int col, int row, TravelDirection dir);
-bool checkDirection(unsigned int x, unsigned int y, unsigned int dir);
-void moveTraveler(TravelerInfo* tt);
-unsigned colorCell(TravelerInfo *tt);
+void advanceTraveler(TravelerInfo* tt, unsigned int index);
+void storeTraveler(unsigned int index, const TravelerInfo* tt);
+void loadTraveler(unsigned int index, TravelerInfo* tt);
+void paintCell(int row, int col, TravelerType type);
 unsigned newDistance(int col, int row, TravelDirection dir);
 bool getInk(TravelerType type);
+bool claimNextCell(TravelerInfo* tt, unsigned int index);
 
 void* produceInkThread(void* producer);
+void startProducerThreads(void);
+
+int scenarioInjectInk(int channel, int amount);
+int scenarioDrainInk(int channel, int amount);
+int scenarioSetProducerSleep(int sleepTime);
+int scenarioSpeedupProducers(void);
+int scenarioSlowdownProducers(void);
+int scenarioSpawnBurst(int count);
+int scenarioResetGrid(void);
+int scenarioEndRun(void);
 
 //==================================================================================
 //	Application-level global variables
@@ -66,37 +153,164 @@ void* produceInkThread(void* producer);
 //	Don't touch
 extern int	GRID_PANE, STATE_PANE;
 extern int	gMainWindow, gSubwindow[2];
+//	labels of the state pane compiled so far
+extern unsigned long gStateLabelsBuilt;
 
 //	The state grid and its dimensions
 int** grid;
-const int NUM_ROWS = 30, NUM_COLS = 20;
+int NUM_ROWS = 30, NUM_COLS = 20;
 
 //	the number of live threads (that haven't terminated yet)
 int MAX_NUM_TRAVELER_THREADS = 15;
 int numLiveThreads = 0;
 
 //	the ink levels
-const int NUM_PRODUCER_THREADS = 9;
+int NUM_PRODUCER_THREADS = 9;
 int MAX_LEVEL = 50;
 int MAX_ADD_INK = 10;
 int redLevel = 20, greenLevel = 10, blueLevel = 40;
-const int TRAV_INK_INCR = 16;
+int TRAV_INK_INCR = 16;
+//	ink taken from and added to each tank so far (see countInk)
+unsigned long inkConsumed[NUM_TRAV_TYPES] = {0, 0, 0};
+unsigned long inkRefilled[NUM_TRAV_TYPES] = {0, 0, 0};
 
 //	ink producer sleep time (in microseconds)
 const int MIN_SLEEP_TIME = 1000;
 int producerSleepTime = 100000;
 
+//	traveler sleep time after each step, or when out of ink (in microseconds)
+int travelerSleepTime = 100000;
+
+//	number of cells moved by all travelers so far
+atomic<unsigned long> totalMoves(0);
+
 //	Enable this declaration if you want to do the traveler information
 //	maintaining extra credit section
 TravelerInfo *travelList = NULL;
+//	cold table: thread ids, NUMA nodes (same indices as travelList)
+TravelerDebugInfo *travelDebug = NULL;
+//	bumped by the publisher each time it reads travelList: a traveler
+//	thread writes its entry once per change of it, not once per step (see
+//	publishTraveler)
+alignas(64) unsigned int travelerReadEpoch = 0;
+
+//	startup (see startup.h): alignment of the blocks placed on NUMA nodes,
+//	the least work worth an initialization thread, and the stack of the
+//	traveler threads (which use little of it: 8 MiB each adds up)
+const size_t ARENA_PAGE_SIZE = 4096;
+const int MIN_INIT_CELLS = 1 << 18;
+const int MIN_INIT_TRAVELERS = 1024;
+const size_t TRAVELER_STACK_SIZE = 256 * 1024;
+
+/** A traveler thread's working state, alone on its cache line
+ *  @var info           working copy of the traveler
+ *  @var index          index of the traveler in travelList
+ *  @var publishedEpoch travelerReadEpoch when the entry was last written
+ */
+typedef struct alignas(64) TravelerHotState {
+	TravelerInfo info;
+	unsigned int index;
+	unsigned int publishedEpoch;
+} TravelerHotState;
+
+//	one life of a traveler, specialized for its policies (runTravelerLife)
+typedef void (*TravelerLifeFunc)(TravelerHotState* hot);
+extern const TravelerLifeFunc TRAVELER_LIVES[NUM_MOVEMENT_POLICIES][NUM_TRAV_TYPES];
+extern const TravelerLifeFunc TRAVELER_MIXED_LIVES[NUM_MOVEMENT_POLICIES];
 Producer *producerList = NULL;
 
 pthread_mutex_t p_mutex;
 pthread_mutex_t grid_lock;
 pthread_mutex_t ink_lock;
+//	the same locks, adaptive (see adaptiveLock.h), and the refills that
+//	wake the travelers waiting for ink of each color
+AdaptiveLock adaptive_grid_lock;
+AdaptiveLock adaptive_ink_lock;
+AdaptiveEvent inkPoured[NUM_TRAV_TYPES];
 
 const unsigned int TRAV_COLOR[NUM_TRAV_TYPES] = {0xFF0000FF, 0xFF00FF00, 0xFFFF0000};
 
+//	command line settings
+bool numaPlacementOn = false;
+bool numaReportOn = false;
+int headlessSeconds = 0;
+int numShards = 0;
+const char* publishName = NULL;
+//	travelers respawned per second in sustained-load mode (0: no respawn)
+double spawnRate = 0.;
+//	dead travelers' slots are recycled (respawn rate, or scenario bursts)
+bool recycleSlotsOn = false;
+//	executor threads in coroutine mode (0: one thread per traveler)
+int coroWorkers = 0;
+//	tick of the shared timing wheel in microseconds (0: sleep with usleep)
+int wheelTickTime = 0;
+bool timerReportOn = false;
+//	threads of the traveler layout benchmark (0: run the simulation)
+int layoutBenchThreads = 0;
+//	deposits go through the per-thread paint buffers instead of grid_lock
+bool paintBufferOn = false;
+int paintBenchThreads = 0;
+//	trail fade factor per decay period (0: no decay)
+double decayFactor = 0.;
+bool decayBlurOn = false;
+int decayBenchRows = 0, decayBenchCols = 0;
+bool heatmapOn = false;
+//	state pane text drawn from display lists (see gl_frontEnd.cpp)
+bool textCacheOn = true;
+struct timespec runStartTime;
+//	time spent drawing the state pane
+unsigned long statePaneFrames = 0;
+double statePaneSeconds = 0.;
+//	frame rate cap of the render loop
+int maxFrameRate = 50;
+//	how the traveler threads move (coroutine travelers always turn at random)
+MovementPolicyID movementPolicy = RANDOM_TURN_MOVEMENT;
+//	steps per instantiation of the policy benchmark (0: run the simulation)
+long policyBenchSteps = 0;
+//	travelers claim the cell ahead before they step in (see cellOccupancy.h)
+bool exclusiveCellsOn = false;
+int occupancyBenchThreads = 0;
+//	time between two samples of the ink tanks; the sampler runs with the
+//	front end (sparklines), and in headless runs when asked for
+int inkSampleMs = 100;
+bool inkSummaryOn = false;
+//	scenario file run alongside the simulation
+const char* scenarioFile = NULL;
+//	per-phase performance counters (see phaseCounters.h)
+bool phaseCountersOn = false;
+//	file the moves are exported to (see trajectory.h)
+const char* trajectoryPath = NULL;
+//	parameter sweep, run instead of the simulation (its runs last
+//	-headless seconds, 2 by default)
+const char* sweepSpec = NULL;
+int sweepJobs = (int) max(1U, thread::hardware_concurrency());
+int inkMixBenchThreads = 0;
+//	ink and grid locks spin, yield, then park; travelers out of ink wait
+//	for a refill instead of sleeping a step
+bool adaptiveLocksOn = false;
+int lockBenchThreads = 0;
+//	grid of the cell format benchmark (0: run the simulation)
+int cellBenchRows = 0, cellBenchCols = 0;
+
+//	frame drawn by the front end, the previous one, and its pyramid
+GridFrame renderFrame, renderScratch;
+GridPyramid renderPyramid;
+
+//	time between two merges of the paint buffers (in microseconds)
+const int PAINT_MERGE_INTERVAL_US = 2000;
+
+//	time between two decay passes (in milliseconds)
+const int DECAY_INTERVAL_MS = 50;
+
+//	time between two heatmap snapshots (in milliseconds)
+const int HEATMAP_INTERVAL_MS = 100;
+
+//	deposits that a wide cell format shows at mid-level (tone mapping key)
+const int CELL_TONE_KEY_DEPOSITS = 8;
+
+//	time between two frames published for the viewers (in milliseconds)
+const int PUBLISH_INTERVAL_MS = 20;
+
 
 //==================================================================================
 //	These are the functions that tie the simulation with the rendering.
@@ -116,17 +330,17 @@ void displayGridPane(void)
 	//---------------------------------------------------------
 	//	This is the call that makes OpenGL render the grid.
 	//
-	//	You *must* synchronize this call.
-	//
+	//	The grid and travelers are not read from the simulation
+	//	directly, but from the last frame published for the viewers.
+	//	The render loop consumes them (see consumeFrame).
 	//---------------------------------------------------------
-	// drawGrid(grid, NUM_ROWS, NUM_COLS);
-	//
-	//	Use this drawing call instead if you do the extra credits for
-	//	maintaining traveler information
-	drawGridAndTravelers(grid, NUM_ROWS, NUM_COLS, travelList);
+	phaseEnter(RENDER_PHASE);
+	if (renderFrame.cells != NULL)
+		drawGridAndTravelers(&renderFrame, &renderPyramid);
 	
 	//	This is OpenGL/glut magic.  Don't touch
 	glutSwapBuffers();
+	phaseLeave();
 	
 	glutSetWindow(gMainWindow);
 }
@@ -143,18 +357,101 @@ void displayStatePane(void)
 	//	This is the call that makes OpenGL render information
 	//	about the state of the simulation.
 	//
-	//	You *must* synchronize this call.
-	//
+	//	The state comes from the frame the render loop consumed,
+	//	which is consistent without taking ink_lock.
 	//---------------------------------------------------------
-	drawState(numLiveThreads, redLevel, greenLevel, blueLevel);
+	phaseEnter(RENDER_PHASE);
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (renderFrame.cells != NULL)
+		drawState(renderFrame.numLiveThreads, renderFrame.redLevel, renderFrame.greenLevel, renderFrame.blueLevel);
+	else
+		drawState(numLiveThreads, redLevel, greenLevel, blueLevel);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	statePaneSeconds += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+	statePaneFrames++;
 	
 	
 	//	This is OpenGL/glut magic.  Don't touch
 	glutSwapBuffers();
+	phaseLeave();
 	
 	glutSetWindow(gMainWindow);
 }
 
+/** Takes the last frame published for the viewers, for both panes to draw.
+ *	A copy that collides with the publisher is simply dropped and the
+ *	previous frame is kept.  The pyramid follows the cells that changed
+ *	from one frame to the next.
+ *	@return true if the frame differs from the previous one
+ */
+bool consumeFrame(void)
+{
+	phaseEnter(RENDER_PHASE);
+	bool copied = gridReaderCopyFrame(gridPublishLocalReader(), &renderScratch, 4);
+	phaseLeave();
+	if (!copied)
+		return false;
+	if (renderFrame.cells != NULL && renderScratch.generation == renderFrame.generation)
+		return false;
+
+	swap(renderFrame, renderScratch);
+	phaseEnter(RENDER_PHASE);
+	gridPyramidUpdate(&renderPyramid, &renderFrame, &renderScratch);
+	phaseLeave();
+	const GridFrame* now = &renderFrame;
+	const GridFrame* before = &renderScratch;
+	return renderPyramid.cellsChanged > 0 || before->cells == NULL ||
+			now->numLiveThreads != before->numLiveThreads || now->redLevel != before->redLevel ||
+			now->greenLevel != before->greenLevel || now->blueLevel != before->blueLevel ||
+			now->numTravelers != before->numTravelers ||
+			memcmp(now->travelers, before->travelers, now->numTravelers * sizeof(PublishedTraveler)) != 0;
+}
+
+/** adds ink to a running total of the ink functions.  Callers hold
+ *	ink_lock, so a relaxed store of the new total is enough (no locked add):
+ *	the ink sampler reads the totals with relaxed loads, without the lock.
+ * @param total         running total
+ * @param amount        ink taken or added
+ */
+inline void countInk(unsigned long* total, int amount)
+{
+	__atomic_store_n(total, *total + amount, __ATOMIC_RELAXED);
+}
+
+//	The ink and grid locks, as pthread mutexes or adaptive locks
+inline void lockInk(void)
+{
+	if (adaptiveLocksOn)
+		adaptiveLock(&adaptive_ink_lock);
+	else
+		pthread_mutex_lock(&ink_lock);
+}
+
+inline void unlockInk(void)
+{
+	if (adaptiveLocksOn)
+		adaptiveUnlock(&adaptive_ink_lock);
+	else
+		pthread_mutex_unlock(&ink_lock);
+}
+
+inline void lockGrid(void)
+{
+	if (adaptiveLocksOn)
+		adaptiveLock(&adaptive_grid_lock);
+	else
+		pthread_mutex_lock(&grid_lock);
+}
+
+inline void unlockGrid(void)
+{
+	if (adaptiveLocksOn)
+		adaptiveUnlock(&adaptive_grid_lock);
+	else
+		pthread_mutex_unlock(&grid_lock);
+}
+
 //------------------------------------------------------------------------
 //	These are the functions that would be called by a traveler thread in
 //	order to acquire red/green/blue ink to trace its trail.
@@ -164,39 +461,63 @@ void displayStatePane(void)
 bool acquireRedInk(int theRed)
 {
 	int ok = false;
-	pthread_mutex_lock(&ink_lock);
+	lockInk();
 	if (redLevel >= theRed)
 	{
 		redLevel -= theRed;
+		countInk(inkConsumed + RED_TRAV, theRed);
 		ok = true;
 	}
-	pthread_mutex_unlock(&ink_lock);
+	unlockInk();
 	return ok;
 }
 
 bool acquireGreenInk(int theGreen)
 {
 	bool ok = false;
-	pthread_mutex_lock(&ink_lock);
+	lockInk();
 	if (greenLevel >= theGreen)
 	{
 		greenLevel -= theGreen;
+		countInk(inkConsumed + GREEN_TRAV, theGreen);
 		ok = true;
 	}
-	pthread_mutex_unlock(&ink_lock);
+	unlockInk();
 	return ok;
 }
 
 bool acquireBlueInk(int theBlue)
 {
 	bool ok = false;
-	pthread_mutex_lock(&ink_lock);
+	lockInk();
 	if (blueLevel >= theBlue)
 	{
 		blueLevel -= theBlue;
+		countInk(inkConsumed + BLUE_TRAV, theBlue);
 		ok = true;
 	}
-	pthread_mutex_unlock(&ink_lock);
+	unlockInk();
+	return ok;
+}
+
+//	Ink from several tanks at once (mixed travelers, see inkMix.h): all of
+//	it or none, in one critical section, so that no ink is ever held for a
+//	cell that cannot be painted
+bool acquireInkMix(int theRed, int theGreen, int theBlue)
+{
+	bool ok = false;
+	lockInk();
+	if (redLevel >= theRed && greenLevel >= theGreen && blueLevel >= theBlue)
+	{
+		redLevel -= theRed;
+		greenLevel -= theGreen;
+		blueLevel -= theBlue;
+		countInk(inkConsumed + RED_TRAV, theRed);
+		countInk(inkConsumed + GREEN_TRAV, theGreen);
+		countInk(inkConsumed + BLUE_TRAV, theBlue);
+		ok = true;
+	}
+	unlockInk();
 	return ok;
 }
 
@@ -209,39 +530,54 @@ bool acquireBlueInk(int theBlue)
 bool refillRedInk(int theRed)
 {
 	bool ok = false;
-	pthread_mutex_lock(&ink_lock);
+	lockInk();
 	if (redLevel + theRed <= MAX_LEVEL)
 	{
 		redLevel += theRed;
+		countInk(inkRefilled + RED_TRAV, theRed);
 		ok = true;
 	}
-	pthread_mutex_unlock(&ink_lock);
+	unlockInk();
+	if (ok && coroWorkers > 0)
+		coroNotifyInk(RED_TRAV, theRed);
+	if (ok && adaptiveLocksOn)
+		adaptiveEventNotify(inkPoured + RED_TRAV, theRed);
 	return ok;
 }
 
 bool refillGreenInk(int theGreen)
 {
 	bool ok = false;
-	pthread_mutex_lock(&ink_lock);
+	lockInk();
 	if (greenLevel + theGreen <= MAX_LEVEL)
 	{
 		greenLevel += theGreen;
+		countInk(inkRefilled + GREEN_TRAV, theGreen);
 		ok = true;
 	}
-	pthread_mutex_unlock(&ink_lock);
+	unlockInk();
+	if (ok && coroWorkers > 0)
+		coroNotifyInk(GREEN_TRAV, theGreen);
+	if (ok && adaptiveLocksOn)
+		adaptiveEventNotify(inkPoured + GREEN_TRAV, theGreen);
 	return ok;
 }
 
 bool refillBlueInk(int theBlue)
 {
 	bool ok = false;
-	pthread_mutex_lock(&ink_lock);
+	lockInk();
 	if (blueLevel + theBlue <= MAX_LEVEL)
 	{
 		blueLevel += theBlue;
+		countInk(inkRefilled + BLUE_TRAV, theBlue);
 		ok = true;
 	}
-	pthread_mutex_unlock(&ink_lock);
+	unlockInk();
+	if (ok && coroWorkers > 0)
+		coroNotifyInk(BLUE_TRAV, theBlue);
+	if (ok && adaptiveLocksOn)
+		adaptiveEventNotify(inkPoured + BLUE_TRAV, theBlue);
 	return ok;
 }
 
@@ -267,17 +603,249 @@ void slowdownProducers(void)
 }
 
 //------------------------------------------------------------------------
-//	You shouldn't have to change anything in the main function
+//	The actions of scenario files (see scenario.h).  Each returns what the
+//	action actually did.
 //------------------------------------------------------------------------
-int main(int argc, char** argv)
+
+int scenarioInjectInk(int channel, int amount)
+{
+	bool (*const REFILL[NUM_TRAV_TYPES])(int) = {refillRedInk, refillGreenInk, refillBlueInk};
+	//	one unit at a time: the tank fills up to its capacity
+	int added = 0;
+	while (added < amount && REFILL[channel](1))
+		added++;
+	return added;
+}
+
+int scenarioDrainInk(int channel, int amount)
+{
+	bool (*const ACQUIRE[NUM_TRAV_TYPES])(int) = {acquireRedInk, acquireGreenInk, acquireBlueInk};
+	int taken = 0;
+	while (taken < amount && ACQUIRE[channel](1))
+		taken++;
+	return taken;
+}
+
+int scenarioSetProducerSleep(int sleepTime)
+{
+	producerSleepTime = max(MIN_SLEEP_TIME, sleepTime);
+	return producerSleepTime;
+}
+
+int scenarioSpeedupProducers(void)
 {
-	initializeFrontEnd(argc, argv, displayGridPane, displayStatePane);
+	speedupProducers();
+	return producerSleepTime;
+}
 
+int scenarioSlowdownProducers(void)
+{
+	slowdownProducers();
+	return producerSleepTime;
+}
+
+int scenarioSpawnBurst(int count)
+{
+	return recycleSlotsOn ? travelerPoolSpawnNow(count, spawnTraveler) : 0;
+}
+
+//	clears the trails, under the lock of whoever writes the grid
+int scenarioResetGrid(void)
+{
+	if (paintBufferOn)
+		pthread_mutex_lock(paintBufferMergeLock());
+	else
+		lockGrid();
+	for (int i=0; i<NUM_ROWS; i++)
+		for (int j=0; j<NUM_COLS; j++)
+			grid[i][j] = 0xFF000000;
+	if (cellFormat != RGBA8_FORMAT)
+		cellGridClear();
+	if (paintBufferOn)
+		pthread_mutex_unlock(paintBufferMergeLock());
+	else
+		unlockGrid();
+	return NUM_ROWS * NUM_COLS;
+}
+
+int scenarioEndRun(void)
+{
+	exit(0);
+}
+
+/** sets up the locks and the timing wheel, then the grid, the travelers
+ *  and the producers: the simulation runs from here on
+ */
+void startSimulation(void)
+{
 	pthread_mutex_init(&grid_lock, NULL);
 	pthread_mutex_init(&ink_lock, NULL);
+	if (adaptiveLocksOn)
+	{
+		adaptiveLockCalibrate();
+		adaptiveLockInit(&adaptive_grid_lock, "grid");
+		adaptiveLockInit(&adaptive_ink_lock, "ink");
+		adaptiveEventInit(inkPoured + RED_TRAV, "red ink");
+		adaptiveEventInit(inkPoured + GREEN_TRAV, "green ink");
+		adaptiveEventInit(inkPoured + BLUE_TRAV, "blue ink");
+	}
 	
+	//	The wheel must run before the first traveler goes to sleep
+	if (wheelTickTime > 0 && !timingWheelStart(wheelTickTime))
+		fprintf(stderr, "timing wheel not available: sleeping with usleep\n");
+	clock_gettime(CLOCK_MONOTONIC, &runStartTime);
+
 	//	Now we can do application-level
 	initializeApplication();
+}
+
+/** runs one combination of a sweep (see sweep.h), in its own process: the
+ *  simulation itself, headless, with the other options of the command line
+ * @param config        the combination
+ * @param seconds       time the simulation runs
+ * @param results       receives its totals
+ */
+void runSweepCombination(const SweepConfig* config, double seconds, SweepResults* results)
+{
+	NUM_ROWS = config->numRows;
+	NUM_COLS = config->numCols;
+	MAX_NUM_TRAVELER_THREADS = config->numTravelers;
+	NUM_PRODUCER_THREADS = config->numProducers;
+	MAX_LEVEL = config->maxLevel;
+	TRAV_INK_INCR = config->depositPerMove;
+	redLevel = min(redLevel, MAX_LEVEL);
+	greenLevel = min(greenLevel, MAX_LEVEL);
+	blueLevel = min(blueLevel, MAX_LEVEL);
+	startSimulation();
+
+	struct timespec duration = {(time_t) seconds, (long) ((seconds - (time_t) seconds) * 1e9)};
+	while (clock_nanosleep(CLOCK_MONOTONIC, 0, &duration, &duration) != 0)
+		;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	results->seconds = (now.tv_sec - runStartTime.tv_sec) + (now.tv_nsec - runStartTime.tv_nsec) * 1e-9;
+	results->moves = totalMoves.load();
+	results->liveTravelers = numLiveThreads;
+	lockInk();
+	for (int c=0; c<NUM_TRAV_TYPES; c++)
+	{
+		results->inkConsumed += inkConsumed[c];
+		results->inkRefilled += inkRefilled[c];
+	}
+	results->finalLevel[RED_TRAV] = redLevel;
+	results->finalLevel[GREEN_TRAV] = greenLevel;
+	results->finalLevel[BLUE_TRAV] = blueLevel;
+	unlockInk();
+	//	cells are single words: read as the publisher reads them
+	long painted = 0;
+	for (int i=0; i<NUM_ROWS; i++)
+		for (int j=0; j<NUM_COLS; j++)
+			painted += (grid[i][j] & 0x00FFFFFF) != 0;
+	results->paintedCells = (double) painted / ((long) NUM_ROWS * NUM_COLS);
+}
+
+//------------------------------------------------------------------------
+//	You shouldn't have to change anything in the main function
+//------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	startupBegin();
+	parseCommandLine(&argc, argv);
+
+	if (layoutBenchThreads > 0)
+	{
+		travelerLayoutBenchmark(layoutBenchThreads, 2., stdout);
+		exit(0);
+	}
+	if (paintBenchThreads > 0)
+	{
+		paintBenchmark(paintBenchThreads, stdout);
+		exit(0);
+	}
+	if (policyBenchSteps > 0)
+	{
+		travelerPolicyBenchmark(NUM_ROWS, NUM_COLS, policyBenchSteps, stdout);
+		exit(0);
+	}
+	if (inkMixBenchThreads > 0)
+	{
+		inkMixBenchmark(inkMixBenchThreads, stdout);
+		exit(0);
+	}
+	if (occupancyBenchThreads > 0)
+	{
+		occupancyBenchmark(NUM_ROWS, NUM_COLS, occupancyBenchThreads, stdout);
+		exit(0);
+	}
+	if (decayBenchRows > 0)
+	{
+		decayBenchmark(decayBenchRows, decayBenchCols, thread::hardware_concurrency(), stdout);
+		exit(0);
+	}
+	if (lockBenchThreads > 0)
+	{
+		adaptiveLockBenchmark(lockBenchThreads, stdout);
+		exit(0);
+	}
+	if (cellBenchRows > 0)
+	{
+		cellFormatBenchmark(cellBenchRows, cellBenchCols, stdout);
+		exit(0);
+	}
+
+	if (sweepSpec != NULL)
+	{
+		SweepConfig base = {NUM_ROWS, NUM_COLS, MAX_NUM_TRAVELER_THREADS, NUM_PRODUCER_THREADS, MAX_LEVEL,
+							TRAV_INK_INCR};
+		if (!sweepLoad(sweepSpec, &base))
+			exit(EXIT_FAILURE);
+		sweepRun(headlessSeconds > 0 ? headlessSeconds : 2, sweepJobs, runSweepCombination, stdout);
+		exit(0);
+	}
+
+	//	Sharded runs are headless: this process only coordinates
+	if (numShards > 0)
+	{
+		runShardedSimulation(numShards, headlessSeconds > 0 ? headlessSeconds : 10);
+		exit(0);
+	}
+
+	if (headlessSeconds == 0)
+	{
+		framePacerInitialize(maxFrameRate);
+		initializeFrontEnd(argc, argv, displayGridPane, displayStatePane, consumeFrame);
+	}
+
+	startSimulation();
+	atexit(printReports);
+
+	//	The front end draws from the published grid, so publication is on
+	//	whenever there is a front end, under a private name if none is given
+	if (publishName != NULL || headlessSeconds == 0)
+	{
+		char defaultName[64];
+		sprintf(defaultName, "/travel_grid_%d", (int) getpid());
+		if (!gridPublishStart(publishName != NULL ? publishName : defaultName, PUBLISH_INTERVAL_MS))
+			exit(EXIT_FAILURE);
+		atexit(gridPublishStop);
+	}
+
+	//	Scenario times count from here, once everything runs
+	if (scenarioFile != NULL)
+	{
+		ScenarioHandlers handlers = {scenarioInjectInk, scenarioDrainInk, scenarioSetProducerSleep,
+									 scenarioSpeedupProducers, scenarioSlowdownProducers, scenarioSpawnBurst,
+									 scenarioResetGrid, scenarioEndRun};
+		scenarioStart(&handlers);
+	}
+
+	//	Without a front end, there is no event loop to hand control to:
+	//	just let the simulation run for the requested time.
+	if (headlessSeconds > 0)
+	{
+		sleep(headlessSeconds);
+		exit(0);
+	}
 
 	//	Now we enter the main loop of the program and to a large extend
 	//	"lose control" over its execution.  The callback functions that 
@@ -288,17 +856,289 @@ int main(int argc, char** argv)
 	//	Free allocated resource before leaving (not absolutely needed, but
 	//	just nicer.  Also, if you crash there, you know something is wrong
 	//	in your code.
-	for (int i=0; i< NUM_ROWS; i++)
-		free(grid[i]);
-	free(grid);
-	//
-	free(travelList);
+	startupArenaRelease();
 	
 	//	This will never be executed (the exit point will be in one of the
 	//	call back functions).
 	return 0;
 }
 
+/** Strips the application's own options from the command line, leaving
+ *	the rest for glut
+ * @param argc      pointer to the argument count (updated)
+ * @param argv      argument list (compacted in place)
+ */
+void parseCommandLine(int* argc, char** argv)
+{
+	int kept = 1;
+	for (int k=1; k<*argc; k++)
+	{
+		if (strcmp(argv[k], "-numa") == 0)
+			numaPlacementOn = true;
+		else if (strcmp(argv[k], "-numareport") == 0)
+			numaReportOn = true;
+		else if (strcmp(argv[k], "-headless") == 0 && k+1 < *argc)
+			headlessSeconds = max(1, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-grid") == 0 && k+2 < *argc)
+		{
+			//	published travelers store their position on 16 bits
+			NUM_ROWS = min(max(4, atoi(argv[++k])), 65535);
+			NUM_COLS = min(max(4, atoi(argv[++k])), 65535);
+		}
+		else if (strcmp(argv[k], "-travelers") == 0 && k+1 < *argc)
+			MAX_NUM_TRAVELER_THREADS = max(1, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-stepdelay") == 0 && k+1 < *argc)
+			travelerSleepTime = max(0, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-producersleep") == 0 && k+1 < *argc)
+			producerSleepTime = max(0, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-publish") == 0 && k+1 < *argc)
+			publishName = argv[++k];
+		else if (strcmp(argv[k], "-spawnrate") == 0 && k+1 < *argc)
+			spawnRate = max(0., atof(argv[++k]));
+		else if (strcmp(argv[k], "-coro") == 0 && k+1 < *argc)
+			coroWorkers = max(1, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-wheel") == 0 && k+1 < *argc)
+			wheelTickTime = max(1, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-timerreport") == 0)
+			timerReportOn = true;
+		else if (strcmp(argv[k], "-layoutbench") == 0 && k+1 < *argc)
+			layoutBenchThreads = max(1, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-paintbuffer") == 0)
+			paintBufferOn = true;
+		else if (strcmp(argv[k], "-paintbench") == 0 && k+1 < *argc)
+			paintBenchThreads = max(1, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-decay") == 0 && k+1 < *argc)
+			decayFactor = min(1., max(0., atof(argv[++k])));
+		else if (strcmp(argv[k], "-blur") == 0)
+			decayBlurOn = true;
+		else if (strcmp(argv[k], "-heatmap") == 0)
+			heatmapOn = true;
+		else if (strcmp(argv[k], "-plaintext") == 0)
+			textCacheOn = false;
+		else if (strcmp(argv[k], "-fps") == 0 && k+1 < *argc)
+			maxFrameRate = max(1, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-movement") == 0 && k+1 < *argc)
+		{
+			movementPolicy = movementPolicyFromName(argv[++k]);
+			if (movementPolicy == NUM_MOVEMENT_POLICIES)
+			{
+				fprintf(stderr, "unknown movement %s (random, straight, seek, fill)\n", argv[k]);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (strcmp(argv[k], "-policybench") == 0 && k+1 < *argc)
+			policyBenchSteps = max(1L, atol(argv[++k]));
+		else if (strcmp(argv[k], "-exclusive") == 0)
+			exclusiveCellsOn = true;
+		else if (strcmp(argv[k], "-occupancybench") == 0 && k+1 < *argc)
+			occupancyBenchThreads = max(1, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-inksample") == 0 && k+1 < *argc)
+		{
+			inkSampleMs = max(1, atoi(argv[++k]));
+			inkSummaryOn = true;
+		}
+		else if (strcmp(argv[k], "-scenario") == 0 && k+1 < *argc)
+			scenarioFile = argv[++k];
+		else if (strcmp(argv[k], "-phasecounters") == 0)
+			phaseCountersOn = true;
+		else if (strcmp(argv[k], "-trajectory") == 0 && k+1 < *argc)
+			trajectoryPath = argv[++k];
+		else if (strcmp(argv[k], "-sweep") == 0 && k+1 < *argc)
+			sweepSpec = argv[++k];
+		else if (strcmp(argv[k], "-sweepjobs") == 0 && k+1 < *argc)
+			sweepJobs = max(1, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-mix") == 0 && k+1 < *argc)
+		{
+			if (!inkMixParse(argv[++k]))
+			{
+				fprintf(stderr, "bad ink mix %s (red,green,blue amounts up to %d, e.g. 1,0,2)\n", argv[k],
+						MAX_LEVEL);
+				exit(EXIT_FAILURE);
+			}
+			if (inkMixShare == 0)
+				inkMixShare = 50;
+		}
+		else if (strcmp(argv[k], "-mixshare") == 0 && k+1 < *argc)
+			inkMixShare = min(100, max(0, atoi(argv[++k])));
+		else if (strcmp(argv[k], "-inkmixbench") == 0 && k+1 < *argc)
+			inkMixBenchThreads = max(1, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-cellformat") == 0 && k+1 < *argc)
+		{
+			cellFormat = cellFormatFromName(argv[++k]);
+			if (cellFormat == NUM_CELL_FORMATS)
+			{
+				fprintf(stderr, "unknown cell format %s (rgba8, rgba16, float)\n", argv[k]);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (strcmp(argv[k], "-adaptivelock") == 0)
+			adaptiveLocksOn = true;
+		else if (strcmp(argv[k], "-lockbench") == 0 && k+1 < *argc)
+			lockBenchThreads = max(1, atoi(argv[++k]));
+		else if (strcmp(argv[k], "-cellformatbench") == 0 && k+2 < *argc)
+		{
+			cellBenchRows = max(4, atoi(argv[++k]));
+			cellBenchCols = max(4, atoi(argv[++k]));
+		}
+		else if (strcmp(argv[k], "-decaybench") == 0 && k+2 < *argc)
+		{
+			decayBenchRows = max(4, atoi(argv[++k]));
+			decayBenchCols = max(4, atoi(argv[++k]));
+		}
+		else if (strcmp(argv[k], "-shards") == 0 && k+1 < *argc)
+			numShards = max(1, atoi(argv[++k]));
+		else
+			argv[kept++] = argv[k];
+	}
+	*argc = kept;
+	argv[kept] = NULL;
+
+	//	each shard owns at least one row
+	numShards = min(numShards, min(NUM_ROWS, MAX_SHARDS));
+	//	the runs of a sweep are processes of their own, headless
+	if (sweepSpec != NULL && (trajectoryPath != NULL || scenarioFile != NULL || publishName != NULL))
+	{
+		fprintf(stderr, "-trajectory, -scenario and -publish are not supported with -sweep: ignored\n");
+		trajectoryPath = NULL;
+		scenarioFile = NULL;
+		publishName = NULL;
+	}
+
+	//	coroutine travelers have no thread to park between two lives
+	if (coroWorkers > 0 && spawnRate > 0)
+	{
+		fprintf(stderr, "-spawnrate is not supported with -coro: ignored\n");
+		spawnRate = 0.;
+	}
+	if (scenarioFile != NULL && !scenarioLoad(scenarioFile))
+		exit(EXIT_FAILURE);
+	recycleSlotsOn = spawnRate > 0 || (scenarioFile != NULL && scenarioHasAction(SPAWN_ACTION));
+	if (coroWorkers > 0 && recycleSlotsOn)
+	{
+		fprintf(stderr, "scenario spawns are not supported with -coro: ignored\n");
+		recycleSlotsOn = false;
+	}
+	if (coroWorkers > 0 && movementPolicy != RANDOM_TURN_MOVEMENT)
+	{
+		fprintf(stderr, "-movement is not supported with -coro: ignored\n");
+		movementPolicy = RANDOM_TURN_MOVEMENT;
+	}
+	//	a recipe a full tank cannot hold would never be taken
+	if (inkMixShare > 0 &&
+		max(inkMixRecipe[0], max(inkMixRecipe[1], inkMixRecipe[2])) > MAX_LEVEL)
+	{
+		fprintf(stderr, "-mix: amounts above the tank capacity (%d)\n", MAX_LEVEL);
+		exit(EXIT_FAILURE);
+	}
+	if (coroWorkers > 0 && inkMixShare > 0)
+	{
+		fprintf(stderr, "-mix is not supported with -coro: ignored\n");
+		inkMixShare = 0;
+	}
+	//	the decay pass fades the RGBA8 grid, which a wide format does not show
+	if (cellFormat != RGBA8_FORMAT && decayFactor > 0)
+	{
+		fprintf(stderr, "-decay is not supported with a wide -cellformat: ignored\n");
+		decayFactor = 0.;
+	}
+	//	shards paint private RGBA8 grids, with no accumulation grid
+	if (cellFormat != RGBA8_FORMAT && numShards > 0)
+	{
+		fprintf(stderr, "-cellformat is not supported with -shards: ignored\n");
+		cellFormat = RGBA8_FORMAT;
+	}
+	if (coroWorkers > 0 && phaseCountersOn)
+		fprintf(stderr, "-phasecounters: coroutine travelers are not counted\n");
+	if (phaseCountersOn)
+		phaseCountersInitialize();
+	if (coroWorkers > 0 && exclusiveCellsOn)
+	{
+		fprintf(stderr, "-exclusive is not supported with -coro: ignored\n");
+		exclusiveCellsOn = false;
+	}
+	//	leave travelers room to move around each other
+	int spawnCells = (NUM_ROWS-1) * (NUM_COLS-1);
+	if (exclusiveCellsOn && MAX_NUM_TRAVELER_THREADS > spawnCells / 2)
+	{
+		MAX_NUM_TRAVELER_THREADS = max(1, spawnCells / 2);
+		fprintf(stderr, "-exclusive: at most %d travelers on this grid\n", MAX_NUM_TRAVELER_THREADS);
+	}
+
+	if (coroWorkers > 0 && trajectoryPath != NULL)
+	{
+		fprintf(stderr, "-trajectory is not supported with -coro: ignored\n");
+		trajectoryPath = NULL;
+	}
+	if (trajectoryPath != NULL &&
+		!trajectoryOpen(trajectoryPath, NUM_ROWS, NUM_COLS, MAX_NUM_TRAVELER_THREADS, 1, TRAV_INK_INCR))
+		exit(EXIT_FAILURE);
+
+	if (numaPlacementOn || numaReportOn)
+		numaInitialize();
+}
+
+/** Prints the reports requested on the command line.  Registered with
+ *	atexit, since the application leaves through exit() from the front end.
+ */
+void printReports(void)
+{
+	//	a scenario may end the run before its time
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double runSeconds = (now.tv_sec - runStartTime.tv_sec) + (now.tv_nsec - runStartTime.tv_nsec) * 1e-9;
+
+	if (headlessSeconds > 0 && numShards == 0)
+		printf("%s run: %lu cells moved in %.1f s (%.0f cells/s)\n", coroWorkers > 0 ? "Coroutine" : "Threaded",
+				totalMoves.load(), runSeconds, totalMoves.load() / runSeconds);
+	if (headlessSeconds > 0 && numShards == 0)
+		travelerLayoutPrintReport(stdout, MAX_NUM_TRAVELER_THREADS);
+	if (headlessSeconds > 0 && numShards == 0)
+		startupPrintReport(stdout);
+	if (recycleSlotsOn)
+		travelerPoolPrintReport(stdout);
+	if (coroWorkers > 0)
+		coroPrintReport(stdout);
+	if (numaReportOn)
+		numaPrintReport(stdout);
+	if (paintBufferOn)
+		paintBufferPrintReport(stdout);
+	if (decayFactor > 0)
+		decayPrintReport(stdout);
+	if (heatmapOn)
+		heatmapPrintReport(stdout);
+	if (cellFormat != RGBA8_FORMAT)
+		cellGridPrintReport(stdout);
+	if (adaptiveLocksOn && numShards == 0)
+	{
+		printf("Adaptive waits:\n");
+		adaptiveLockPrintReport(stdout, &adaptive_ink_lock);
+		if (!paintBufferOn)
+			adaptiveLockPrintReport(stdout, &adaptive_grid_lock);
+		for (int c=0; c<NUM_TRAV_TYPES; c++)
+			adaptiveEventPrintReport(stdout, inkPoured + c);
+	}
+	if (exclusiveCellsOn)
+		occupancyPrintReport(stdout, totalMoves.load(), numLiveThreads);
+	if (inkSummaryOn)
+		inkHistoryPrintSummary(stdout);
+	if (scenarioFile != NULL)
+		scenarioPrintReport(stdout);
+	if (phaseCountersOn)
+		phasePrintReport(stdout);
+	if (trajectoryOn)
+	{
+		trajectoryClose();
+		trajectoryPrintReport(stdout);
+	}
+	if (statePaneFrames > 0)
+		framePacerPrintReport(stdout);
+	if (statePaneFrames > 0)
+		printf("State pane: %lu frames, %.1f us per frame (text %s, %lu labels built)\n", statePaneFrames,
+				1e6 * statePaneSeconds / statePaneFrames, textCacheOn ? "cached" : "plain", gStateLabelsBuilt);
+	if (timerReportOn || wheelTickTime > 0)
+		timingWheelPrintReport(stdout, runSeconds);
+}
+
 
 //==================================================================================
 //
@@ -309,10 +1149,41 @@ int main(int argc, char** argv)
 
 void initializeApplication(void)
 {
-	//	Allocate the grid
-	grid = (int**) malloc(NUM_ROWS * sizeof(int*));
+	startupMark("setup");
+
+	//	All the state comes from one arena (see startup.h).  The cells are
+	//	one page-aligned block so that the band of rows owned by each NUMA
+	//	node is a single range of pages; so is the traveler table.
+	size_t cellBytes = (size_t) NUM_ROWS * NUM_COLS * sizeof(int);
+	size_t travelerBytes = MAX_NUM_TRAVELER_THREADS * sizeof(TravelerInfo);
+	//	the accumulators of a wide cell format (see cellFormat.h)
+	size_t wideCellBytes = cellFormat != RGBA8_FORMAT ?
+							(size_t) NUM_ROWS * NUM_COLS * cellFormatCellBytes(cellFormat) : 0;
+	startupArenaReserve(NUM_ROWS * sizeof(int*) + cellBytes + travelerBytes + wideCellBytes +
+						MAX_NUM_TRAVELER_THREADS * sizeof(TravelerDebugInfo) +
+						NUM_PRODUCER_THREADS * sizeof(Producer) + 6 * ARENA_PAGE_SIZE);
+	grid = (int**) startupArenaAlloc(NUM_ROWS * sizeof(int*), 64);
+	int* cells = (int*) startupArenaAlloc(cellBytes, ARENA_PAGE_SIZE);
 	for (int i=0; i<NUM_ROWS; i++)
-		grid[i] = (int*) malloc(NUM_COLS * sizeof(int));
+		grid[i] = cells + (size_t) i*NUM_COLS;
+	travelList = (TravelerInfo*) startupArenaAlloc(travelerBytes, ARENA_PAGE_SIZE);
+	travelDebug = (TravelerDebugInfo*) startupArenaAlloc(MAX_NUM_TRAVELER_THREADS * sizeof(TravelerDebugInfo), 64);
+	producerList = (Producer*) startupArenaAlloc(NUM_PRODUCER_THREADS * sizeof(Producer), 64);
+	if (cellFormat != RGBA8_FORMAT)
+		cellGridInitialize(cellFormat, startupArenaAlloc(wideCellBytes, ARENA_PAGE_SIZE), NUM_ROWS, NUM_COLS,
+						   CELL_TONE_KEY_DEPOSITS * TRAV_INK_INCR);
+	startupMark("arena");
+
+	//	Place each band on its node before anything else touches it
+	if (numaPlacementOn)
+	{
+		for (int node=0; node<numaNumNodes(); node++)
+		{
+			int firstRow = numaFirstRowOfNode(node, NUM_ROWS);
+			int endRow = numaFirstRowOfNode(node+1, NUM_ROWS);
+			numaPlaceRange(grid[firstRow], (endRow - firstRow) * NUM_COLS * sizeof(int), node);
+		}
+	}
 	
     
 	//---------------------------------------------------------------
@@ -326,56 +1197,227 @@ void initializeApplication(void)
 	//	seed the pseudo-random generator
 	srand((unsigned int) time(NULL));
 	
-	//	create RGB values (and alpha  = 255) for each pixel
-	for (int i=0; i<NUM_ROWS; i++)
+	//	create RGB values (and alpha  = 255) for each pixel, in bands of
+	//	rows on all the cores (the pages are first touched there)
+	startupParallelFor(NUM_ROWS, max(1, MIN_INIT_CELLS / NUM_COLS), fillGridRows, NULL);
+	startupMark("grid");
+	
+	//	With paint buffers, the merge thread is the only writer of the grid
+	if (paintBufferOn)
 	{
-		for (int j=0; j<NUM_COLS; j++)
+		if (cellFormat != RGBA8_FORMAT)
+			paintBufferSetMirror(cellGridBlend);
+		paintBufferStart(grid, NUM_ROWS, NUM_COLS, PAINT_MERGE_INTERVAL_US);
+	}
+
+	//	The decay pass commits its tiles under the lock of whoever writes
+	//	the grid: travelers never wait for more than one tile
+	if (decayFactor > 0)
+	{
+		decayInitialize(grid, NUM_ROWS, NUM_COLS, thread::hardware_concurrency(),
+						paintBufferOn ? paintBufferMergeLock() : &grid_lock);
+		if (adaptiveLocksOn && !paintBufferOn)
+			decayUseAdaptiveLock(&adaptive_grid_lock);
+		decaySetParameters(decayFactor, decayBlurOn);
+		decayStart(DECAY_INTERVAL_MS);
+	}
+
+	if (heatmapOn)
+	{
+		heatmapInitialize(NUM_ROWS, NUM_COLS);
+		heatmapStart(HEATMAP_INTERVAL_MS);
+	}
+
+	if (headlessSeconds == 0 || inkSummaryOn)
+		inkHistoryStart(inkSampleMs);
+
+	//	Travelers claim their first cell when they spawn
+	if (exclusiveCellsOn)
+		occupancyInitialize(NUM_ROWS, NUM_COLS);
+
+	//	With NUMA placement, travelers are split into one contiguous block per
+	//	node, each block placed on its node and starting in that node's band
+	if (numaPlacementOn)
+	{
+		for (int node=0; node<numaNumNodes(); node++)
 		{
-			//	temp code to get some color initially
-			// unsigned char red = (unsigned char) (rand() % range + minVal);
-			// unsigned char green = (unsigned char) (rand() % range + minVal);
-			// unsigned char blue = (unsigned char) (rand() % range + minVal);
-			// grid[i][j] = 0xFF000000 | (blue << 16) | (green << 8) | red;
-			
-			//	the intialization you should use
-			grid[i][j] = 0xFF000000;
+			int first = (node * MAX_NUM_TRAVELER_THREADS) / numaNumNodes();
+			int end = ((node+1) * MAX_NUM_TRAVELER_THREADS) / numaNumNodes();
+			numaPlaceRange(travelList + first, (end - first) * sizeof(TravelerInfo), node);
 		}
 	}
-	
-//	//	Enable this code if you want to do the traveler information
-//	//	maintaining extra credit section
-	travelList = (TravelerInfo*) malloc(MAX_NUM_TRAVELER_THREADS * sizeof(TravelerInfo));
-	for (int k=0; k< MAX_NUM_TRAVELER_THREADS; k++){
-		travelList[k].type = TravelerType(rand() % NUM_TRAV_TYPES);
-		travelList[k].row = 1 + rand() % (NUM_ROWS-1);
-		travelList[k].col = 1 + rand() % (NUM_COLS-1);
-		travelList[k].dir = TravelDirection(rand() % NUM_TRAVEL_DIRECTIONS);
-		travelList[k].isLive = 1;
-		travelList[k].index=k;
-        travelList[k].threadID=0;
-        travelList[k].distance = newDistance(travelList[k].col, travelList[k].row, travelList[k].dir);
-		numLiveThreads++;
-//        travelList[k].thread_lock=&p_mutex;
-	}
-
-	for (unsigned int k = 0; k<MAX_NUM_TRAVELER_THREADS; k++){
-		int errorCode = pthread_create(&travelList[k].threadID, nullptr, runTravelerThread, travelList+k);
-		if (errorCode != 0){
-            // cerr << "could not pthread_create thread " << k <<
-			// 		 ", Error code " << errorCode << ": " << strerror(errorCode) << endl;
-            exit (EXIT_FAILURE);
+
+	//	Travelers spawn in blocks, each drawing from its own generator
+	unsigned int spawnSeed = (unsigned int) rand();
+	startupParallelFor(MAX_NUM_TRAVELER_THREADS, MIN_INIT_TRAVELERS, spawnTravelers, &spawnSeed);
+	startupMark("travelers");
+
+	//	In sustained-load mode, the slots of dead travelers are recycled
+	if (recycleSlotsOn)
+		travelerPoolInitialize(MAX_NUM_TRAVELER_THREADS);
+
+	//	Threads are created in bulk, from all the cores, with small stacks
+	if (coroWorkers == 0){
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setstacksize(&attr, TRAVELER_STACK_SIZE);
+		startupParallelFor(MAX_NUM_TRAVELER_THREADS, MIN_INIT_TRAVELERS, createTravelerThreads, &attr);
+		pthread_attr_destroy(&attr);
+		startupMark("threads");
+	}
+
+    if (coroWorkers > 0)
+        coroStartTravelers(MAX_NUM_TRAVELER_THREADS, coroWorkers);
+
+    startProducerThreads();
+    if (spawnRate > 0)
+        travelerPoolStartSpawner(spawnRate, spawnTraveler);
+}
+
+/** fills rows of the grid with empty cells (startupParallelFor body)
+ * @param first     first row
+ * @param end       end of the rows
+ */
+void fillGridRows(long first, long end, void*){
+    for (long i = first; i < end; i++)
+        for (int j = 0; j < NUM_COLS; j++)
+            grid[i][j] = 0xFF000000;
+}
+
+/** spawns the first travelers of a block of slots (startupParallelFor body)
+ * @param first     first slot
+ * @param end       end of the slots
+ * @param arg       base seed of the blocks' generators
+ */
+void spawnTravelers(long first, long end, void* arg){
+    unsigned int seed = *(unsigned int*) arg ^ (unsigned int) (first * 2654435761u);
+    for (long k = first; k < end; k++){
+        if (numaPlacementOn)
+            travelDebug[k].node = (k * numaNumNodes()) / MAX_NUM_TRAVELER_THREADS;
+        else
+            travelDebug[k].node = -1;
+        travelDebug[k].index = k;
+        travelDebug[k].threadID = 0;
+        spawnTravelerSeeded(k, &seed);
+    }
+}
+
+/** creates the threads of a block of travelers (startupParallelFor body)
+ * @param first     first traveler
+ * @param end       end of the travelers
+ * @param arg       thread attributes
+ */
+void createTravelerThreads(long first, long end, void* arg){
+    const pthread_attr_t* attr = (const pthread_attr_t*) arg;
+    for (long k = first; k < end; k++){
+        int errorCode = pthread_create(&travelDebug[k].threadID, attr, runTravelerThread, travelList+k);
+        if (errorCode != 0){
+            fprintf(stderr, "could not create traveler thread %ld: %s\n", k, strerror(errorCode));
+            exit(EXIT_FAILURE);
         }
+    }
+}
 
-    
+/** gives a traveler slot a new random traveler
+ * @param slot      index of the slot in travelList
+ */
+void spawnTraveler(unsigned int slot){
+    unsigned int seed = (unsigned int) rand();
+    spawnTravelerSeeded(slot, &seed);
+}
+
+/** same, drawing from a generator of the caller's (safe to call from
+ *  several threads at once)
+ * @param slot      index of the slot in travelList
+ * @param seed      state of the generator
+ */
+void spawnTravelerSeeded(unsigned int slot, unsigned int* seed){
+    TravelerInfo traveler = {};
+    TravelerInfo* tt = &traveler;
+    int node = travelDebug[slot].node;
+    tt->type = TravelerType(rand_r(seed) % NUM_TRAV_TYPES);
+    //	travelers bound to a NUMA node start in that node's band
+    if (node >= 0){
+        int firstRow = max(1, numaFirstRowOfNode(node, NUM_ROWS));
+        int endRow = numaFirstRowOfNode(node+1, NUM_ROWS);
+        tt->row = firstRow + rand_r(seed) % max(1, endRow - firstRow);
     }
-    
-    producerList = (Producer*) malloc(NUM_PRODUCER_THREADS * sizeof(Producer));
-    for (unsigned int k=0; k<NUM_PRODUCER_THREADS; k++){
+    else
+        tt->row = 1 + rand_r(seed) % (NUM_ROWS-1);
+    tt->col = 1 + rand_r(seed) % (NUM_COLS-1);
+    //	with exclusive cells, the first free cell from there on, in the
+    //	traveler's band if it has one
+    if (exclusiveCellsOn){
+        int row = tt->row, col = tt->col;
+        int firstRow = node >= 0 ? max(1, numaFirstRowOfNode(node, NUM_ROWS)) : 1;
+        int endRow = node >= 0 ? numaFirstRowOfNode(node+1, NUM_ROWS) : NUM_ROWS;
+        if (!occupancyClaimFrom(&row, &col, firstRow, endRow, slot)){
+            row = 1 + rand_r(seed) % (NUM_ROWS-1);
+            if (!occupancyClaimFrom(&row, &col, 1, NUM_ROWS, slot)){
+                fprintf(stderr, "no free cell to spawn traveler %u\n", slot);
+                exit(EXIT_FAILURE);
+            }
+        }
+        tt->row = row;
+        tt->col = col;
+    }
+    //	a mixed traveler shows as its recipe's main color
+    if (inkMixShare > 0 && (int) (rand_r(seed) % 100) < inkMixShare){
+        tt->isMixed = 1;
+        tt->type = inkMixChannel;
+    }
+    tt->dir = TravelDirection(rand_r(seed) % NUM_TRAVEL_DIRECTIONS);
+    tt->distance = newDistance(tt->col, tt->row, travelerDir(tt));
+    tt->isLive = 1;
+    storeTraveler(slot, tt);
+    __atomic_fetch_add(&numLiveThreads, 1, __ATOMIC_RELAXED);
+}
+
+/** publishes a traveler's state in the traveler table (one 8-byte store)
+ * @param index     index of the traveler
+ * @param tt        new state
+ */
+void storeTraveler(unsigned int index, const TravelerInfo* tt){
+    __atomic_store(travelList + index, tt, __ATOMIC_RELEASE);
+}
+
+/** publishes a traveler's state if the publisher has read the table since
+ *  it was last written.  Eight entries share a cache line: written at
+ *  every step, the line would bounce between their threads, so the
+ *  moves are published once per frame of the publisher, and not at all
+ *  when nothing reads them.
+ * @param hot       the thread's copy of its traveler
+ */
+inline void publishTraveler(TravelerHotState* hot){
+    unsigned int epoch = __atomic_load_n(&travelerReadEpoch, __ATOMIC_RELAXED);
+    if (epoch != hot->publishedEpoch){
+        hot->publishedEpoch = epoch;
+        storeTraveler(hot->index, &hot->info);
+    }
+}
+
+/** reads a traveler's state from the traveler table
+ * @param index     index of the traveler
+ * @param tt        state read
+ */
+void loadTraveler(unsigned int index, TravelerInfo* tt){
+    __atomic_load(travelList + index, tt, __ATOMIC_ACQUIRE);
+}
+
+/** creates the ink producer threads.  The sharded coordinator runs them
+ *  without initializeApplication, so without the arena: their table is
+ *  then allocated here.
+ */
+void startProducerThreads(void)
+{
+    if (producerList == NULL)
+        producerList = (Producer*) calloc(NUM_PRODUCER_THREADS, sizeof(Producer));
+    for (int k=0; k<NUM_PRODUCER_THREADS; k++){
         producerList[k].type = ProducerType(rand() % NUM_TRAV_TYPES);
         producerList[k].threadID=0;
     }
 
-    for (unsigned int k = 0; k<NUM_PRODUCER_THREADS; k++){
+    for (int k = 0; k<NUM_PRODUCER_THREADS; k++){
         int errorCode = pthread_create(&producerList[k].threadID, nullptr, produceInkThread, producerList+k);
         if (errorCode != 0){
             // cerr << "could not pthread_create thread " << k <<
@@ -383,8 +1425,6 @@ void initializeApplication(void)
             exit (EXIT_FAILURE);
         }
      }
-
-
 }
 
 /** runs traveler thread
@@ -392,38 +1432,46 @@ void initializeApplication(void)
  * @return NULL     null pointer
  */
 void* runTravelerThread(void* data){
-    TravelerInfo* tt = static_cast<TravelerInfo*>(data);
+    //	The thread works on a private copy of its traveler, on a cache line
+    //	of its own, and publishes it to travelList when the publisher asks
+    //	for it (publishTraveler): neighbouring travelers' threads never write
+    //	the same line field by field, nor once per step.
+    TravelerHotState hot;
+    hot.index = static_cast<TravelerInfo*>(data) - travelList;
 						//dynamic, const, reinterpret
-	fflush(stdout);
-	tt->dir = generateDirection(tt->col, tt->row, tt->dir);
+    loadTraveler(hot.index, &hot.info);
+    hot.publishedEpoch = __atomic_load_n(&travelerReadEpoch, __ATOMIC_RELAXED);
+    TravelerInfo* tt = &hot.info;
+	if (numaPlacementOn)
+		numaBindThreadToNode(travelDebug[hot.index].node);
     while (tt->isLive){
-		// tt->dir = generateDirection(tt->dir);
-		// printf("here 2\n");
-		// fflush(stdout);
-		
-	//	TravelDirection dirs[NUM_TRAVEL_DIRECTIONS];
-		unsigned int x = tt->col, y = tt->row;
-		// printf("x = %d, y = %d\n", x, y);
-		
-		// change color in grid
-		// directions_allowed = getAcceptableDirections(x,y,dirs);
-		// pthread_mutex_unlock(tt->thread_lock);
-		if((x == 0 && y == 0) || (x == NUM_COLS-1 && y == 0) ||
-			(x == 0 && y == NUM_ROWS-1) || (x == NUM_COLS-1 && y == NUM_ROWS-1)){
-				tt->isLive = false;
-				//	must be synchronized
-				numLiveThreads--;
-				// kill thread
-			}
-		else{
-			// goodDir = checkDirection(x, y, tt->dir);
-			// printf("goodDir = %d\n", goodDir);
-			// if(goodDir == false) tt->dir = generateDirection(tt->dir);
-			tt->distance = newDistance(x, y, tt->dir);
-			moveTraveler(tt);
-			// tt->dir = generateDirection(tt->dir);
+		//	one life, in the loop specialized for the traveler's policies;
+		//	it returns when the traveler reaches a corner
+		if (tt->isMixed)
+			TRAVELER_MIXED_LIVES[movementPolicy](&hot);
+		else
+			TRAVELER_LIVES[movementPolicy][travelerType(tt)](&hot);
+
+		tt->isLive = false;
+		storeTraveler(hot.index, tt);
+		if (exclusiveCellsOn)
+			occupancyRelease(tt->row, tt->col, hot.index);
+		__atomic_fetch_sub(&numLiveThreads, 1, __ATOMIC_RELAXED);
+		//	In sustained-load mode the slot is recycled: the thread
+		//	parks until the spawner gives it a new traveler (maybe of
+		//	another color).  Otherwise, kill thread
+		if (recycleSlotsOn){
+			travelerPoolRelease(hot.index);
+			phaseEnter(WAIT_PHASE);
+			travelerPoolWaitForSpawn(hot.index);
+			phaseLeave();
+			loadTraveler(hot.index, tt);
 		}
     }
+    if (phaseCountersOn)
+        phaseThreadEnd();
+    if (trajectoryOn)
+        trajectoryThreadEnd();
 
     return NULL;
 }
@@ -455,75 +1503,223 @@ TravelDirection generateDirection(int col, int row, TravelDirection dir){
 	return dir;
 }
 
-/** runs traveler thread
- * @param tt            traveler info pointer
+/** moves a traveler one cell in its direction and paints the cell it
+ *  lands on; the caller publishes the move.  The traveler must already
+ *  hold the ink for that cell.
+ * @param tt            traveler info pointer (working copy)
  */
-void moveTraveler(TravelerInfo* tt){
-	// printf("here move traveler\n");
-	
-	int dir = tt->dir;
-	int distance = tt->distance;
-
-	for(int i = 0; i < distance; i++) {
-        bool moveNotCompleted = true;
-        while (moveNotCompleted) {
-            if(getInk(tt->type)) {
-
-                switch(dir) {
-                    case NORTH:
-                        tt->row -= 1;
-                    break;
-                    case SOUTH:
-                        tt->row += 1;
-                        break;
-                    case WEST:
-                        tt->col -= 1;
-                        break;
-                    case EAST:
-                        tt->col += 1;
-                        break;
-                    default:
-                        break;
-                }
-                pthread_mutex_lock(&grid_lock);
-                switch (tt->type) {
-                    case RED_TRAV: {
-                            unsigned char red = (grid[tt->row][tt->col] & 0x000000FF);
-                            if (red < 0xFF) {
-                                red += TRAV_INK_INCR;
-                                grid[tt->row][tt->col] |= red;
-                            }
-                        }
-                        break;
-                    case GREEN_TRAV: {
-                            unsigned char green = (grid[tt->row][tt->col] & 0x0000FF00) >> 8;
-                            if (green < 0xFF) {
-                                green += TRAV_INK_INCR;
-                                grid[tt->row][tt->col] |= (green << 8);
-                            }
-                        }
-                        break;
-                    case BLUE_TRAV: {
-                            unsigned char blue = (grid[tt->row][tt->col] & 0x00FF0000) >> 16;
-                            if (blue < 0xFF) {
-                                blue += TRAV_INK_INCR;
-                                grid[tt->row][tt->col] |= (blue << 16);
-                            }
-                        }
-                        break;
-                    default:
-                        break;
-                }
-                pthread_mutex_unlock(&grid_lock);
-                moveNotCompleted = false;
+template <class Color>
+inline void advanceTravelerAs(TravelerInfo* tt){
+    switch(tt->dir) {
+        case NORTH:
+            tt->row -= 1;
+        break;
+        case SOUTH:
+            tt->row += 1;
+            break;
+        case WEST:
+            tt->col -= 1;
+            break;
+        case EAST:
+            tt->col += 1;
+            break;
+        default:
+            break;
+    }
+    if (paintBufferOn){
+        //	a mixed traveler deposits each ink of its recipe
+        if constexpr (Color::MIXED){
+            for (int c = 0; c < NUM_TRAV_TYPES; c++)
+                if (inkMixRecipe[c] > 0)
+                    paintDeposit(tt->row, tt->col, c, TRAV_INK_INCR * inkMixRecipe[c]);
+        }
+        else
+            paintDeposit(tt->row, tt->col, Color::CHANNEL, TRAV_INK_INCR);
+    }
+    else {
+        lockGrid();
+        unsigned int* cell = (unsigned int*) &grid[tt->row][tt->col];
+        *cell = Color::deposit(*cell, TRAV_INK_INCR);
+        if (cellFormat != RGBA8_FORMAT){
+            if constexpr (Color::MIXED){
+                for (int c = 0; c < NUM_TRAV_TYPES; c++)
+                    if (inkMixRecipe[c] > 0)
+                        cellGridDeposit(tt->row, tt->col, c, TRAV_INK_INCR * inkMixRecipe[c]);
             }
             else
-                usleep(100000);
+                cellGridDeposit(tt->row, tt->col, Color::CHANNEL, TRAV_INK_INCR);
         }
+        unlockGrid();
+    }
+    if (heatmapOn){
+        if constexpr (Color::MIXED){
+            for (int c = 0; c < NUM_TRAV_TYPES; c++)
+                if (inkMixRecipe[c] > 0)
+                    heatmapRecord(tt->row, tt->col, c, TRAV_INK_INCR * inkMixRecipe[c]);
+        }
+        else
+            heatmapRecord(tt->row, tt->col, Color::CHANNEL, TRAV_INK_INCR);
+    }
+    if (totalMoves.fetch_add(1, memory_order_relaxed) == 0)
+        startupFirstStep();
+    if (numaReportOn)
+        numaRecordAccess(tt->row, NUM_ROWS);
+}
 
-		usleep(100000);
-	}
-	tt->dir = generateDirection(tt->col, tt->row, tt->dir);	
+/** same, for a traveler whose color is only known at run time (coroutine
+ *  travelers, which keep no hot state: the move is published at once)
+ * @param tt            traveler info pointer (working copy)
+ * @param index         index of the traveler in travelList
+ */
+void advanceTraveler(TravelerInfo* tt, unsigned int index){
+    if (tt->isMixed)
+        advanceTravelerAs<MixedColorPolicy>(tt);
+    else switch(travelerType(tt)) {
+        case RED_TRAV:
+            advanceTravelerAs<ColorPolicy<RED_TRAV> >(tt);
+            break;
+        case GREEN_TRAV:
+            advanceTravelerAs<ColorPolicy<GREEN_TRAV> >(tt);
+            break;
+        default:
+            advanceTravelerAs<ColorPolicy<BLUE_TRAV> >(tt);
+            break;
+    }
+    storeTraveler(index, tt);
+}
+
+/** claims the cell ahead of a traveler (exclusive cells), waiting while
+ *  another traveler holds it.  The traveler keeps its own cell meanwhile
+ *  but gives up after OCCUPANCY_MAX_WAITS tries, so two travelers waiting
+ *  on each other's cells cannot deadlock: one of them detours.
+ * @param tt            traveler info pointer (working copy)
+ * @param index         index of the traveler in travelList
+ * @return true         if the cell was claimed, false to detour
+ */
+bool claimNextCell(TravelerInfo* tt, unsigned int index){
+    TravelDirection dir = travelerDir(tt);
+    int row = tt->row + (dir == SOUTH) - (dir == NORTH);
+    int col = tt->col + (dir == EAST) - (dir == WEST);
+    for (int waits = 0; !occupancyClaim(row, col, index); ){
+        occupancyRecordBlocked();
+        if (++waits == OCCUPANCY_MAX_WAITS){
+            occupancyRecordDetour();
+            tt->isBlocked = 0;
+            return false;
+        }
+        //	shown as blocked while it waits
+        if (!tt->isBlocked){
+            tt->isBlocked = 1;
+            storeTraveler(index, tt);
+        }
+        phaseEnter(WAIT_PHASE);
+        timingWheelSleep(travelerSleepTime);
+    }
+    tt->isBlocked = 0;
+    return true;
+}
+
+/** runs one life of a traveler, until it reaches a corner.  The movement
+ *  and color policies are template parameters: each combination is its
+ *  own loop, with no branch on the traveler's type or movement.
+ * @param hot           the thread's copy of its traveler
+ */
+template <class Movement, class Color>
+void runTravelerLife(TravelerHotState* hot){
+    TravelerInfo* tt = &hot->info;
+    const PolicyGrid g = {(const unsigned int*) grid[0], NUM_ROWS, NUM_COLS};
+    if (trajectoryOn)
+        trajectoryBeginLife();
+    phaseEnter(DIRECTION_PHASE);
+    tt->dir = Movement::template turn<Color>(&g, tt->col, tt->row, travelerDir(tt));
+    while (!((tt->col == 0 || tt->col == NUM_COLS-1) && (tt->row == 0 || tt->row == NUM_ROWS-1))){
+        tt->distance = Movement::distance(&g, tt->col, tt->row, travelerDir(tt));
+        bool detour = false;
+        for (int i = 0; i < tt->distance; i++){
+            //	the cell ahead first, then the ink: a traveler never holds ink
+            //	it could not spend
+            if (exclusiveCellsOn && !claimNextCell(tt, hot->index)){
+                detour = true;
+                break;
+            }
+            int row = tt->row, col = tt->col;
+            phaseEnter(INK_PHASE);
+            uint64_t inkWaitStart = 0;
+            //	read before the take, so that a refill right after it wakes us
+            AdaptiveEvent* poured = inkPoured + Color::inkChannel();
+            uint32_t pouredSeen = adaptiveLocksOn ? adaptiveEventSequence(poured) : 0;
+            while (!Color::acquireInk()){
+                if (trajectoryOn && inkWaitStart == 0)
+                    inkWaitStart = trajectoryClock();
+                //	a waiting traveler still shows where it stands
+                publishTraveler(hot);
+                phaseEnter(WAIT_PHASE);
+                if (adaptiveLocksOn){
+                    adaptiveEventWait(poured, pouredSeen, travelerSleepTime);
+                    pouredSeen = adaptiveEventSequence(poured);
+                }
+                else
+                    timingWheelSleep(travelerSleepTime);
+                phaseEnter(INK_PHASE);
+            }
+            phaseEnter(PAINT_PHASE);
+            advanceTravelerAs<Color>(tt);
+            publishTraveler(hot);
+            if (trajectoryOn)
+                trajectoryRecord(hot->index, tt->row, tt->col, travelerDir(tt), travelerType(tt),
+                                 inkWaitStart > 0 ? trajectoryClock() - inkWaitStart : 0);
+            if (exclusiveCellsOn)
+                occupancyRelease(row, col, hot->index);
+            phaseEnter(WAIT_PHASE);
+            timingWheelSleep(travelerSleepTime);
+        }
+        //	a blocked traveler turns aside, whatever its movement
+        phaseEnter(DIRECTION_PHASE);
+        if (detour)
+            tt->dir = RandomTurnPolicy::turn<Color>(&g, tt->col, tt->row, travelerDir(tt));
+        else
+            tt->dir = Movement::template turn<Color>(&g, tt->col, tt->row, travelerDir(tt));
+        publishTraveler(hot);
+    }
+    if (trajectoryOn)
+        trajectoryEndLife(hot->index, tt->row, tt->col, travelerDir(tt), travelerType(tt));
+    phaseLeave();
+}
+
+//	the lives of all the combinations, indexed by movement then color
+const TravelerLifeFunc TRAVELER_LIVES[NUM_MOVEMENT_POLICIES][NUM_TRAV_TYPES] = {
+    {runTravelerLife<RandomTurnPolicy, ColorPolicy<RED_TRAV> >, runTravelerLife<RandomTurnPolicy, ColorPolicy<GREEN_TRAV> >,
+        runTravelerLife<RandomTurnPolicy, ColorPolicy<BLUE_TRAV> >},
+    {runTravelerLife<StraightLinePolicy, ColorPolicy<RED_TRAV> >, runTravelerLife<StraightLinePolicy, ColorPolicy<GREEN_TRAV> >,
+        runTravelerLife<StraightLinePolicy, ColorPolicy<BLUE_TRAV> >},
+    {runTravelerLife<InkSeekingPolicy, ColorPolicy<RED_TRAV> >, runTravelerLife<InkSeekingPolicy, ColorPolicy<GREEN_TRAV> >,
+        runTravelerLife<InkSeekingPolicy, ColorPolicy<BLUE_TRAV> >},
+    {runTravelerLife<SpaceFillingPolicy, ColorPolicy<RED_TRAV> >, runTravelerLife<SpaceFillingPolicy, ColorPolicy<GREEN_TRAV> >,
+        runTravelerLife<SpaceFillingPolicy, ColorPolicy<BLUE_TRAV> >}
+};
+
+//	the lives of mixed travelers, indexed by movement
+const TravelerLifeFunc TRAVELER_MIXED_LIVES[NUM_MOVEMENT_POLICIES] = {
+    runTravelerLife<RandomTurnPolicy, MixedColorPolicy>, runTravelerLife<StraightLinePolicy, MixedColorPolicy>,
+    runTravelerLife<InkSeekingPolicy, MixedColorPolicy>, runTravelerLife<SpaceFillingPolicy, MixedColorPolicy>
+};
+
+/** adds a traveler's ink to a grid cell.  Caller must hold the grid lock
+ *  (lockGrid)
+ * @param row           cell row
+ * @param col           cell col
+ * @param type          traveler color type
+ */
+void paintCell(int row, int col, TravelerType type){
+    //	the channel of the traveler's color is byte 'type' of the cell, and
+    //	saturates at 0xFF
+    int shift = 8 * type;
+    unsigned int cell = grid[row][col];
+    unsigned int level = (cell >> shift) & 0xFF;
+    level = min(0xFFU, level + TRAV_INK_INCR);
+    grid[row][col] = (cell & ~(0xFFU << shift)) | (level << shift);
+    if (cellFormat != RGBA8_FORMAT)
+        cellGridDeposit(row, col, type, TRAV_INK_INCR);
 }
 
 /** runs traveler thread
@@ -584,7 +1780,7 @@ void* produceInkThread(void* ptr){
     
     while (true) {
         
-        usleep(producerSleepTime);
+        timingWheelSleep(producerSleepTime);
         switch(producer->type) {
             case RED_TRAV:
                 refillRedInk(1);
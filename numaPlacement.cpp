@@ -0,0 +1,262 @@
+//
+//  numaPlacement.cpp
+//  GL threads
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#if defined(__linux__)
+	#include <sys/syscall.h>
+	#include <linux/mempolicy.h>
+#endif
+//
+#include "numaPlacement.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+const int MAX_NUMA_NODES = 64;
+const int MAX_NUMA_CPUS = 1024;
+//	words of the mbind node mask: node ids up to 1023
+const int NUMA_MASK_WORDS = 16;
+const int BITS_PER_WORD = 8 * sizeof(unsigned long);
+const size_t NUMA_PAGE_SIZE = 4096;
+
+//	Access counters are written by many threads: keep each node's pair on
+//	its own cache line.
+typedef struct alignas(64) NodeCounters {
+	atomic<unsigned long> local;
+	atomic<unsigned long> remote;
+} NodeCounters;
+
+int numaNodes = 0;
+//	Nodes are indexed 0..numaNodes-1, skipping the memory-only ones and
+//	holes in the online list; the kernel knows them by their sysfs id.
+int numaNodeIds[MAX_NUMA_NODES];
+vector<int> numaNodeCpus[MAX_NUMA_NODES];
+int numaCpuToNode[MAX_NUMA_CPUS];
+NodeCounters numaCounters[MAX_NUMA_NODES];
+atomic<int> numaMbindFailures(0);
+
+//	node a thread was explicitly bound to, -1 if it floats
+thread_local int tBoundNode = -1;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+/** Parses a sysfs cpu/node list such as "0-3,8-11"
+ *  @param str      the list
+ *  @param out      receives the ids
+ */
+static void parseIdList(const char* str, vector<int>& out)
+{
+	const char* p = str;
+	while (*p != '\0' && *p != '\n')
+	{
+		char* end;
+		int first = (int) strtol(p, &end, 10);
+		if (end == p)
+			break;
+		int last = first;
+		p = end;
+		if (*p == '-')
+		{
+			last = (int) strtol(p+1, &end, 10);
+			p = end;
+		}
+		for (int k=first; k<=last; k++)
+			out.push_back(k);
+		if (*p == ',')
+			p++;
+	}
+}
+
+static bool readIdListFile(const char* path, vector<int>& out)
+{
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL)
+		return false;
+	char line[4096];
+	bool ok = (fgets(line, sizeof(line), fp) != NULL);
+	fclose(fp);
+	if (ok)
+		parseIdList(line, out);
+	return ok && !out.empty();
+}
+
+typedef struct TouchJob {
+	void* addr;
+	size_t len;
+	int node;
+} TouchJob;
+
+static void* touchRangeThread(void* data)
+{
+	TouchJob* job = static_cast<TouchJob*>(data);
+	numaBindThreadToNode(job->node);
+	memset(job->addr, 0, job->len);
+	return NULL;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+int numaInitialize(void)
+{
+	for (int k=0; k<MAX_NUMA_CPUS; k++)
+		numaCpuToNode[k] = 0;
+	numaNodes = 0;
+
+	vector<int> nodes;
+	if (readIdListFile("/sys/devices/system/node/online", nodes))
+	{
+		for (unsigned int k=0; k<nodes.size() && numaNodes<MAX_NUMA_NODES; k++)
+		{
+			char path[128];
+			sprintf(path, "/sys/devices/system/node/node%d/cpulist", nodes[k]);
+			vector<int> cpus;
+			//	memory-only nodes have no cpus: workers can't live there
+			if (readIdListFile(path, cpus))
+			{
+				for (unsigned int c=0; c<cpus.size(); c++)
+					if (cpus[c] < MAX_NUMA_CPUS)
+						numaCpuToNode[cpus[c]] = numaNodes;
+				numaNodeIds[numaNodes] = nodes[k];
+				numaNodeCpus[numaNodes++] = cpus;
+			}
+		}
+	}
+
+	if (numaNodes == 0)
+	{
+		long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+		numaNodeCpus[0].clear();
+		for (int c=0; c<numCpus && c<MAX_NUMA_CPUS; c++)
+			numaNodeCpus[0].push_back(c);
+		numaNodeIds[0] = 0;
+		numaNodes = 1;
+	}
+
+	return numaNodes;
+}
+
+int numaNumNodes(void)
+{
+	return numaNodes > 0 ? numaNodes : 1;
+}
+
+int numaNodeOfRow(int row, int numRows)
+{
+	//	inverse of numaFirstRowOfNode
+	return (int) (((long) row * numaNumNodes()) / numRows);
+}
+
+int numaFirstRowOfNode(int node, int numRows)
+{
+	return (int) (((long) node * numRows + numaNumNodes() - 1) / numaNumNodes());
+}
+
+bool numaBindThreadToNode(int node)
+{
+	if (node < 0 || node >= numaNodes)
+		return false;
+
+#if defined(__linux__)
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	for (unsigned int k=0; k<numaNodeCpus[node].size(); k++)
+		CPU_SET(numaNodeCpus[node][k], &cpuSet);
+
+	bool ok = (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0);
+	if (ok)
+		tBoundNode = node;
+	return ok;
+#else
+	//	macOS only has affinity hints, and no NUMA anyway
+	return false;
+#endif
+}
+
+void numaPlaceRange(void* addr, size_t len, int node)
+{
+	if (len == 0)
+		return;
+
+	//	mbind works on whole pages: shrink the range to the pages it fully
+	//	covers, the partial pages at the ends are left to first-touch.
+	unsigned long start = ((unsigned long) addr + NUMA_PAGE_SIZE - 1) & ~(NUMA_PAGE_SIZE - 1);
+	unsigned long end = ((unsigned long) addr + len) & ~(NUMA_PAGE_SIZE - 1);
+#if defined(__linux__)
+	int nodeId = node >= 0 && node < numaNodes ? numaNodeIds[node] : -1;
+	if (end > start && numaNodes > 1 && nodeId >= 0 && nodeId < NUMA_MASK_WORDS * BITS_PER_WORD)
+	{
+		unsigned long mask[NUMA_MASK_WORDS] = {0};
+		mask[nodeId / BITS_PER_WORD] = 1UL << (nodeId % BITS_PER_WORD);
+		if (syscall(SYS_mbind, (void*) start, end - start, MPOL_BIND, mask,
+					sizeof(mask) * 8, 0) != 0)
+			numaMbindFailures++;
+	}
+#endif
+
+	TouchJob job = {addr, len, node};
+	pthread_t toucher;
+	if (pthread_create(&toucher, nullptr, touchRangeThread, &job) != 0)
+	{
+		memset(addr, 0, len);
+		return;
+	}
+	pthread_join(toucher, NULL);
+}
+
+void numaRecordAccess(int row, int numRows)
+{
+	int myNode = tBoundNode;
+	if (myNode < 0)
+	{
+#if defined(__linux__)
+		int cpu = sched_getcpu();
+#else
+		int cpu = 0;
+#endif
+		myNode = (cpu >= 0 && cpu < MAX_NUMA_CPUS) ? numaCpuToNode[cpu] : 0;
+	}
+
+	if (numaNodeOfRow(row, numRows) == myNode)
+		numaCounters[myNode].local.fetch_add(1, memory_order_relaxed);
+	else
+		numaCounters[myNode].remote.fetch_add(1, memory_order_relaxed);
+}
+
+void numaPrintReport(FILE* out)
+{
+	fprintf(out, "NUMA placement report (%d node%s)\n", numaNumNodes(),
+			numaNumNodes() > 1 ? "s" : "");
+	if (numaMbindFailures > 0)
+		fprintf(out, "  mbind refused %d time(s): placement relied on first-touch\n",
+				numaMbindFailures.load());
+	fprintf(out, "  %-6s %12s %12s %10s\n", "node", "local", "remote", "remote %");
+
+	unsigned long totLocal = 0, totRemote = 0;
+	for (int k=0; k<numaNumNodes(); k++)
+	{
+		unsigned long local = numaCounters[k].local.load();
+		unsigned long remote = numaCounters[k].remote.load();
+		totLocal += local;
+		totRemote += remote;
+		double ratio = (local + remote) > 0 ? (100.0 * remote) / (local + remote) : 0.0;
+		fprintf(out, "  %-6d %12lu %12lu %9.1f%%\n", numaNodeIds[k], local, remote, ratio);
+	}
+	double ratio = (totLocal + totRemote) > 0 ? (100.0 * totRemote) / (totLocal + totRemote) : 0.0;
+	fprintf(out, "  %-6s %12lu %12lu %9.1f%%\n", "all", totLocal, totRemote, ratio);
+}
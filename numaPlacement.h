@@ -0,0 +1,71 @@
+//
+//  numaPlacement.h
+//  GL threads
+//
+//  NUMA-aware placement of the grid, the traveler table, and the threads
+//	that work on them.  The grid is split into horizontal bands of rows,
+//	one band per NUMA node.  Each band (and the block of travelers that
+//	start in it) is bound to its node's memory, and the traveler threads
+//	are bound to that node's cores.
+//
+
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+#include <cstddef>
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Discovers the NUMA topology (through sysfs).  Falls back to a single
+ *	node holding all online cpus when no topology is exposed.
+ *  @return number of nodes found
+ */
+int numaInitialize(void);
+
+int numaNumNodes(void);
+
+/** Node owning a given grid row
+ *  @param row      grid row
+ *  @param numRows  number of rows in the grid
+ *  @return node index
+ */
+int numaNodeOfRow(int row, int numRows);
+
+/** First row of the band of rows owned by a node
+ *  @param node     node index
+ *  @param numRows  number of rows in the grid
+ *  @return first row of the band (the band ends where the next one starts)
+ */
+int numaFirstRowOfNode(int node, int numRows);
+
+/** Binds the calling thread to the cpus of a node
+ *  @param node     node index
+ *  @return true if the affinity could be set
+ */
+bool numaBindThreadToNode(int node);
+
+/** Binds a memory range to a node (explicit mbind), then touches it from a
+ *	thread running on that node, so that placement also works when mbind is
+ *	not permitted (first-touch).  The range is zero-filled.
+ *  @param addr     start of the range (should be page-aligned)
+ *  @param len      length of the range in bytes
+ *  @param node     node index (the mask holds its sysfs id)
+ */
+void numaPlaceRange(void* addr, size_t len, int node);
+
+/** Records one grid cell access from the calling thread, as local or
+ *	remote depending on the node of the cpu the thread runs on.
+ *  @param row      row of the cell accessed
+ *  @param numRows  number of rows in the grid
+ */
+void numaRecordAccess(int row, int numRows);
+
+/** Prints the per-node local/remote access table
+ *  @param out      output stream
+ */
+void numaPrintReport(FILE* out);
+
+#endif // NUMA_PLACEMENT_H
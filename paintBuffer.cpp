@@ -0,0 +1,417 @@
+//
+//  paintBuffer.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+//
+#include "paintBuffer.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+/** A deposit waiting to be merged
+ *  @var cell       cell index (row * numCols + col)
+ *  @var channel    byte of the cell
+ *  @var amount     amount added
+ */
+typedef struct PaintRecord {
+	uint32_t cell;
+	uint8_t channel;
+	uint8_t amount;
+	uint16_t unused;
+} PaintRecord;
+
+const uint32_t PAINT_RING_SIZE = 4096;
+const uint32_t PAINT_RING_MASK = PAINT_RING_SIZE - 1;
+
+//	A thread's deposit buffer: a single-producer (its thread),
+//	single-consumer (whoever holds merge_lock) ring.
+typedef struct alignas(64) PaintRing {
+	atomic<uint32_t> head;
+	alignas(64) atomic<uint32_t> tail;
+	//	head seen by the merge in progress
+	uint32_t mergeHead;
+	struct PaintRing* next;
+	PaintRecord records[PAINT_RING_SIZE];
+} PaintRing;
+
+typedef struct PaintBenchThread {
+	int index;
+	bool buffered;
+	pthread_t threadID;
+} PaintBenchThread;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+//	Deposits are bucketed by tile of consecutive cells.  A tile that got
+//	at least DENSE_TILE_DEPOSITS deposits is added to the grid with vector
+//	adds, a sparser one cell by cell.
+const int TILE_SHIFT = 8;
+const uint32_t TILE_CELLS = 1U << TILE_SHIFT;
+const uint32_t DENSE_TILE_DEPOSITS = TILE_CELLS / 16;
+
+uint8_t* paintCells = NULL;
+uint32_t paintNumCells = 0;
+uint32_t paintNumCols = 0;
+int paintIntervalUs = 1000;
+pthread_t paintMergeThreadID;
+atomic<bool> paintMergeRunning(false);
+void (*paintMirror)(size_t firstCell, const uint8_t* delta, size_t numCells) = NULL;
+
+//	all the threads' rings (rings live until the pipeline is stopped: a
+//	thread that exits leaves its last deposits for the next merge)
+atomic<PaintRing*> paintRings(NULL);
+thread_local PaintRing* tPaintRing = NULL;
+
+//	The merge state belongs to whoever holds merge_lock: the deposits
+//	summed per cell (same layout as the grid, zero between merges), the
+//	deposit count of each tile, and the tiles touched.
+pthread_mutex_t merge_lock = PTHREAD_MUTEX_INITIALIZER;
+uint8_t* mergeDelta = NULL;
+uint32_t* mergeTileCount = NULL;
+vector<uint32_t>& mergeTiles = *new vector<uint32_t>;
+
+unsigned long paintMerges = 0;
+unsigned long paintRecordsMerged = 0;
+unsigned long paintTilesApplied = 0;
+unsigned long paintDenseTiles = 0;
+unsigned long paintBytesApplied = 0;
+double paintMergeSeconds = 0.;
+atomic<unsigned long> paintFullFlushes(0);
+
+//	deposits per thread in the benchmark
+const int BENCH_DEPOSITS = 1 << 21;
+const int BENCH_ROWS = 512, BENCH_COLS = 512;
+const int BENCH_AMOUNT = 16;
+uint8_t* benchLockedCells = NULL;
+pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static double nowSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static PaintRing* registerRing(void)
+{
+	PaintRing* ring = new PaintRing;
+	ring->head.store(0);
+	ring->tail.store(0);
+	ring->next = paintRings.load();
+	while (!paintRings.compare_exchange_weak(ring->next, ring))
+		;
+	tPaintRing = ring;
+	return ring;
+}
+
+/** dst[k] = min(255, dst[k] + delta[k]), 16 bytes at a time
+ */
+static void addSaturating(uint8_t* dst, const uint8_t* delta, size_t numBytes)
+{
+	size_t k = 0;
+#if defined(__SSE2__)
+	for (; k+16 <= numBytes; k+=16)
+	{
+		__m128i cells = _mm_loadu_si128((const __m128i*) (dst + k));
+		__m128i add = _mm_load_si128((const __m128i*) (delta + k));
+		_mm_storeu_si128((__m128i*) (dst + k), _mm_adds_epu8(cells, add));
+	}
+#endif
+	for (; k<numBytes; k++)
+		dst[k] = (uint8_t) min(255, dst[k] + delta[k]);
+}
+
+static void zeroBytes(uint8_t* dst, size_t numBytes)
+{
+	size_t k = 0;
+#if defined(__SSE2__)
+	for (; k+16 <= numBytes; k+=16)
+		_mm_store_si128((__m128i*) (dst + k), _mm_setzero_si128());
+#endif
+	for (; k<numBytes; k++)
+		dst[k] = 0;
+}
+
+//	Caller holds merge_lock
+static void mergeLocked(void)
+{
+	double start = nowSeconds();
+	unsigned long numRecords = 0;
+
+	//	Pass 1: sum each ring's pending deposits into the delta grid (with
+	//	saturation: deposits are all positive, so saturating the sum, then
+	//	the cell, is the same as saturating the cell at every deposit) and
+	//	count them per tile.
+	PaintRing* rings = paintRings.load();
+	for (PaintRing* ring = rings; ring != NULL; ring = ring->next)
+	{
+		ring->mergeHead = ring->head.load(memory_order_acquire);
+		for (uint32_t k=ring->tail.load(memory_order_relaxed); k!=ring->mergeHead; k++)
+		{
+			const PaintRecord* record = ring->records + (k & PAINT_RING_MASK);
+			uint8_t* delta = mergeDelta + (size_t) record->cell * 4 + record->channel;
+			*delta = (uint8_t) min(255, *delta + record->amount);
+			uint32_t tile = record->cell >> TILE_SHIFT;
+			if (mergeTileCount[tile]++ == 0)
+				mergeTiles.push_back(tile);
+			numRecords++;
+		}
+	}
+	if (numRecords == 0)
+		return;
+
+	//	Pass 2: dense tiles, whole tile at a time
+	for (unsigned int k=0; k<mergeTiles.size(); k++)
+	{
+		uint32_t tile = mergeTiles[k];
+		if (mergeTileCount[tile] < DENSE_TILE_DEPOSITS)
+			continue;
+		size_t first = (size_t) tile * TILE_CELLS * 4;
+		size_t numBytes = (size_t) (min(paintNumCells, (tile + 1) * TILE_CELLS) - tile * TILE_CELLS) * 4;
+		addSaturating(paintCells + first, mergeDelta + first, numBytes);
+		if (paintMirror != NULL)
+			paintMirror(first / 4, mergeDelta + first, numBytes / 4);
+		zeroBytes(mergeDelta + first, numBytes);
+		mergeTileCount[tile] = 0;
+		paintDenseTiles++;
+		paintBytesApplied += numBytes;
+	}
+
+	//	Pass 3: the deposits of the sparse tiles, cell by cell (a cell's
+	//	delta is cleared once added, so repeated deposits add it once)
+	for (PaintRing* ring = rings; ring != NULL; ring = ring->next)
+	{
+		for (uint32_t k=ring->tail.load(memory_order_relaxed); k!=ring->mergeHead; k++)
+		{
+			const PaintRecord* record = ring->records + (k & PAINT_RING_MASK);
+			if (mergeTileCount[record->cell >> TILE_SHIFT] == 0)
+				continue;
+			size_t offset = (size_t) record->cell * 4 + record->channel;
+			paintCells[offset] = (uint8_t) min(255, paintCells[offset] + mergeDelta[offset]);
+			if (paintMirror != NULL)
+			{
+				uint8_t cellDelta[4] = {0, 0, 0, 0};
+				cellDelta[record->channel] = mergeDelta[offset];
+				paintMirror(record->cell, cellDelta, 1);
+			}
+			mergeDelta[offset] = 0;
+		}
+		ring->tail.store(ring->mergeHead, memory_order_release);
+	}
+
+	for (unsigned int k=0; k<mergeTiles.size(); k++)
+		mergeTileCount[mergeTiles[k]] = 0;
+	paintTilesApplied += mergeTiles.size();
+	mergeTiles.clear();
+
+	paintMerges++;
+	paintRecordsMerged += numRecords;
+	paintMergeSeconds += nowSeconds() - start;
+}
+
+static void* mergeThread(void* data)
+{
+	while (paintMergeRunning.load())
+	{
+		usleep(paintIntervalUs);
+		paintBufferFlush();
+	}
+	return NULL;
+}
+
+//	Stops the merge thread, merges what is left and frees the merge state
+//	and the rings.  No thread may deposit any more.
+static void stopPaintBuffer(void)
+{
+	paintMergeRunning.store(false);
+	pthread_join(paintMergeThreadID, NULL);
+	paintBufferFlush();
+	for (PaintRing* ring = paintRings.exchange(NULL); ring != NULL; )
+	{
+		PaintRing* next = ring->next;
+		delete ring;
+		ring = next;
+	}
+	free(mergeDelta);
+	free(mergeTileCount);
+	mergeDelta = NULL;
+	mergeTileCount = NULL;
+}
+
+static unsigned int nextRandom(unsigned int* seed)
+{
+	*seed = *seed * 1103515245u + 12345u;
+	return *seed >> 8;
+}
+
+//	Each benchmark thread deposits the same pseudo-random sequence in both
+//	modes, so that the two grids must come out identical.
+static void* benchThread(void* data)
+{
+	PaintBenchThread* info = static_cast<PaintBenchThread*>(data);
+	unsigned int seed = info->index + 1;
+	for (int k=0; k<BENCH_DEPOSITS; k++)
+	{
+		unsigned int r = nextRandom(&seed);
+		int cell = r % (BENCH_ROWS * BENCH_COLS);
+		int channel = (r >> 20) % 3;
+		if (info->buffered)
+			paintDeposit(cell / BENCH_COLS, cell % BENCH_COLS, channel, BENCH_AMOUNT);
+		else
+		{
+			//	the per-cell path, as in paintCell
+			pthread_mutex_lock(&bench_lock);
+			uint8_t* value = benchLockedCells + cell * 4 + channel;
+			*value = (uint8_t) min(255, *value + BENCH_AMOUNT);
+			pthread_mutex_unlock(&bench_lock);
+		}
+	}
+	return NULL;
+}
+
+static double runBench(int numThreads, bool buffered)
+{
+	PaintBenchThread* threads = new PaintBenchThread[numThreads];
+	double start = nowSeconds();
+	for (int k=0; k<numThreads; k++)
+	{
+		threads[k].index = k;
+		threads[k].buffered = buffered;
+		if (pthread_create(&threads[k].threadID, nullptr, benchThread, threads + k) != 0)
+		{
+			fprintf(stderr, "could not create benchmark thread %d\n", k);
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (int k=0; k<numThreads; k++)
+		pthread_join(threads[k].threadID, NULL);
+	if (buffered)
+		paintBufferFlush();
+	double elapsed = nowSeconds() - start;
+	delete [] threads;
+	return elapsed;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void paintBufferStart(int** grid, int numRows, int numCols, int intervalUs)
+{
+	paintCells = (uint8_t*) grid[0];
+	paintNumCells = (uint32_t) numRows * numCols;
+	paintNumCols = numCols;
+	mergeDelta = (uint8_t*) aligned_alloc(64, ((size_t) paintNumCells * 4 + 63) & ~(size_t) 63);
+	memset(mergeDelta, 0, (size_t) paintNumCells * 4);
+	mergeTileCount = (uint32_t*) calloc((paintNumCells >> TILE_SHIFT) + 1, sizeof(uint32_t));
+	paintIntervalUs = max(1, intervalUs);
+	paintMergeRunning.store(true);
+	if (pthread_create(&paintMergeThreadID, nullptr, mergeThread, NULL) != 0)
+	{
+		fprintf(stderr, "could not create the paint merge thread\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void paintBufferSetMirror(void (*blend)(size_t firstCell, const uint8_t* delta, size_t numCells))
+{
+	paintMirror = blend;
+}
+
+void paintDeposit(int row, int col, int channel, int amount)
+{
+	PaintRing* ring = tPaintRing != NULL ? tPaintRing : registerRing();
+	uint32_t head = ring->head.load(memory_order_relaxed);
+	while (head - ring->tail.load(memory_order_acquire) >= PAINT_RING_SIZE)
+	{
+		paintFullFlushes.fetch_add(1, memory_order_relaxed);
+		paintBufferFlush();
+	}
+
+	PaintRecord* record = ring->records + (head & PAINT_RING_MASK);
+	record->cell = (uint32_t) row * paintNumCols + col;
+	record->channel = (uint8_t) channel;
+	record->amount = (uint8_t) min(255, amount);
+	ring->head.store(head + 1, memory_order_release);
+}
+
+void paintBufferFlush(void)
+{
+	pthread_mutex_lock(&merge_lock);
+	mergeLocked();
+	pthread_mutex_unlock(&merge_lock);
+}
+
+pthread_mutex_t* paintBufferMergeLock(void)
+{
+	return &merge_lock;
+}
+
+void paintBufferPrintReport(FILE* out)
+{
+	fprintf(out, "Paint buffers: %lu deposits in %lu merges", paintRecordsMerged, paintMerges);
+	if (paintMerges > 0)
+		fprintf(out, " (%.1f per merge, %.1f tiles, %.0f ns per deposit)", (double) paintRecordsMerged / paintMerges,
+				(double) paintTilesApplied / paintMerges, 1e9 * paintMergeSeconds / max(1UL, paintRecordsMerged));
+	fprintf(out, "\n  %lu of %lu tiles dense: %lu bytes of grid updated by %s saturating adds\n",
+			paintDenseTiles, paintTilesApplied, paintBytesApplied,
+#if defined(__SSE2__)
+			"SSE2"
+#else
+			"scalar"
+#endif
+			);
+	fprintf(out, "  %lu merges run by a depositing thread with a full buffer\n", paintFullFlushes.load());
+}
+
+void paintBenchmark(int numThreads, FILE* out)
+{
+	size_t numBytes = (size_t) BENCH_ROWS * BENCH_COLS * 4;
+	benchLockedCells = (uint8_t*) calloc(numBytes, 1);
+	uint8_t* bufferedCells = (uint8_t*) calloc(numBytes, 1);
+	int** bufferedGrid = (int**) malloc(BENCH_ROWS * sizeof(int*));
+	for (int i=0; i<BENCH_ROWS; i++)
+		bufferedGrid[i] = (int*) (bufferedCells + (size_t) i * BENCH_COLS * 4);
+
+	double lockedTime = runBench(numThreads, false);
+	paintBufferStart(bufferedGrid, BENCH_ROWS, BENCH_COLS, 1000);
+	double bufferedTime = runBench(numThreads, true);
+
+	double deposits = (double) numThreads * BENCH_DEPOSITS;
+	fprintf(out, "Paint benchmark: %d threads x %d deposits on a %dx%d grid\n", numThreads,
+			BENCH_DEPOSITS, BENCH_ROWS, BENCH_COLS);
+	fprintf(out, "  locked per-cell:         %.2f s (%.1f M deposits/s)\n", lockedTime, deposits / lockedTime * 1e-6);
+	fprintf(out, "  buffered + merged:       %.2f s (%.1f M deposits/s)\n", bufferedTime, deposits / bufferedTime * 1e-6);
+	fprintf(out, "  speedup %.2fx, grids %s\n", lockedTime / bufferedTime,
+			memcmp(benchLockedCells, bufferedCells, numBytes) == 0 ? "identical" : "DIFFER");
+	paintBufferPrintReport(out);
+
+	stopPaintBuffer();
+	free(bufferedGrid);
+	free(bufferedCells);
+	free(benchLockedCells);
+	benchLockedCells = NULL;
+}
@@ -0,0 +1,73 @@
+//
+//  paintBuffer.h
+//  GL threads
+//
+//  Buffered deposit pipeline for the grid.  Instead of a locked
+//	read-modify-write of a cell per step, travelers append (cell, channel,
+//	amount) records to a buffer of their own thread.  A merge stage drains
+//	all the buffers, sums the deposits per cell, buckets them by tile, and
+//	adds the tiles that got many deposits to the grid with per-byte
+//	saturating vector adds (the others cell by cell).  The merge stage is
+//	then the only writer of the grid, and grid_lock is not needed.
+//
+
+#ifndef PAINT_BUFFER_H
+#define PAINT_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <pthread.h>
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Starts the merge thread
+ *  @param grid         grid (rows must be contiguous, starting at grid[0])
+ *  @param numRows      number of rows
+ *  @param numCols      number of columns
+ *  @param intervalUs   time between two merges (in microseconds)
+ */
+void paintBufferStart(int** grid, int numRows, int numCols, int intervalUs);
+
+/** Sets a second grid that every merge also adds its deltas to (the
+ *	accumulation grid of a wide cell format, see cellFormat.h).  A cell's
+ *	deposits summed in one merge still saturate at 255.
+ *  @param blend        adds the RGBA8 deltas of numCells cells, from cell
+ *                      firstCell on (NULL: no second grid)
+ */
+void paintBufferSetMirror(void (*blend)(size_t firstCell, const uint8_t* delta, size_t numCells));
+
+/** Queues a deposit in the calling thread's buffer.  If the buffer is
+ *	full, the calling thread runs a merge itself.
+ *  @param row          cell row
+ *  @param col          cell column
+ *  @param channel      byte of the cell to add to (0: red, 1: green, 2: blue)
+ *  @param amount       amount added (the channel saturates at 255)
+ */
+void paintDeposit(int row, int col, int channel, int amount);
+
+/** Merges all the pending deposits into the grid, from the calling thread
+ */
+void paintBufferFlush(void);
+
+/** Lock held while the grid is written by a merge
+ *  @return the lock
+ */
+pthread_mutex_t* paintBufferMergeLock(void);
+
+/** Prints the merge counters
+ *  @param out          output stream
+ */
+void paintBufferPrintReport(FILE* out);
+
+/** Deposits the same random sequences through the locked per-cell path and
+ *	through the buffers, checks that the two grids agree, and prints both
+ *	throughputs
+ *  @param numThreads   number of depositing threads
+ *  @param out          output stream
+ */
+void paintBenchmark(int numThreads, FILE* out);
+
+#endif // PAINT_BUFFER_H
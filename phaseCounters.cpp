@@ -0,0 +1,320 @@
+//
+//  phaseCounters.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+//
+#include "phaseCounters.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+enum PhaseEventID {	CYCLES_EVENT = 0,
+					INSTRUCTIONS_EVENT,
+					LLC_MISSES_EVENT,
+					BRANCH_MISSES_EVENT,
+					CONTEXT_SWITCHES_EVENT,
+					TASK_CLOCK_EVENT,
+					//
+					NUM_PHASE_EVENTS
+};
+
+typedef struct PhaseEventDef {
+	uint32_t type;
+	uint64_t config;
+	const char* name;
+} PhaseEventDef;
+
+/** Totals of a phase
+ *  @var entries    times the phase was entered
+ *  @var wallNs     wall-clock time spent in the phase
+ *  @var value      count of each event (task clock in ns)
+ */
+typedef struct PhaseTotals {
+	uint64_t entries;
+	uint64_t wallNs;
+	uint64_t value[NUM_PHASE_EVENTS];
+} PhaseTotals;
+
+/** A counted thread.  Only its thread writes it; the report reads it.
+ *  @var groupFd    leader of the thread's event group (-1: none opened)
+ *  @var fd         fd of each event (-1: not counted by perf)
+ *  @var position   position of each event in a read of the group
+ *  @var numOpen    events in the group
+ *  @var current    phase being counted (-1: none)
+ *  @var lastNs     wall-clock time at the last phase change
+ *  @var last       event values at the last phase change
+ *  @var totals     totals per phase
+ *  @var next       next thread of the list
+ */
+typedef struct PhaseThread {
+	int groupFd;
+	int fd[NUM_PHASE_EVENTS];
+	int position[NUM_PHASE_EVENTS];
+	int numOpen;
+	int current;
+	uint64_t lastNs;
+	uint64_t last[NUM_PHASE_EVENTS];
+	PhaseTotals totals[NUM_SIM_PHASES];
+	PhaseThread* next;
+} PhaseThread;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+bool phaseCountingOn = false;
+
+const PhaseEventDef PHASE_EVENTS[NUM_PHASE_EVENTS] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "LLC misses"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch misses"},
+	{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context switches"},
+	{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task clock"}
+};
+const char* SIM_PHASE_NAME[NUM_SIM_PHASES] = {"ink", "paint", "direction", "wait", "render"};
+
+//	errno of the probe of each event (0: available)
+int phaseEventError[NUM_PHASE_EVENTS];
+
+thread_local PhaseThread* phaseSelf = NULL;
+PhaseThread* phaseThreads = NULL;
+pthread_mutex_t phase_list_lock = PTHREAD_MUTEX_INITIALIZER;
+int phaseNumThreads = 0;
+//	threads that got fewer events than the probe found (out of fds...)
+int phaseNumDegraded = 0;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static uint64_t nowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static int openEvent(int k, int groupFd)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PHASE_EVENTS[k].type;
+	attr.config = PHASE_EVENTS[k].config;
+	//	context switches happen in the kernel: only hardware events leave it out
+	attr.exclude_kernel = PHASE_EVENTS[k].type == PERF_TYPE_HARDWARE;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+	//	calling thread, any CPU
+	return (int) syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC);
+}
+
+//	The calling thread's state, its events opened
+static PhaseThread* openThread(void)
+{
+	PhaseThread* self = (PhaseThread*) calloc(1, sizeof(PhaseThread));
+	self->groupFd = -1;
+	self->current = -1;
+	int numWanted = 0;
+	for (int k=0; k<NUM_PHASE_EVENTS; k++)
+	{
+		self->fd[k] = -1;
+		self->position[k] = -1;
+		if (phaseEventError[k] != 0)
+			continue;
+		numWanted++;
+		int fd = openEvent(k, self->groupFd);
+		if (fd < 0)
+			continue;
+		if (self->groupFd < 0)
+			self->groupFd = fd;
+		self->fd[k] = fd;
+		self->position[k] = self->numOpen++;
+	}
+
+	pthread_mutex_lock(&phase_list_lock);
+	self->next = phaseThreads;
+	phaseThreads = self;
+	phaseNumThreads++;
+	if (self->numOpen < numWanted)
+		phaseNumDegraded++;
+	pthread_mutex_unlock(&phase_list_lock);
+	return self;
+}
+
+/** Current value of each event: one read of the group, and the fallbacks
+ *	for context switches (getrusage) and CPU time (thread clock)
+ */
+static void readEvents(PhaseThread* self, uint64_t values[NUM_PHASE_EVENTS])
+{
+	uint64_t group[1 + NUM_PHASE_EVENTS];
+	bool groupRead = self->groupFd >= 0 &&
+					 read(self->groupFd, group, sizeof(uint64_t) * (1 + self->numOpen)) > 0;
+	for (int k=0; k<NUM_PHASE_EVENTS; k++)
+		values[k] = groupRead && self->position[k] >= 0 ? group[1 + self->position[k]] : 0;
+
+	if (self->position[CONTEXT_SWITCHES_EVENT] < 0)
+	{
+		struct rusage usage;
+		getrusage(RUSAGE_THREAD, &usage);
+		values[CONTEXT_SWITCHES_EVENT] = usage.ru_nvcsw + usage.ru_nivcsw;
+	}
+	if (self->position[TASK_CLOCK_EVENT] < 0)
+	{
+		struct timespec cpu;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+		values[TASK_CLOCK_EVENT] = (uint64_t) cpu.tv_sec * 1000000000ULL + cpu.tv_nsec;
+	}
+}
+
+//	Adds to a total that the report may read meanwhile (single writer)
+static inline void addTo(uint64_t* total, uint64_t amount)
+{
+	__atomic_store_n(total, *total + amount, __ATOMIC_RELAXED);
+}
+
+//	Charges what was counted since the last change to the current phase
+static void changePhase(PhaseThread* self, int phase)
+{
+	uint64_t values[NUM_PHASE_EVENTS];
+	readEvents(self, values);
+	uint64_t now = nowNs();
+	if (self->current >= 0)
+	{
+		PhaseTotals* totals = self->totals + self->current;
+		addTo(&totals->wallNs, now - self->lastNs);
+		for (int k=0; k<NUM_PHASE_EVENTS; k++)
+			addTo(totals->value + k, values[k] - self->last[k]);
+	}
+	if (phase >= 0)
+		addTo(&self->totals[phase].entries, 1);
+	self->current = phase;
+	self->lastNs = now;
+	memcpy(self->last, values, sizeof(values));
+}
+
+//	Whether some thread counted an event
+static bool eventCounted(int k)
+{
+	return phaseEventError[k] == 0 || k == CONTEXT_SWITCHES_EVENT || k == TASK_CLOCK_EVENT;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void phaseCountersInitialize(void)
+{
+	char missing[512] = "";
+	for (int k=0; k<NUM_PHASE_EVENTS; k++)
+	{
+		int fd = openEvent(k, -1);
+		phaseEventError[k] = fd < 0 ? errno : 0;
+		if (fd >= 0)
+			close(fd);
+		else
+		{
+			size_t length = strlen(missing);
+			snprintf(missing + length, sizeof(missing) - length, "%s%s (%s)", length > 0 ? ", " : "",
+					 PHASE_EVENTS[k].name, strerror(phaseEventError[k]));
+		}
+	}
+	if (missing[0] != 0)
+		fprintf(stderr, "phase counters: not counted: %s\n", missing);
+	phaseCountingOn = true;
+}
+
+void phaseSwitch(SimPhase phase)
+{
+	if (phaseSelf == NULL)
+		phaseSelf = openThread();
+	changePhase(phaseSelf, phase);
+}
+
+void phaseLeaveAll(void)
+{
+	if (phaseSelf != NULL)
+		changePhase(phaseSelf, -1);
+}
+
+void phaseThreadEnd(void)
+{
+	if (phaseSelf == NULL)
+		return;
+	changePhase(phaseSelf, -1);
+	for (int k=0; k<NUM_PHASE_EVENTS; k++)
+		if (phaseSelf->fd[k] >= 0)
+			close(phaseSelf->fd[k]);
+	phaseSelf = NULL;
+}
+
+void phasePrintReport(FILE* out)
+{
+	PhaseTotals totals[NUM_SIM_PHASES];
+	memset(totals, 0, sizeof(totals));
+	pthread_mutex_lock(&phase_list_lock);
+	for (PhaseThread* thread=phaseThreads; thread != NULL; thread=thread->next)
+		for (int p=0; p<NUM_SIM_PHASES; p++)
+		{
+			const PhaseTotals* mine = thread->totals + p;
+			totals[p].entries += __atomic_load_n(&mine->entries, __ATOMIC_RELAXED);
+			totals[p].wallNs += __atomic_load_n(&mine->wallNs, __ATOMIC_RELAXED);
+			for (int k=0; k<NUM_PHASE_EVENTS; k++)
+				totals[p].value[k] += __atomic_load_n(mine->value + k, __ATOMIC_RELAXED);
+		}
+	int numThreads = phaseNumThreads, numDegraded = phaseNumDegraded;
+	pthread_mutex_unlock(&phase_list_lock);
+
+	fprintf(out, "Phase counters: %d threads", numThreads);
+	if (numDegraded > 0)
+		fprintf(out, " (%d with fewer events)", numDegraded);
+	fprintf(out, ", times in thread-ms, hardware counts in user space\n");
+	fprintf(out, "  %-10s %10s %10s %10s %9s %12s %12s %5s %10s %10s %10s\n", "phase", "entries", "wall", "cpu",
+			"ctx sw", "cycles", "instr", "IPC", "LLC miss", "br miss", "cyc/entry");
+	for (int p=0; p<NUM_SIM_PHASES; p++)
+	{
+		const PhaseTotals* t = totals + p;
+		if (t->entries == 0)
+			continue;
+		fprintf(out, "  %-10s %10lu %10.1f %10.1f %9lu", SIM_PHASE_NAME[p], (unsigned long) t->entries,
+				t->wallNs * 1e-6, t->value[TASK_CLOCK_EVENT] * 1e-6, (unsigned long) t->value[CONTEXT_SWITCHES_EVENT]);
+		//	the hardware columns, where they were counted
+		char column[32];
+		for (int k=CYCLES_EVENT; k<=BRANCH_MISSES_EVENT; k++)
+		{
+			if (eventCounted(k))
+				snprintf(column, sizeof(column), "%lu", (unsigned long) t->value[k]);
+			else
+				strcpy(column, "-");
+			fprintf(out, k <= INSTRUCTIONS_EVENT ? " %12s" : " %10s", column);
+			//	IPC right after the instructions
+			if (k == INSTRUCTIONS_EVENT)
+			{
+				if (eventCounted(CYCLES_EVENT) && eventCounted(INSTRUCTIONS_EVENT) && t->value[CYCLES_EVENT] > 0)
+					fprintf(out, " %5.2f", (double) t->value[INSTRUCTIONS_EVENT] / t->value[CYCLES_EVENT]);
+				else
+					fprintf(out, " %5s", "-");
+			}
+		}
+		if (eventCounted(CYCLES_EVENT))
+			fprintf(out, " %10.0f\n", (double) t->value[CYCLES_EVENT] / t->entries);
+		else
+			fprintf(out, " %10s\n", "-");
+	}
+}
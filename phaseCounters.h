@@ -0,0 +1,83 @@
+//
+//  phaseCounters.h
+//  GL threads
+//
+//  Performance counters per phase of the simulation.  Each thread that
+//	enters a phase opens, on first use, a group of perf events counting
+//	itself only (user space: cycles, instructions, last-level cache misses,
+//	branch misses, plus context switches and CPU time).  At every phase
+//	change the group is read once and the difference charged to the phase
+//	being left, along with the wall-clock time.  Whatever cannot be opened
+//	(no perf events in a container, hardware counters hidden by a VM, out
+//	of file descriptors) is left out: the report shows the columns that
+//	were counted, and falls back to getrusage for context switches.
+//
+//	Reading the group is a system call per phase change, so counting is
+//	only for diagnosis runs (-phasecounters); when it is off, entering a
+//	phase is a test of a global flag.
+//
+
+#ifndef PHASE_COUNTERS_H
+#define PHASE_COUNTERS_H
+
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+typedef enum SimPhase {
+								INK_PHASE = 0,
+								PAINT_PHASE,
+								DIRECTION_PHASE,
+								WAIT_PHASE,
+								RENDER_PHASE,
+								//
+								NUM_SIM_PHASES
+} SimPhase;
+
+//	set by phaseCountersInitialize
+extern bool phaseCountingOn;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Turns counting on, and finds out which events this system can count
+ *	(the reason for any that cannot is printed once, on stderr)
+ */
+void phaseCountersInitialize(void);
+
+/** Charges the calling thread's counters since its last phase change to
+ *	the phase it was in, and starts counting for another
+ *  @param phase    phase entered
+ */
+void phaseSwitch(SimPhase phase);
+
+/** Same, leaving the current phase for none (time not charged)
+ */
+void phaseLeaveAll(void);
+
+/** Closes the calling thread's events (what they counted stays in the
+ *	report).  Call before a counted thread exits.
+ */
+void phaseThreadEnd(void);
+
+/** Prints a table of the totals per phase, all threads together
+ *  @param out      output stream
+ */
+void phasePrintReport(FILE* out);
+
+inline void phaseEnter(SimPhase phase)
+{
+	if (phaseCountingOn)
+		phaseSwitch(phase);
+}
+
+inline void phaseLeave(void)
+{
+	if (phaseCountingOn)
+		phaseLeaveAll();
+}
+
+#endif // PHASE_COUNTERS_H
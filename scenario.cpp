@@ -0,0 +1,265 @@
+//
+//  scenario.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include <pthread.h>
+//
+#include "scenario.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+/** One action of the scenario
+ *  @var time       seconds from the start of the run
+ *  @var type       what to do
+ *  @var channel    tank of ink actions (-1: all three)
+ *  @var value      amount, sleep time or count
+ *  @var line       line of the file
+ *  @var latenessMs how late the action ran
+ *  @var effect     what the handler returned
+ */
+typedef struct ScenarioAction {
+	double time;
+	ScenarioActionType type;
+	int channel;
+	int value;
+	int line;
+	double latenessMs;
+	int effect;
+} ScenarioAction;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+const char* SCENARIO_ACTION_NAME[NUM_SCENARIO_ACTIONS] = {"ink", "drain", "producers", "producers faster",
+														  "producers slower", "spawn", "reset", "end"};
+const char* SCENARIO_CHANNEL_NAME[3] = {"red", "green", "blue"};
+
+char scenarioPath[256] = "";
+vector<ScenarioAction> scenarioActions;
+ScenarioHandlers scenarioHandlers;
+struct timespec scenarioStartTime;
+//	actions run so far (their lateness and effect are then final)
+atomic<int> scenarioNumRun(0);
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+//	Tank named by a word of the file: 0..2, -1 for all, -2 if unknown
+static int parseChannel(const char* word)
+{
+	if (strcmp(word, "all") == 0)
+		return -1;
+	for (int c=0; c<3; c++)
+		if (strcmp(word, SCENARIO_CHANNEL_NAME[c]) == 0)
+			return c;
+	return -2;
+}
+
+/** Parses one line (comment already stripped)
+ *  @return false if the line has an error
+ */
+static bool parseLine(char* text, int line, ScenarioAction* action)
+{
+	char words[4][64];
+	int numWords = sscanf(text, "%63s %63s %63s %63s", words[0], words[1], words[2], words[3]);
+	char* end;
+	action->time = strtod(words[0], &end);
+	if (*end != 0 || action->time < 0)
+		return false;
+	action->line = line;
+	action->channel = -1;
+	action->value = 0;
+	action->latenessMs = 0.;
+	action->effect = 0;
+
+	if (numWords == 4 && (strcmp(words[1], "ink") == 0 || strcmp(words[1], "drain") == 0))
+	{
+		action->type = words[1][0] == 'i' ? INK_ACTION : DRAIN_ACTION;
+		action->channel = parseChannel(words[2]);
+		action->value = atoi(words[3]);
+		return action->channel >= -1 && action->value > 0;
+	}
+	if (numWords == 3 && strcmp(words[1], "producers") == 0)
+	{
+		if (strcmp(words[2], "faster") == 0)
+			action->type = PRODUCER_FASTER_ACTION;
+		else if (strcmp(words[2], "slower") == 0)
+			action->type = PRODUCER_SLOWER_ACTION;
+		else
+		{
+			action->type = PRODUCER_SLEEP_ACTION;
+			action->value = atoi(words[2]);
+			return action->value > 0;
+		}
+		return true;
+	}
+	if (numWords == 3 && strcmp(words[1], "spawn") == 0)
+	{
+		action->type = SPAWN_ACTION;
+		action->value = atoi(words[2]);
+		return action->value > 0;
+	}
+	if (numWords == 2 && strcmp(words[1], "reset") == 0)
+	{
+		action->type = RESET_ACTION;
+		return true;
+	}
+	if (numWords == 2 && strcmp(words[1], "end") == 0)
+	{
+		action->type = END_ACTION;
+		return true;
+	}
+	return false;
+}
+
+static int runAction(const ScenarioAction* action)
+{
+	const ScenarioHandlers* h = &scenarioHandlers;
+	int effect = 0;
+	switch (action->type)
+	{
+		case INK_ACTION:
+		case DRAIN_ACTION:
+			for (int c=0; c<3; c++)
+				if (action->channel < 0 || action->channel == c)
+					effect += action->type == INK_ACTION ? h->injectInk(c, action->value) : h->drainInk(c, action->value);
+			break;
+		case PRODUCER_SLEEP_ACTION:	effect = h->setProducerSleep(action->value);	break;
+		case PRODUCER_FASTER_ACTION:	effect = h->speedupProducers();					break;
+		case PRODUCER_SLOWER_ACTION:	effect = h->slowdownProducers();				break;
+		case SPAWN_ACTION:			effect = h->spawnBurst(action->value);			break;
+		case RESET_ACTION:			effect = h->resetGrid();						break;
+		default:					break;
+	}
+	return effect;
+}
+
+//	Runs the actions in order, each at its time
+static void* scenarioThread(void* data)
+{
+	for (size_t k=0; k<scenarioActions.size(); k++)
+	{
+		ScenarioAction* action = &scenarioActions[k];
+		struct timespec due = scenarioStartTime;
+		long long dueNs = (long long) due.tv_nsec + (long long) (action->time * 1e9);
+		due.tv_sec += dueNs / 1000000000LL;
+		due.tv_nsec = dueNs % 1000000000LL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) != 0)
+			;
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		action->latenessMs = ((now.tv_sec - due.tv_sec) + (now.tv_nsec - due.tv_nsec) * 1e-9) * 1e3;
+		//	the run ends from the handler: the action is reported first
+		if (action->type == END_ACTION)
+		{
+			scenarioNumRun.store(k+1, memory_order_release);
+			scenarioHandlers.endRun();
+		}
+		action->effect = runAction(action);
+		scenarioNumRun.store(k+1, memory_order_release);
+	}
+	return NULL;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+bool scenarioLoad(const char* path)
+{
+	FILE* file = fopen(path, "r");
+	if (file == NULL)
+	{
+		perror(path);
+		return false;
+	}
+	snprintf(scenarioPath, sizeof(scenarioPath), "%s", path);
+
+	char text[256];
+	int line = 0, numErrors = 0;
+	while (fgets(text, sizeof(text), file) != NULL)
+	{
+		line++;
+		char* comment = strchr(text, '#');
+		if (comment != NULL)
+			*comment = 0;
+		char first[2];
+		if (sscanf(text, "%1s", first) != 1)
+			continue;
+		ScenarioAction action;
+		if (!parseLine(text, line, &action))
+		{
+			fprintf(stderr, "%s:%d: bad action: %s", path, line, text);
+			if (strchr(text, '\n') == NULL)
+				fputc('\n', stderr);
+			numErrors++;
+		}
+		else
+			scenarioActions.push_back(action);
+	}
+	fclose(file);
+
+	//	in time order, actions at the same time in file order
+	stable_sort(scenarioActions.begin(), scenarioActions.end(),
+				[](const ScenarioAction& a, const ScenarioAction& b) { return a.time < b.time; });
+	return numErrors == 0;
+}
+
+bool scenarioHasAction(ScenarioActionType type)
+{
+	for (const ScenarioAction& action : scenarioActions)
+		if (action.type == type)
+			return true;
+	return false;
+}
+
+void scenarioStart(const ScenarioHandlers* handlers)
+{
+	scenarioHandlers = *handlers;
+	clock_gettime(CLOCK_MONOTONIC, &scenarioStartTime);
+	pthread_t threadID;
+	if (pthread_create(&threadID, nullptr, scenarioThread, NULL) != 0)
+	{
+		fprintf(stderr, "could not create the scenario thread\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void scenarioPrintReport(FILE* out)
+{
+	int numRun = scenarioNumRun.load(memory_order_acquire);
+	double maxLateness = 0.;
+	for (int k=0; k<numRun; k++)
+		maxLateness = max(maxLateness, scenarioActions[k].latenessMs);
+	fprintf(out, "Scenario %s: %d of %zu actions run, max lateness %.2f ms\n", scenarioPath, numRun,
+			scenarioActions.size(), maxLateness);
+	for (int k=0; k<numRun; k++)
+	{
+		const ScenarioAction* action = &scenarioActions[k];
+		char what[64];
+		if (action->type == INK_ACTION || action->type == DRAIN_ACTION)
+			snprintf(what, sizeof(what), "%s %s %d", SCENARIO_ACTION_NAME[action->type],
+					 action->channel < 0 ? "all" : SCENARIO_CHANNEL_NAME[action->channel], action->value);
+		else if (action->type == PRODUCER_SLEEP_ACTION || action->type == SPAWN_ACTION)
+			snprintf(what, sizeof(what), "%s %d", SCENARIO_ACTION_NAME[action->type], action->value);
+		else
+			snprintf(what, sizeof(what), "%s", SCENARIO_ACTION_NAME[action->type]);
+		fprintf(out, "  %8.3f s %+7.2f ms  line %-4d %-24s -> %d\n", action->time, action->latenessMs, action->line,
+				what, action->effect);
+	}
+}
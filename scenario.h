@@ -0,0 +1,92 @@
+//
+//  scenario.h
+//  GL threads
+//
+//  Scripted workloads.  A scenario file lists timestamped actions, one per
+//	line, which a scenario thread runs at their time (counted from the
+//	start of the run, with absolute-deadline sleeps so that lateness never
+//	accumulates).  The same file replays the same load spikes at the same
+//	times, whatever the engine running the travelers.
+//
+//	Format ('#' starts a comment; times in seconds, in any order):
+//		<time>  ink <red|green|blue|all> <amount>	refill a tank (up to capacity)
+//		<time>  drain <red|green|blue|all> <amount>	empty a tank (down to 0)
+//		<time>  producers <sleep us>				set the producers' sleep time
+//		<time>  producers faster|slower				as the '.' and ',' keys
+//		<time>  spawn <count>						respawn dead travelers at once
+//		<time>  reset								clear the grid's trails
+//		<time>  end									end the run
+//
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+typedef enum ScenarioActionType {
+								INK_ACTION = 0,
+								DRAIN_ACTION,
+								PRODUCER_SLEEP_ACTION,
+								PRODUCER_FASTER_ACTION,
+								PRODUCER_SLOWER_ACTION,
+								SPAWN_ACTION,
+								RESET_ACTION,
+								END_ACTION,
+								//
+								NUM_SCENARIO_ACTIONS
+} ScenarioActionType;
+
+/** What the simulation does for each action.  Each handler returns the
+ *	effect the action actually had (ink moved, travelers spawned...), for
+ *	the report.
+ *  @var injectInk          adds up to amount to a tank (channel: TravelerType)
+ *  @var drainInk           takes up to amount from a tank
+ *  @var setProducerSleep   sets the producers' sleep time (in microseconds)
+ *  @var speedupProducers   shortens the producers' sleep time
+ *  @var slowdownProducers  lengthens the producers' sleep time
+ *  @var spawnBurst         respawns up to count dead travelers
+ *  @var resetGrid          clears the grid
+ *  @var endRun             ends the run (does not return)
+ */
+typedef struct ScenarioHandlers {
+	int (*injectInk)(int channel, int amount);
+	int (*drainInk)(int channel, int amount);
+	int (*setProducerSleep)(int sleepTime);
+	int (*speedupProducers)(void);
+	int (*slowdownProducers)(void);
+	int (*spawnBurst)(int count);
+	int (*resetGrid)(void);
+	int (*endRun)(void);
+} ScenarioHandlers;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Reads a scenario file.  Errors are printed with their line number.
+ *  @param path     the file
+ *  @return false if the file could not be read or has errors
+ */
+bool scenarioLoad(const char* path);
+
+/** Whether the scenario loaded has actions of a kind
+ *  @param type     kind of action
+ *  @return true if there is at least one
+ */
+bool scenarioHasAction(ScenarioActionType type);
+
+/** Starts the scenario thread: times count from this call
+ *  @param handlers what to do for each action (copied)
+ */
+void scenarioStart(const ScenarioHandlers* handlers);
+
+/** Prints the actions run so far, with their lateness and effect
+ *  @param out      output stream
+ */
+void scenarioPrintReport(FILE* out);
+
+#endif // SCENARIO_H
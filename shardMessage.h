@@ -0,0 +1,87 @@
+//
+//  shardMessage.h
+//  GL threads
+//
+//  Messages exchanged between the shards of a multi-process simulation and
+//	the transport interface that carries them.  Messages are fixed-size,
+//	plain data with explicit-width fields, so that they can be copied
+//	byte for byte into a shared-memory ring today and into a socket later.
+//
+
+#ifndef SHARD_MESSAGE_H
+#define SHARD_MESSAGE_H
+
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+//	What a message carries
+typedef enum ShardMessageKind {
+								//	coordinator -> shard, shard -> shard:
+								//	a traveler now lives in the destination's band
+								MSG_TRAVELER = 1,
+								//	shard -> coordinator: a traveler reached a corner
+								MSG_TRAVELER_DONE,
+								//	shard -> coordinator: asks for `amount` units of ink `color`
+								MSG_INK_REQUEST,
+								//	coordinator -> shard: grants `amount` units of ink `color`
+								MSG_INK_GRANT,
+								//	coordinator -> shard: stop and report
+								MSG_STOP,
+								//	shard -> coordinator: final counters
+								MSG_STATS
+} ShardMessageKind;
+
+/** Shard message (32 bytes)
+ *  @var kind       a ShardMessageKind
+ *  @var src        endpoint that sent the message
+ *  @var dst        endpoint the message is for
+ *  @var color      traveler type / ink color
+ *  @var dir        traveler direction
+ *  @var travelerId index of the traveler
+ *  @var row        traveler row
+ *  @var col        traveler col
+ *  @var amount     ink amount (grant/request) or cells left to travel (traveler)
+ *  @var value      counter payload (stats: cells moved)
+ */
+typedef struct ShardMessage {
+	uint16_t kind;
+	uint16_t src;
+	uint16_t dst;
+	uint8_t color;
+	uint8_t dir;
+	uint32_t travelerId;
+	int32_t row;
+	int32_t col;
+	uint32_t amount;
+	uint64_t value;
+} ShardMessage;
+
+static_assert(sizeof(ShardMessage) == 32, "ShardMessage must stay 32 bytes");
+
+//	A transport moves messages between numbered endpoints.  Shards are
+//	endpoints 0 to K-1, the coordinator is endpoint K.  The shard logic only
+//	sees this interface, so a network transport can replace shared memory.
+class ShardTransport {
+	public:
+		virtual ~ShardTransport() {}
+
+		/** Sends a message to msg.dst without blocking
+		 *  @param msg      the message
+		 *  @return false if the channel is full (try again later)
+		 */
+		virtual bool send(const ShardMessage& msg) = 0;
+
+		/** Receives one message addressed to this endpoint, if any
+		 *  @param msg      receives the message
+		 *  @return true if a message was received
+		 */
+		virtual bool receive(ShardMessage& msg) = 0;
+
+		virtual int endpoint(void) const = 0;
+		virtual int numEndpoints(void) const = 0;
+};
+
+#endif // SHARD_MESSAGE_H
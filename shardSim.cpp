@@ -0,0 +1,585 @@
+//
+//  shardSim.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+//
+#include "gl_frontEnd.h"
+#include "shmRing.h"
+#include "shardSim.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//	Simulation functions and settings (main.cpp)
+//---------------------------------------------------------------------------
+
+extern int** grid;
+extern int NUM_ROWS, NUM_COLS;
+extern int MAX_NUM_TRAVELER_THREADS;
+extern int travelerSleepTime;
+
+bool acquireRedInk(int theRed);
+bool acquireGreenInk(int theGreen);
+bool acquireBlueInk(int theBlue);
+TravelDirection generateDirection(int col, int row, TravelDirection dir);
+unsigned newDistance(int col, int row, TravelDirection dir);
+void paintCell(int row, int col, TravelerType type);
+void startProducerThreads(void);
+
+//---------------------------------------------------------------------------
+//  Data types and constants
+//---------------------------------------------------------------------------
+
+//	slots per ring
+const unsigned int SHARD_RING_CAPACITY = 1024;
+//	units of ink a shard asks for at once
+const unsigned int INK_BATCH = 8;
+//	how long the coordinator waits for the shards' final report
+const int STATS_TIMEOUT_MS = 2000;
+//	pause of an idle loop (in microseconds)
+const int IDLE_SLEEP_TIME = 50;
+
+/** Traveler as seen by a shard
+ *  @var id         traveler index
+ *  @var type       type of traveler
+ *  @var row        row location of traveler
+ *  @var col        col location of traveler
+ *  @var dir        direction of traveler
+ *  @var remaining  cells left to travel in the current segment
+ */
+typedef struct ShardTraveler {
+	unsigned int id;
+	TravelerType type;
+	int row;
+	int col;
+	TravelDirection dir;
+	int remaining;
+} ShardTraveler;
+
+/** State of one shard process
+ *  @var shard          index of this shard (its endpoint)
+ *  @var numShards      number of shards (the coordinator's endpoint)
+ *  @var firstRow       first row of the band
+ *  @var endRow         one past the last row of the band
+ *  @var transport      message transport
+ *  @var travelers      travelers currently in the band
+ *  @var outbox         messages the transport couldn't take yet
+ *  @var ink            ink granted and not used yet, per color
+ *  @var inkRequested   a request is outstanding for that color
+ *  @var stopped        the coordinator asked to stop
+ *  @var moves          cells moved by this shard's travelers
+ *  @var handedOff      travelers sent to another shard
+ */
+typedef struct ShardState {
+	int shard;
+	int numShards;
+	int firstRow;
+	int endRow;
+	ShardTransport* transport;
+	vector<ShardTraveler> travelers;
+	vector<ShardMessage> outbox;
+	unsigned int ink[NUM_TRAV_TYPES];
+	bool inkRequested[NUM_TRAV_TYPES];
+	bool stopped;
+	unsigned long moves;
+	unsigned long handedOff;
+} ShardState;
+
+//	The coordinator's children and transport, for cleaning up on a fatal
+//	signal or an exit() before the shards are stopped (the signal handler
+//	can only use plain data)
+pid_t shardPids[MAX_SHARDS];
+volatile sig_atomic_t numShardPids = 0;
+char shardShmName[64] = "";
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static int firstRowOfShard(int shard, int numShards)
+{
+	return (int) (((long) shard * NUM_ROWS) / numShards);
+}
+
+static int shardOfRow(int row, int numShards)
+{
+	int shard = (int) (((long) row * numShards) / NUM_ROWS);
+	while (shard+1 < numShards && firstRowOfShard(shard+1, numShards) <= row)
+		shard++;
+	while (shard > 0 && firstRowOfShard(shard, numShards) > row)
+		shard--;
+	return shard;
+}
+
+static bool isCorner(int col, int row)
+{
+	return (col == 0 || col == NUM_COLS-1) && (row == 0 || row == NUM_ROWS-1);
+}
+
+static double elapsedSeconds(const struct timespec& start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+static ShardMessage makeMessage(ShardMessageKind kind, int src, int dst)
+{
+	ShardMessage msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.kind = kind;
+	msg.src = src;
+	msg.dst = dst;
+	return msg;
+}
+
+static ShardMessage travelerMessage(const ShardTraveler& t, int src, int dst)
+{
+	ShardMessage msg = makeMessage(MSG_TRAVELER, src, dst);
+	msg.travelerId = t.id;
+	msg.color = t.type;
+	msg.dir = t.dir;
+	msg.row = t.row;
+	msg.col = t.col;
+	msg.amount = t.remaining;
+	return msg;
+}
+
+/** Sends a message now if possible, queues it otherwise.  Message order is
+ *	preserved: nothing bypasses the outbox.
+ */
+static void postMessage(ShardState* state, const ShardMessage& msg)
+{
+	if (!state->outbox.empty() || !state->transport->send(msg))
+		state->outbox.push_back(msg);
+}
+
+static void flushOutbox(ShardState* state)
+{
+	size_t sent = 0;
+	while (sent < state->outbox.size() && state->transport->send(state->outbox[sent]))
+		sent++;
+	state->outbox.erase(state->outbox.begin(), state->outbox.begin() + sent);
+}
+
+static void handleShardMessage(ShardState* state, const ShardMessage& msg)
+{
+	switch (msg.kind)
+	{
+		case MSG_TRAVELER: {
+				ShardTraveler t;
+				t.id = msg.travelerId;
+				t.type = TravelerType(msg.color);
+				t.dir = TravelDirection(msg.dir);
+				t.row = msg.row;
+				t.col = msg.col;
+				t.remaining = msg.amount;
+				state->travelers.push_back(t);
+			}
+			break;
+		case MSG_INK_GRANT:
+			state->ink[msg.color] += msg.amount;
+			state->inkRequested[msg.color] = false;
+			break;
+		case MSG_STOP:
+			state->stopped = true;
+			break;
+		default:
+			break;
+	}
+}
+
+/** Moves each traveler of the band by one cell, as its thread would in the
+ *	threaded simulation
+ *  @return true if at least one traveler moved
+ */
+static bool stepTravelers(ShardState* state)
+{
+	bool progressed = false;
+	size_t k = 0;
+	while (k < state->travelers.size())
+	{
+		ShardTraveler& t = state->travelers[k];
+		if (state->ink[t.type] == 0)
+		{
+			if (!state->inkRequested[t.type])
+			{
+				ShardMessage msg = makeMessage(MSG_INK_REQUEST, state->shard, state->numShards);
+				msg.color = t.type;
+				msg.amount = INK_BATCH;
+				postMessage(state, msg);
+				state->inkRequested[t.type] = true;
+			}
+			k++;
+			continue;
+		}
+
+		state->ink[t.type]--;
+		switch (t.dir)
+		{
+			case NORTH:
+				t.row -= 1;
+				break;
+			case SOUTH:
+				t.row += 1;
+				break;
+			case WEST:
+				t.col -= 1;
+				break;
+			case EAST:
+				t.col += 1;
+				break;
+			default:
+				break;
+		}
+		paintCell(t.row, t.col, t.type);
+		state->moves++;
+		progressed = true;
+
+		bool gone = false;
+		if (--t.remaining == 0)
+		{
+			t.dir = generateDirection(t.col, t.row, t.dir);
+			if (isCorner(t.col, t.row))
+			{
+				ShardMessage msg = makeMessage(MSG_TRAVELER_DONE, state->shard, state->numShards);
+				msg.travelerId = t.id;
+				postMessage(state, msg);
+				gone = true;
+			}
+			else
+				t.remaining = newDistance(t.col, t.row, t.dir);
+		}
+		if (!gone && (t.row < state->firstRow || t.row >= state->endRow))
+		{
+			int owner = shardOfRow(t.row, state->numShards);
+			postMessage(state, travelerMessage(t, state->shard, owner));
+			state->handedOff++;
+			gone = true;
+		}
+
+		if (gone)
+		{
+			state->travelers[k] = state->travelers.back();
+			state->travelers.pop_back();
+		}
+		else
+			k++;
+	}
+	return progressed;
+}
+
+/** Kills and reaps the shards still running, and removes the transport's
+ *	name.  Only async-signal-safe calls: also run from the signal handler.
+ */
+static void killShards(void)
+{
+	int n = numShardPids;
+	numShardPids = 0;
+	for (int s=0; s<n; s++)
+		kill(shardPids[s], SIGKILL);
+	for (int s=0; s<n; s++)
+		waitpid(shardPids[s], NULL, 0);
+	if (n > 0)
+		ShmRingTransport::unlink(shardShmName);
+}
+
+static void killShardsAtExit(void)
+{
+	killShards();
+}
+
+//	Fatal signal in the coordinator: take the shards down, then die of it
+static void onFatalSignal(int sig)
+{
+	killShards();
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+/** Body of a shard process.  Never returns.
+ */
+static void runShard(int shard, int numShards, const char* shmName)
+{
+	ShardTransport* transport = ShmRingTransport::attach(shmName, shard);
+	if (transport == NULL)
+	{
+		fprintf(stderr, "shard %d could not attach to %s\n", shard, shmName);
+		_exit(EXIT_FAILURE);
+	}
+	srand((unsigned int) time(NULL) ^ ((unsigned int) getpid() << 8));
+
+	//	The shard has a private grid, of which it only paints its band
+	grid = (int**) malloc(NUM_ROWS * sizeof(int*));
+	int* cells = (int*) calloc(NUM_ROWS * NUM_COLS, sizeof(int));
+	for (int i=0; i<NUM_ROWS; i++)
+		grid[i] = cells + i*NUM_COLS;
+	for (int k=0; k<NUM_ROWS*NUM_COLS; k++)
+		cells[k] = 0xFF000000;
+
+	ShardState state;
+	state.shard = shard;
+	state.numShards = numShards;
+	state.firstRow = firstRowOfShard(shard, numShards);
+	state.endRow = firstRowOfShard(shard+1, numShards);
+	state.transport = transport;
+	for (int c=0; c<NUM_TRAV_TYPES; c++)
+	{
+		state.ink[c] = 0;
+		state.inkRequested[c] = false;
+	}
+	state.stopped = false;
+	state.moves = 0;
+	state.handedOff = 0;
+
+	while (!state.stopped)
+	{
+		ShardMessage msg;
+		while (transport->receive(msg))
+			handleShardMessage(&state, msg);
+		flushOutbox(&state);
+
+		bool progressed = stepTravelers(&state);
+		if (travelerSleepTime > 0)
+			usleep(travelerSleepTime);
+		else if (!progressed)
+			usleep(IDLE_SLEEP_TIME);
+	}
+
+	ShardMessage stats = makeMessage(MSG_STATS, shard, numShards);
+	stats.value = state.moves;
+	stats.amount = (uint32_t) state.handedOff;
+	postMessage(&state, stats);
+	while (!state.outbox.empty())
+	{
+		flushOutbox(&state);
+		usleep(IDLE_SLEEP_TIME);
+	}
+
+	delete transport;
+	_exit(0);
+}
+
+static bool takeInk(int color)
+{
+	switch (color)
+	{
+		case RED_TRAV:
+			return acquireRedInk(1);
+		case GREEN_TRAV:
+			return acquireGreenInk(1);
+		case BLUE_TRAV:
+			return acquireBlueInk(1);
+		default:
+			return false;
+	}
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void runShardedSimulation(int numShards, int seconds)
+{
+	char shmName[64];
+	sprintf(shmName, "/travel_shards_%d", (int) getpid());
+	const int coordinator = numShards;
+	ShmRingTransport* transport = ShmRingTransport::create(shmName, numShards+1,
+														   SHARD_RING_CAPACITY, coordinator);
+	if (transport == NULL)
+	{
+		fprintf(stderr, "could not create the shard transport %s\n", shmName);
+		exit(EXIT_FAILURE);
+	}
+
+	//	From here on, the shards and the transport's name are cleaned up
+	//	on every way out of the coordinator
+	snprintf(shardShmName, sizeof(shardShmName), "%s", shmName);
+	atexit(killShardsAtExit);
+	const int FATAL_SIGNALS[] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT};
+	for (int sig : FATAL_SIGNALS)
+		signal(sig, onFatalSignal);
+
+	//	Fork before any thread exists in this process
+	pid_t coordinatorPid = getpid();
+	vector<pid_t> pids(numShards);
+	for (int s=0; s<numShards; s++)
+	{
+		pids[s] = fork();
+		if (pids[s] == 0)
+		{
+			//	a shard dies with its coordinator, and leaves its siblings
+			//	to it
+			numShardPids = 0;
+			for (int sig : FATAL_SIGNALS)
+				signal(sig, SIG_DFL);
+#if defined(__linux__)
+			prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+			//	the coordinator may have died before prctl
+			if (getppid() != coordinatorPid)
+				_exit(EXIT_FAILURE);
+			runShard(s, numShards, shmName);
+		}
+		else if (pids[s] < 0)
+		{
+			perror("fork");
+			exit(EXIT_FAILURE);
+		}
+		shardPids[s] = pids[s];
+		numShardPids = s + 1;
+	}
+
+	srand((unsigned int) time(NULL));
+	startProducerThreads();
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	//	Seed the travelers the same way the threaded simulation does
+	int liveTravelers = 0;
+	for (int k=0; k<MAX_NUM_TRAVELER_THREADS; k++)
+	{
+		ShardTraveler t;
+		t.id = k;
+		t.type = TravelerType(rand() % NUM_TRAV_TYPES);
+		t.row = 1 + rand() % (NUM_ROWS-1);
+		t.col = 1 + rand() % (NUM_COLS-1);
+		t.dir = generateDirection(t.col, t.row, TravelDirection(rand() % NUM_TRAVEL_DIRECTIONS));
+		if (isCorner(t.col, t.row))
+			continue;
+		t.remaining = newDistance(t.col, t.row, t.dir);
+
+		ShardMessage msg = travelerMessage(t, coordinator, shardOfRow(t.row, numShards));
+		while (!transport->send(msg))
+			usleep(IDLE_SLEEP_TIME);
+		liveTravelers++;
+	}
+
+	//	Serve ink requests until time is up.  A request is granted whatever
+	//	is available, up to the amount asked for.
+	vector<unsigned int> requested(numShards * NUM_TRAV_TYPES, 0);
+	vector<unsigned int> toSend(numShards * NUM_TRAV_TYPES, 0);
+	unsigned long inkGrants = 0, inkGranted = 0;
+	while (elapsedSeconds(start) < seconds)
+	{
+		bool busy = false;
+		ShardMessage msg;
+		while (transport->receive(msg))
+		{
+			busy = true;
+			if (msg.kind == MSG_INK_REQUEST)
+				requested[msg.src * NUM_TRAV_TYPES + msg.color] = msg.amount;
+			else if (msg.kind == MSG_TRAVELER_DONE)
+				liveTravelers--;
+		}
+
+		for (int s=0; s<numShards; s++)
+			for (int c=0; c<NUM_TRAV_TYPES; c++)
+			{
+				int slot = s * NUM_TRAV_TYPES + c;
+				if (requested[slot] > 0 && toSend[slot] == 0)
+				{
+					while (toSend[slot] < requested[slot] && takeInk(c))
+						toSend[slot]++;
+					if (toSend[slot] > 0)
+						requested[slot] = 0;
+				}
+				if (toSend[slot] > 0)
+				{
+					ShardMessage grant = makeMessage(MSG_INK_GRANT, coordinator, s);
+					grant.color = c;
+					grant.amount = toSend[slot];
+					if (transport->send(grant))
+					{
+						inkGrants++;
+						inkGranted += toSend[slot];
+						toSend[slot] = 0;
+						busy = true;
+					}
+				}
+			}
+
+		if (!busy)
+			usleep(IDLE_SLEEP_TIME);
+	}
+	double duration = elapsedSeconds(start);
+
+	//	Stop the shards and collect their counters
+	for (int s=0; s<numShards; s++)
+	{
+		ShardMessage stop = makeMessage(MSG_STOP, coordinator, s);
+		while (!transport->send(stop))
+		{
+			ShardMessage msg;
+			while (transport->receive(msg))
+				if (msg.kind == MSG_TRAVELER_DONE)
+					liveTravelers--;
+			usleep(IDLE_SLEEP_TIME);
+		}
+	}
+
+	vector<unsigned long> moves(numShards, 0), handedOff(numShards, 0);
+	int reported = 0;
+	struct timespec stopTime;
+	clock_gettime(CLOCK_MONOTONIC, &stopTime);
+	while (reported < numShards && elapsedSeconds(stopTime) * 1000 < STATS_TIMEOUT_MS)
+	{
+		ShardMessage msg;
+		if (transport->receive(msg))
+		{
+			if (msg.kind == MSG_STATS)
+			{
+				moves[msg.src] = msg.value;
+				handedOff[msg.src] = msg.amount;
+				reported++;
+			}
+			else if (msg.kind == MSG_TRAVELER_DONE)
+				liveTravelers--;
+		}
+		else
+			usleep(IDLE_SLEEP_TIME);
+	}
+	for (int s=0; s<numShards; s++)
+	{
+		if (reported < numShards)
+			kill(pids[s], SIGKILL);
+		waitpid(pids[s], NULL, 0);
+	}
+	numShardPids = 0;
+	ShmRingTransport::unlink(shmName);
+	delete transport;
+
+	unsigned long totalMoves = 0, totalHandedOff = 0;
+	for (int s=0; s<numShards; s++)
+	{
+		totalMoves += moves[s];
+		totalHandedOff += handedOff[s];
+	}
+	printf("Sharded run (%d shard%s): %lu cells moved in %.1f s (%.0f cells/s)\n",
+			numShards, numShards > 1 ? "s" : "", totalMoves, duration, totalMoves / duration);
+	printf("  %-6s %-12s %12s %12s\n", "shard", "rows", "cells moved", "handed off");
+	for (int s=0; s<numShards; s++)
+	{
+		char rows[32];
+		sprintf(rows, "%d-%d", firstRowOfShard(s, numShards), firstRowOfShard(s+1, numShards) - 1);
+		printf("  %-6d %-12s %12lu %12lu\n", s, rows, moves[s], handedOff[s]);
+	}
+	printf("  travelers handed off: %lu, ink grants: %lu (%lu units), live travelers: %d\n",
+			totalHandedOff, inkGrants, inkGranted, liveTravelers);
+	if (reported < numShards)
+		printf("  %d shard(s) did not report and were killed\n", numShards - reported);
+}
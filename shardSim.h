@@ -0,0 +1,34 @@
+//
+//  shardSim.h
+//  GL threads
+//
+//  Multi-process sharded simulation.  The grid is split into K horizontal
+//	bands, each simulated by its own shard process.  This process becomes
+//	the coordinator: it owns the ink tanks (and their producers), hands
+//	out ink to the shards in batches, and seeds the travelers.  Travelers
+//	that leave a shard's band are handed to the shard that owns their new
+//	row.  All communication goes through a ShardTransport.
+//
+
+#ifndef SHARD_SIM_H
+#define SHARD_SIM_H
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+//	most shard processes of a run
+const int MAX_SHARDS = 256;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Launches numShards shard processes, coordinates them for the given time,
+ *	then stops them and prints the throughput report
+ *  @param numShards    number of shard processes (at most MAX_SHARDS)
+ *  @param seconds      duration of the run
+ */
+void runShardedSimulation(int numShards, int seconds);
+
+#endif // SHARD_SIM_H
@@ -0,0 +1,183 @@
+//
+//  shmRing.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+//
+#include "shmRing.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Segment layout:	a header, then numEndpoints x numEndpoints rings.  The
+//	ring carrying messages from src to dst is at index src*numEndpoints+dst.
+//---------------------------------------------------------------------------
+
+const uint32_t SHM_RING_MAGIC = 0x52494E47;	//	"RING"
+
+typedef struct alignas(64) ShmSegmentHeader {
+	uint32_t magic;
+	uint32_t numEndpoints;
+	uint32_t capacity;
+	uint64_t ringBytes;
+	uint64_t totalBytes;
+} ShmSegmentHeader;
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+ShmRingTransport* ShmRingTransport::create(const char* name, int numEndpoints,
+											unsigned int capacity, int endpoint)
+{
+	uint32_t cap = 1;
+	while (cap < capacity)
+		cap <<= 1;
+
+	size_t ringBytes = offsetof(ShmRing, slots) + cap * sizeof(ShardMessage);
+	ringBytes = (ringBytes + 63) & ~((size_t) 63);
+	size_t totalBytes = sizeof(ShmSegmentHeader) + numEndpoints * numEndpoints * ringBytes;
+
+	shm_unlink(name);
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0)
+	{
+		perror("shm_open");
+		return NULL;
+	}
+	if (ftruncate(fd, (off_t) totalBytes) != 0)
+	{
+		perror("ftruncate");
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+	void* base = mmap(NULL, totalBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		perror("mmap");
+		shm_unlink(name);
+		return NULL;
+	}
+
+	ShmSegmentHeader* header = static_cast<ShmSegmentHeader*>(base);
+	header->numEndpoints = numEndpoints;
+	header->capacity = cap;
+	header->ringBytes = ringBytes;
+	header->totalBytes = totalBytes;
+
+	ShmRingTransport* transport = new ShmRingTransport(base, totalBytes, endpoint);
+	for (int src=0; src<numEndpoints; src++)
+		for (int dst=0; dst<numEndpoints; dst++)
+		{
+			transport->ring(src, dst)->head.store(0);
+			transport->ring(src, dst)->tail.store(0);
+		}
+
+	//	publish the magic last: attach() refuses a half-built segment
+	atomic_thread_fence(memory_order_release);
+	header->magic = SHM_RING_MAGIC;
+	return transport;
+}
+
+ShmRingTransport* ShmRingTransport::attach(const char* name, int endpoint)
+{
+	int fd = shm_open(name, O_RDWR, 0600);
+	if (fd < 0)
+	{
+		perror("shm_open");
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ShmSegmentHeader))
+	{
+		close(fd);
+		return NULL;
+	}
+	void* base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		perror("mmap");
+		return NULL;
+	}
+
+	ShmSegmentHeader* header = static_cast<ShmSegmentHeader*>(base);
+	if (header->magic != SHM_RING_MAGIC || header->totalBytes != (uint64_t) st.st_size ||
+		endpoint < 0 || endpoint >= (int) header->numEndpoints)
+	{
+		munmap(base, st.st_size);
+		return NULL;
+	}
+	atomic_thread_fence(memory_order_acquire);
+	return new ShmRingTransport(base, st.st_size, endpoint);
+}
+
+void ShmRingTransport::unlink(const char* name)
+{
+	shm_unlink(name);
+}
+
+ShmRingTransport::ShmRingTransport(void* theBase, size_t theLength, int endpoint)
+	:	base(theBase),
+		length(theLength),
+		myEndpoint(endpoint),
+		nextSource(0)
+{
+	ShmSegmentHeader* header = static_cast<ShmSegmentHeader*>(base);
+	nEndpoints = header->numEndpoints;
+	capacity = header->capacity;
+	ringBytes = header->ringBytes;
+}
+
+ShmRingTransport::~ShmRingTransport()
+{
+	munmap(base, length);
+}
+
+ShmRing* ShmRingTransport::ring(int src, int dst) const
+{
+	char* rings = static_cast<char*>(base) + sizeof(ShmSegmentHeader);
+	return reinterpret_cast<ShmRing*>(rings + (src * nEndpoints + dst) * ringBytes);
+}
+
+bool ShmRingTransport::send(const ShardMessage& msg)
+{
+	if (msg.dst >= nEndpoints)
+		return false;
+
+	ShmRing* r = ring(myEndpoint, msg.dst);
+	uint32_t tail = r->tail.load(memory_order_relaxed);
+	if (tail - r->head.load(memory_order_acquire) == capacity)
+		return false;
+
+	r->slots[tail & (capacity - 1)] = msg;
+	r->tail.store(tail + 1, memory_order_release);
+	return true;
+}
+
+bool ShmRingTransport::receive(ShardMessage& msg)
+{
+	for (int k=0; k<nEndpoints; k++)
+	{
+		int src = (nextSource + k) % nEndpoints;
+		ShmRing* r = ring(src, myEndpoint);
+		uint32_t head = r->head.load(memory_order_relaxed);
+		if (head != r->tail.load(memory_order_acquire))
+		{
+			msg = r->slots[head & (capacity - 1)];
+			r->head.store(head + 1, memory_order_release);
+			nextSource = (src + 1) % nEndpoints;
+			return true;
+		}
+	}
+	return false;
+}
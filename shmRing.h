@@ -0,0 +1,77 @@
+//
+//  shmRing.h
+//  GL threads
+//
+//  Single-producer/single-consumer rings of ShardMessage in a named POSIX
+//	shared-memory segment, and the ShardTransport built on them: one ring
+//	per ordered pair of endpoints, so that every ring has exactly one
+//	writer and one reader.
+//
+
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+//
+#include "shardMessage.h"
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+//	Ring header.  head is only written by the consumer, tail by the producer;
+//	they live on separate cache lines.  The slots follow the header.
+typedef struct ShmRing {
+	alignas(64) std::atomic<uint32_t> head;
+	alignas(64) std::atomic<uint32_t> tail;
+	alignas(64) ShardMessage slots[1];
+} ShmRing;
+
+class ShmRingTransport : public ShardTransport {
+	public:
+		/** Creates (coordinator side) the named segment holding all the rings
+		 *  @param name         shm name, starting with '/'
+		 *  @param numEndpoints number of endpoints (shards + coordinator)
+		 *  @param capacity     slots per ring, rounded up to a power of 2
+		 *  @param endpoint     endpoint of the creator
+		 *  @return the transport, or NULL on failure
+		 */
+		static ShmRingTransport* create(const char* name, int numEndpoints,
+										unsigned int capacity, int endpoint);
+
+		/** Attaches (shard side) to a segment created by create()
+		 *  @param name         shm name used by the creator
+		 *  @param endpoint     endpoint of the caller
+		 *  @return the transport, or NULL on failure
+		 */
+		static ShmRingTransport* attach(const char* name, int endpoint);
+
+		/** Removes the segment's name (the mappings stay valid)
+		 *  @param name         shm name
+		 */
+		static void unlink(const char* name);
+
+		~ShmRingTransport();
+
+		bool send(const ShardMessage& msg);
+		bool receive(ShardMessage& msg);
+		int endpoint(void) const { return myEndpoint; }
+		int numEndpoints(void) const { return nEndpoints; }
+
+	private:
+		ShmRingTransport(void* base, size_t length, int endpoint);
+		ShmRing* ring(int src, int dst) const;
+
+		void* base;
+		size_t length;
+		int myEndpoint;
+		int nEndpoints;
+		uint32_t capacity;
+		size_t ringBytes;
+		//	next source polled by receive, for fairness
+		int nextSource;
+};
+
+#endif // SHM_RING_H
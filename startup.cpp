@@ -0,0 +1,177 @@
+//
+//  startup.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+//
+#include "startup.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+/** A range of startupParallelFor
+ *  @var first      first item
+ *  @var end        end of the range
+ *  @var body       work on the range
+ *  @var arg        argument of body
+ */
+typedef struct StartupRange {
+	long first;
+	long end;
+	void (*body)(long first, long end, void* arg);
+	void* arg;
+} StartupRange;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+const int MAX_STARTUP_STEPS = 16;
+
+struct timespec startupStartTime;
+const char* startupStepName[MAX_STARTUP_STEPS];
+double startupStepEnd[MAX_STARTUP_STEPS];
+int startupNumSteps = 0;
+//	seconds from startupBegin to the first move (negative: none yet)
+atomic<double> startupFirstStepTime(-1.);
+//	most threads used by a parallel step
+int startupNumWorkers = 1;
+
+uint8_t* arenaBase = NULL;
+size_t arenaCapacity = 0, arenaUsed = 0;
+int arenaNumBlocks = 0;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static double elapsed(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - startupStartTime.tv_sec) + (now.tv_nsec - startupStartTime.tv_nsec) * 1e-9;
+}
+
+static void* rangeThread(void* data)
+{
+	StartupRange* range = (StartupRange*) data;
+	range->body(range->first, range->end, range->arg);
+	return NULL;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void startupBegin(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &startupStartTime);
+}
+
+void startupMark(const char* step)
+{
+	if (startupNumSteps == MAX_STARTUP_STEPS)
+		return;
+	startupStepName[startupNumSteps] = step;
+	startupStepEnd[startupNumSteps++] = elapsed();
+}
+
+void startupFirstStep(void)
+{
+	double none = -1.;
+	startupFirstStepTime.compare_exchange_strong(none, elapsed());
+}
+
+void startupArenaReserve(size_t capacity)
+{
+	//	nothing is committed until it is written
+	void* base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED)
+	{
+		fprintf(stderr, "could not map a %zu-byte arena for the simulation state\n", capacity);
+		exit(EXIT_FAILURE);
+	}
+	arenaBase = (uint8_t*) base;
+	arenaCapacity = capacity;
+	arenaUsed = 0;
+}
+
+void startupArenaRelease(void)
+{
+	if (arenaBase != NULL)
+		munmap(arenaBase, arenaCapacity);
+	arenaBase = NULL;
+}
+
+void* startupArenaAlloc(size_t len, size_t alignment)
+{
+	size_t start = (arenaUsed + alignment - 1) & ~(alignment - 1);
+	if (arenaBase == NULL || start + len > arenaCapacity)
+	{
+		fprintf(stderr, "the state arena is full (%zu bytes more wanted)\n", len);
+		exit(EXIT_FAILURE);
+	}
+	arenaUsed = start + len;
+	arenaNumBlocks++;
+	return arenaBase + start;
+}
+
+void startupParallelFor(long n, long minChunk, void (*body)(long first, long end, void* arg), void* arg)
+{
+	int numWorkers = (int) min((long) max(1U, thread::hardware_concurrency()), max(1L, n / max(1L, minChunk)));
+	startupNumWorkers = max(startupNumWorkers, numWorkers);
+	if (numWorkers == 1)
+	{
+		body(0, n, arg);
+		return;
+	}
+
+	//	the calling thread takes the first range
+	vector<StartupRange> ranges(numWorkers);
+	vector<pthread_t> threads(numWorkers);
+	vector<bool> started(numWorkers, false);
+	for (int k=0; k<numWorkers; k++)
+		ranges[k] = {n * k / numWorkers, n * (k+1) / numWorkers, body, arg};
+	for (int k=1; k<numWorkers; k++)
+		started[k] = pthread_create(&threads[k], nullptr, rangeThread, &ranges[k]) == 0;
+	body(ranges[0].first, ranges[0].end, arg);
+	//	a range without a thread is done here
+	for (int k=1; k<numWorkers; k++)
+	{
+		if (started[k])
+			pthread_join(threads[k], NULL);
+		else
+			body(ranges[k].first, ranges[k].end, arg);
+	}
+}
+
+void startupPrintReport(FILE* out)
+{
+	fprintf(out, "Startup: arena %.1f MiB in %d blocks, init on %d thread(s):", arenaUsed / 1048576., arenaNumBlocks,
+			startupNumWorkers);
+	double previous = 0.;
+	for (int k=0; k<startupNumSteps; k++)
+	{
+		fprintf(out, " %s %.1f ms%s", startupStepName[k], (startupStepEnd[k] - previous) * 1e3,
+				k < startupNumSteps-1 ? "," : "");
+		previous = startupStepEnd[k];
+	}
+	double firstStep = startupFirstStepTime.load();
+	if (firstStep >= 0.)
+		fprintf(out, "\n  time to first step: %.1f ms\n", firstStep * 1e3);
+	else
+		fprintf(out, "\n  time to first step: no step taken\n");
+}
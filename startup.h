@@ -0,0 +1,74 @@
+//
+//  startup.h
+//  GL threads
+//
+//  Fast startup for large populations.  The simulation state (grid, row
+//	pointers, traveler tables, producers) is carved out of one anonymous
+//	mapping: a single system call instead of an allocation per table, and
+//	pages that stay untouched until their first write.  That first write
+//	(filling the grid, spawning the travelers, creating their threads) is
+//	then split across all the cores by startupParallelFor, so the page
+//	faults are taken in parallel too.
+//
+//	Startup is timed step by step, up to the first move of a traveler
+//	(time to first step), for the report.
+//
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <cstddef>
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Starts the clock of the startup (call first thing in main)
+ */
+void startupBegin(void);
+
+/** Records the end of a startup step
+ *  @param step     name of the step (a literal: the pointer is kept)
+ */
+void startupMark(const char* step);
+
+/** Records the first move of a traveler (later calls are ignored)
+ */
+void startupFirstStep(void);
+
+/** Maps the arena (exits if it cannot)
+ *  @param capacity bytes to reserve: the sum of the blocks' lengths, plus
+ *                  their alignments
+ */
+void startupArenaReserve(size_t capacity);
+
+/** Carves a zero-filled block out of the arena (exits if it is full).
+ *	Blocks are never released.
+ *  @param len          size in bytes
+ *  @param alignment    power of two (the page size for blocks handed to
+ *                      numaPlaceRange)
+ *  @return the block
+ */
+void* startupArenaAlloc(size_t len, size_t alignment);
+
+/** Unmaps the arena, and all its blocks with it
+ */
+void startupArenaRelease(void);
+
+/** Runs body over [0, n) split in contiguous ranges, one per core, and
+ *	returns when all are done.  Below two chunks of minChunk, runs it in
+ *	the calling thread.
+ *  @param n        number of items
+ *  @param minChunk fewest items worth a thread
+ *  @param body     called with each range
+ *  @param arg      passed to body
+ */
+void startupParallelFor(long n, long minChunk, void (*body)(long first, long end, void* arg), void* arg);
+
+/** Prints the steps, the arena and the time to first step
+ *  @param out      output stream
+ */
+void startupPrintReport(FILE* out);
+
+#endif // STARTUP_H
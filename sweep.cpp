@@ -0,0 +1,259 @@
+//
+//  sweep.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+//
+#include "sweep.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+/** One combination of the sweep
+ *  @var config     its parameters
+ *  @var ok         it ran (false: its process failed)
+ *  @var results    what it did
+ */
+typedef struct SweepRun {
+	SweepConfig config;
+	bool ok;
+	SweepResults results;
+} SweepRun;
+
+/** A child process running a combination
+ *  @var pid        the process
+ *  @var run        index of its combination
+ *  @var fd         read end of its pipe
+ */
+typedef struct SweepChild {
+	pid_t pid;
+	size_t run;
+	int fd;
+} SweepChild;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+//	values of each swept parameter (a single value if not swept)
+vector<int> sweepRows, sweepCols, sweepTravelers, sweepProducers, sweepMaxLevels, sweepDeposits;
+vector<SweepRun> sweepRuns;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+//	Comma-separated positive integers
+static bool parseValues(const char* text, vector<int>* values)
+{
+	values->clear();
+	while (*text != 0)
+	{
+		char* end;
+		long value = strtol(text, &end, 10);
+		if (end == text || value <= 0 || (*end != ',' && *end != 0))
+			return false;
+		values->push_back((int) value);
+		text = *end == ',' ? end + 1 : end;
+	}
+	return !values->empty();
+}
+
+//	Comma-separated <rows>x<cols>
+static bool parseGrids(const char* text)
+{
+	sweepRows.clear();
+	sweepCols.clear();
+	while (*text != 0)
+	{
+		int rows, cols, length;
+		if (sscanf(text, "%dx%d%n", &rows, &cols, &length) != 2 || rows < 4 || cols < 4 ||
+			(text[length] != ',' && text[length] != 0))
+			return false;
+		sweepRows.push_back(rows);
+		sweepCols.push_back(cols);
+		text += length + (text[length] == ',');
+	}
+	return !sweepRows.empty();
+}
+
+/** Forks the process of a combination
+ *  @return the child (pid -1 if it could not be started)
+ */
+static SweepChild startRun(size_t k, double seconds, SweepRunFunc run, pid_t parent)
+{
+	SweepChild child = {-1, k, -1};
+	int fds[2];
+	if (pipe(fds) != 0)
+		return child;
+	child.pid = fork();
+	if (child.pid == 0)
+	{
+		//	the run dies with the sweep, and never returns into it
+#if defined(__linux__)
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+		if (getppid() != parent)
+			_exit(EXIT_FAILURE);
+		close(fds[0]);
+		SweepResults results = {};
+		run(&sweepRuns[k].config, seconds, &results);
+		bool written = write(fds[1], &results, sizeof(results)) == (ssize_t) sizeof(results);
+		_exit(written ? 0 : EXIT_FAILURE);
+	}
+	close(fds[1]);
+	if (child.pid < 0)
+		close(fds[0]);
+	else
+		child.fd = fds[0];
+	return child;
+}
+
+//	Reads the results of a child that has exited
+static void finishRun(const SweepChild& child)
+{
+	SweepRun* run = &sweepRuns[child.run];
+	run->ok = read(child.fd, &run->results, sizeof(run->results)) == (ssize_t) sizeof(run->results);
+	close(child.fd);
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+bool sweepLoad(const char* spec, const SweepConfig* base)
+{
+	sweepRows.assign(1, base->numRows);
+	sweepCols.assign(1, base->numCols);
+	sweepTravelers.assign(1, base->numTravelers);
+	sweepProducers.assign(1, base->numProducers);
+	sweepMaxLevels.assign(1, base->maxLevel);
+	sweepDeposits.assign(1, base->depositPerMove);
+
+	char* text = strdup(spec);
+	bool ok = true;
+	char* save;
+	for (char* item = strtok_r(text, " ;", &save); item != NULL; item = strtok_r(NULL, " ;", &save))
+	{
+		char* values = strchr(item, '=');
+		bool itemOk = values != NULL;
+		if (itemOk)
+		{
+			*values++ = 0;
+			if (strcmp(item, "grid") == 0)
+				itemOk = parseGrids(values);
+			else if (strcmp(item, "travelers") == 0)
+				itemOk = parseValues(values, &sweepTravelers);
+			else if (strcmp(item, "producers") == 0)
+				itemOk = parseValues(values, &sweepProducers);
+			else if (strcmp(item, "maxlevel") == 0)
+				itemOk = parseValues(values, &sweepMaxLevels);
+			else if (strcmp(item, "deposit") == 0)
+				itemOk = parseValues(values, &sweepDeposits);
+			else
+				itemOk = false;
+		}
+		if (!itemOk)
+		{
+			fprintf(stderr, "sweep: bad item %s%s%s (grid=RxC,..., travelers=, producers=, maxlevel=, deposit=)\n",
+					item, values != NULL ? "=" : "", values != NULL ? values : "");
+			ok = false;
+		}
+	}
+	free(text);
+
+	//	all the combinations, the last parameter varying fastest
+	sweepRuns.clear();
+	for (size_t g=0; g<sweepRows.size(); g++)
+		for (int travelers : sweepTravelers)
+			for (int producers : sweepProducers)
+				for (int maxLevel : sweepMaxLevels)
+					for (int deposit : sweepDeposits)
+					{
+						SweepRun run = {};
+						run.config = *base;
+						run.config.numRows = sweepRows[g];
+						run.config.numCols = sweepCols[g];
+						run.config.numTravelers = travelers;
+						run.config.numProducers = producers;
+						run.config.maxLevel = maxLevel;
+						run.config.depositPerMove = deposit;
+						sweepRuns.push_back(run);
+					}
+	return ok;
+}
+
+void sweepRun(double seconds, int numJobs, SweepRunFunc run, FILE* out)
+{
+	seconds = max(0.01, seconds);
+	numJobs = max(1, min(numJobs, (int) sweepRuns.size()));
+	fprintf(out, "Sweep: %zu simulations of %.1f s, %d at a time (one process each)\n", sweepRuns.size(), seconds,
+			numJobs);
+	//	or the children would print it again
+	fflush(out);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pid_t parent = getpid();
+	vector<SweepChild> running;
+	size_t next = 0;
+	while (next < sweepRuns.size() || !running.empty())
+	{
+		while (next < sweepRuns.size() && (int) running.size() < numJobs)
+		{
+			SweepChild child = startRun(next++, seconds, run, parent);
+			if (child.pid < 0)
+				perror("sweep");
+			else
+				running.push_back(child);
+		}
+		if (running.empty())
+			continue;
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		for (size_t k=0; k<running.size(); k++)
+			if (running[k].pid == pid)
+			{
+				finishRun(running[k]);
+				running.erase(running.begin() + k);
+				break;
+			}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	fprintf(out, "  %9s %9s %9s %8s %8s %10s %6s %10s %10s %8s %11s\n", "grid", "travelers", "producers", "maxlevel",
+			"deposit", "moves/s", "live", "ink used/s", "refilled/s", "painted", "levels");
+	for (const SweepRun& r : sweepRuns)
+	{
+		char grid[24];
+		snprintf(grid, sizeof(grid), "%dx%d", r.config.numRows, r.config.numCols);
+		fprintf(out, "  %9s %9d %9d %8d %8d", grid, r.config.numTravelers, r.config.numProducers, r.config.maxLevel,
+				r.config.depositPerMove);
+		if (!r.ok)
+		{
+			fprintf(out, " %10s\n", "failed");
+			continue;
+		}
+		const SweepResults* t = &r.results;
+		fprintf(out, " %10.1f %6d %10.1f %10.1f %7.1f%% %3d/%3d/%3d\n", t->moves / t->seconds, t->liveTravelers,
+				t->inkConsumed / t->seconds, t->inkRefilled / t->seconds, 100. * t->paintedCells, t->finalLevel[0],
+				t->finalLevel[1], t->finalLevel[2]);
+	}
+	fprintf(out, "  (%.1f s in all; live: travelers still running at the end, levels: red/green/blue at the end)\n",
+			(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);
+}
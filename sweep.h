@@ -0,0 +1,92 @@
+//
+//  sweep.h
+//  GL threads
+//
+//  Parameter sweep.  Every combination of the values given for each
+//	parameter is run by the simulation of main.cpp, headless, with the
+//	other options of the command line, in a child process of its own: the
+//	simulation's state is the process's globals, so a process is what
+//	isolates two runs.  Several children run at once, each for the same
+//	time, and send their totals back through a pipe; the results come out
+//	as one table, in the order of the combinations.
+//
+//	A sweep is given as parameter=values items, separated by spaces or ';'
+//	(parameters left out keep the value of the command line):
+//		grid=30x20,100x100  travelers=5,15,30  producers=3,9
+//		maxlevel=50,200  deposit=16,64
+//
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+/** Parameters of a combination
+ *  @var numRows            grid rows
+ *  @var numCols            grid columns
+ *  @var numTravelers       traveler threads
+ *  @var numProducers       producer threads
+ *  @var maxLevel           capacity of each tank (MAX_LEVEL)
+ *  @var depositPerMove     ink added to the cell moved to (TRAV_INK_INCR)
+ */
+typedef struct SweepConfig {
+	int numRows;
+	int numCols;
+	int numTravelers;
+	int numProducers;
+	int maxLevel;
+	int depositPerMove;
+} SweepConfig;
+
+/** What the simulation of a combination did
+ *  @var seconds        time run
+ *  @var moves          cells moved by all travelers
+ *  @var liveTravelers  travelers still live at the end
+ *  @var inkConsumed    ink taken from the tanks
+ *  @var inkRefilled    ink added by the producers
+ *  @var finalLevel     tank levels at the end
+ *  @var paintedCells   fraction of the cells with some ink at the end
+ */
+typedef struct SweepResults {
+	double seconds;
+	unsigned long moves;
+	int liveTravelers;
+	unsigned long inkConsumed;
+	unsigned long inkRefilled;
+	int finalLevel[3];
+	double paintedCells;
+} SweepResults;
+
+/** Runs the simulation of one combination, in the calling (child)
+ *	process, and totals what it did
+ *  @param config   the combination
+ *  @param seconds  time the simulation runs
+ *  @param results  receives the totals
+ */
+typedef void (*SweepRunFunc)(const SweepConfig* config, double seconds, SweepResults* results);
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Reads a sweep.  Errors are printed.
+ *  @param spec     the parameters and their values
+ *  @param base     values of the parameters left out
+ *  @return false if the sweep has errors
+ */
+bool sweepLoad(const char* spec, const SweepConfig* base);
+
+/** Runs all the combinations and prints the table.  Call before any
+ *	thread is created: the runs are forked.
+ *  @param seconds  time each simulation runs
+ *  @param numJobs  simulations run at once
+ *  @param run      runs a combination (in its child process)
+ *  @param out      output stream
+ */
+void sweepRun(double seconds, int numJobs, SweepRunFunc run, FILE* out);
+
+#endif // SWEEP_H
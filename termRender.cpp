@@ -0,0 +1,302 @@
+//
+//  termRender.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/ioctl.h>
+//
+#include "termRender.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+/** What a text cell shows
+ *  @var fg     foreground color (0xRRGGBB)
+ *  @var bg     background color
+ *  @var glyph  traveler character, 0 for the half-block
+ */
+typedef struct TermCell {
+	uint32_t fg;
+	uint32_t bg;
+	char glyph;
+} TermCell;
+
+struct TermRenderer {
+	int fd;
+	//	text cells of the map (the status line is below)
+	int width;
+	int height;
+	//	grid the map was laid out for
+	int numRows;
+	int numCols;
+	TermCell* cells;
+	TermCell* shown;
+	//	false until the screen holds the previous frame
+	bool valid;
+	char status[256];
+	char* buffer;
+	size_t length;
+	size_t capacity;
+	//	counters
+	unsigned long frames;
+	unsigned long long bytes;
+	unsigned long long cellsWritten;
+	size_t firstFrameBytes;
+	size_t lastFrameBytes;
+};
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+//	direction characters, indexed by TravelDirection (row 0 printed on top)
+const char TERM_DIR_CHAR[4] = {'v', '<', '^', '>'};
+//	several travelers in one text cell
+const char TERM_CROWD_CHAR = '*';
+const uint32_t TERM_TRAVELER_COLOR = 0xFFFFFF;
+//	traveler waiting for the cell ahead (exclusive cells)
+const uint32_t TERM_BLOCKED_COLOR = 0xFF8000;
+//	upper half block, in UTF-8
+const char TERM_HALF_BLOCK[] = "\xe2\x96\x80";
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static void append(TermRenderer* renderer, const char* bytes, size_t n)
+{
+	if (renderer->length + n > renderer->capacity)
+	{
+		renderer->capacity = max(2 * renderer->capacity, renderer->length + n);
+		renderer->buffer = (char*) realloc(renderer->buffer, renderer->capacity);
+	}
+	memcpy(renderer->buffer + renderer->length, bytes, n);
+	renderer->length += n;
+}
+
+static void appendf(TermRenderer* renderer, const char* format, int a, int b, int c)
+{
+	char sequence[64];
+	int n = snprintf(sequence, sizeof(sequence), format, a, b, c);
+	append(renderer, sequence, n);
+}
+
+//	Terminal size, 80x24 if the descriptor is not a terminal
+static void terminalSize(int fd, int* width, int* height)
+{
+	struct winsize size;
+	if (ioctl(fd, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 && size.ws_row > 1)
+	{
+		*width = size.ws_col;
+		*height = size.ws_row;
+	}
+	else
+	{
+		*width = 80;
+		*height = 24;
+	}
+}
+
+//	Average color (0xRRGGBB) of a block of cells
+static uint32_t blockColor(const GridFrame* frame, int row0, int col0, int blockH, int blockW)
+{
+	unsigned long red = 0, green = 0, blue = 0, count = 0;
+	for (int i=row0; i<min(row0 + blockH, frame->numRows); i++)
+	{
+		const unsigned int* row = frame->cells + (size_t) i*frame->numCols;
+		for (int j=col0; j<min(col0 + blockW, frame->numCols); j++)
+		{
+			red += row[j] & 0xFF;
+			green += (row[j] >> 8) & 0xFF;
+			blue += (row[j] >> 16) & 0xFF;
+			count++;
+		}
+	}
+	if (count == 0)
+		return 0;
+	return (uint32_t) ((red/count) << 16 | (green/count) << 8 | blue/count);
+}
+
+/** Lays the grid out on the terminal: the map takes as many text cells as
+ *	needed, up to the whole terminal but the status line
+ */
+static void layout(TermRenderer* renderer, const GridFrame* frame, int termWidth, int termHeight,
+				   int* blockW, int* blockH)
+{
+	*blockW = (frame->numCols + termWidth - 1) / termWidth;
+	*blockH = (frame->numRows + 2*(termHeight-1) - 1) / (2*(termHeight-1));
+	int width = (frame->numCols + *blockW - 1) / *blockW;
+	int height = ((frame->numRows + *blockH - 1) / *blockH + 1) / 2;
+
+	if (width != renderer->width || height != renderer->height ||
+		frame->numRows != renderer->numRows || frame->numCols != renderer->numCols)
+	{
+		renderer->width = width;
+		renderer->height = height;
+		renderer->numRows = frame->numRows;
+		renderer->numCols = frame->numCols;
+		free(renderer->cells);
+		free(renderer->shown);
+		renderer->cells = (TermCell*) calloc((size_t) width * height, sizeof(TermCell));
+		renderer->shown = (TermCell*) calloc((size_t) width * height, sizeof(TermCell));
+		renderer->valid = false;
+	}
+}
+
+static void setColor(TermRenderer* renderer, bool foreground, uint32_t color)
+{
+	appendf(renderer, foreground ? "\x1b[38;2;%d;%d;%dm" : "\x1b[48;2;%d;%d;%dm",
+			(color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+TermRenderer* termRendererCreate(int fd)
+{
+	TermRenderer* renderer = (TermRenderer*) calloc(1, sizeof(TermRenderer));
+	renderer->fd = fd;
+	return renderer;
+}
+
+size_t termRendererDraw(TermRenderer* renderer, const GridFrame* frame)
+{
+	int termWidth, termHeight, blockW, blockH;
+	terminalSize(renderer->fd, &termWidth, &termHeight);
+	layout(renderer, frame, termWidth, termHeight, &blockW, &blockH);
+	const int width = renderer->width, height = renderer->height;
+
+	//	The map: each text cell shows two blocks, then the travelers on top
+	for (int r=0; r<height; r++)
+		for (int c=0; c<width; c++)
+		{
+			TermCell* cell = renderer->cells + r*width + c;
+			cell->fg = blockColor(frame, 2*r*blockH, c*blockW, blockH, blockW);
+			cell->bg = blockColor(frame, (2*r+1)*blockH, c*blockW, blockH, blockW);
+			cell->glyph = 0;
+		}
+	for (int k=0; k<frame->numTravelers; k++)
+	{
+		const PublishedTraveler* traveler = frame->travelers + k;
+		if (!traveler->isLive || traveler->row >= frame->numRows || traveler->col >= frame->numCols)
+			continue;
+		TermCell* cell = renderer->cells + (traveler->row / blockH / 2)*width + traveler->col / blockW;
+		if (cell->glyph == 0)
+		{
+			//	the background shows the two blocks' average
+			uint32_t average = 0;
+			for (int shift=0; shift<24; shift+=8)
+				average |= ((((cell->fg >> shift) & 0xFF) + ((cell->bg >> shift) & 0xFF)) / 2) << shift;
+			cell->bg = average;
+			cell->fg = traveler->flags & PUBLISHED_TRAVELER_BLOCKED ? TERM_BLOCKED_COLOR : TERM_TRAVELER_COLOR;
+			cell->glyph = TERM_DIR_CHAR[traveler->dir & 3];
+		}
+		else
+			cell->glyph = TERM_CROWD_CHAR;
+	}
+
+	//	Only the cells that changed, moving the cursor and switching colors
+	//	only when needed
+	renderer->length = 0;
+	if (!renderer->valid)
+		append(renderer, "\x1b[?25l\x1b[0m\x1b[2J", strlen("\x1b[?25l\x1b[0m\x1b[2J"));
+	int cursorRow = -1, cursorCol = -1;
+	bool colorsKnown = false;
+	uint32_t fg = 0, bg = 0;
+	unsigned long cellsWritten = 0;
+	for (int r=0; r<height; r++)
+		for (int c=0; c<width; c++)
+		{
+			const TermCell* cell = renderer->cells + r*width + c;
+			TermCell* shown = renderer->shown + r*width + c;
+			if (renderer->valid && cell->fg == shown->fg && cell->bg == shown->bg && cell->glyph == shown->glyph)
+				continue;
+			if (r != cursorRow || c != cursorCol)
+				appendf(renderer, "\x1b[%d;%dH", r + 1, c + 1, 0);
+			if (!colorsKnown || cell->fg != fg)
+				setColor(renderer, true, cell->fg);
+			if (!colorsKnown || cell->bg != bg)
+				setColor(renderer, false, cell->bg);
+			fg = cell->fg;
+			bg = cell->bg;
+			colorsKnown = true;
+			if (cell->glyph == 0)
+				append(renderer, TERM_HALF_BLOCK, strlen(TERM_HALF_BLOCK));
+			else
+				append(renderer, &cell->glyph, 1);
+			*shown = *cell;
+			cellsWritten++;
+			//	no assumption on where the cursor goes after the last column
+			cursorRow = r;
+			cursorCol = c + 1 < width ? c + 1 : -1;
+		}
+
+	//	The status line, when its text changes
+	char status[256];
+	snprintf(status, sizeof(status), "frame %llu  grid %dx%d  live travelers %d  ink R %d G %d B %d (max %d)  %zu B/frame",
+			 (unsigned long long) frame->generation, frame->numRows, frame->numCols, frame->numLiveThreads,
+			 frame->redLevel, frame->greenLevel, frame->blueLevel, frame->maxLevel, renderer->lastFrameBytes);
+	if (!renderer->valid || strcmp(status, renderer->status) != 0)
+	{
+		appendf(renderer, "\x1b[%d;1H\x1b[0m", height + 1, 0, 0);
+		append(renderer, status, min(strlen(status), (size_t) termWidth));
+		append(renderer, "\x1b[K", 3);
+		strcpy(renderer->status, status);
+	}
+
+	//	One write for the whole frame
+	size_t written = 0;
+	while (written < renderer->length)
+	{
+		ssize_t n = write(renderer->fd, renderer->buffer + written, renderer->length - written);
+		if (n <= 0)
+			break;
+		written += n;
+	}
+
+	if (renderer->frames == 0)
+		renderer->firstFrameBytes = renderer->length;
+	renderer->frames++;
+	renderer->bytes += renderer->length;
+	renderer->cellsWritten += cellsWritten;
+	renderer->lastFrameBytes = renderer->length;
+	renderer->valid = true;
+	return renderer->length;
+}
+
+void termRendererPrintReport(const TermRenderer* renderer, FILE* out)
+{
+	if (renderer->frames == 0)
+		return;
+	fprintf(out, "Terminal: %lu frames, %.0f bytes/frame (first frame %zu bytes), %.1f cells/frame of %d\n",
+			renderer->frames, (double) renderer->bytes / renderer->frames, renderer->firstFrameBytes,
+			(double) renderer->cellsWritten / renderer->frames, renderer->width * renderer->height);
+}
+
+void termRendererRestore(const TermRenderer* renderer)
+{
+	if (renderer->frames == 0)
+		return;
+	char reset[64];
+	int n = snprintf(reset, sizeof(reset), "\x1b[0m\x1b[?25h\x1b[%d;1H\n", renderer->height + 2);
+	if (write(renderer->fd, reset, n) < 0)
+		perror("write");
+}
+
+void termRendererDestroy(TermRenderer* renderer)
+{
+	free(renderer->cells);
+	free(renderer->shown);
+	free(renderer->buffer);
+	free(renderer);
+}
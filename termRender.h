@@ -0,0 +1,59 @@
+//
+//  termRender.h
+//  GL threads
+//
+//  Terminal renderer for published frames.  The grid is downsampled to
+//	the terminal and drawn with 24-bit ANSI colors, two grid rows per text
+//	row (upper half-block glyph: foreground on top, background below), with
+//	the travelers overlaid as direction characters and a status line with
+//	the ink levels and live travelers.  Only the text cells that changed
+//	since the previous frame are written, and each frame goes out in a
+//	single write.
+//
+
+#ifndef TERM_RENDER_H
+#define TERM_RENDER_H
+
+#include <cstdio>
+#include <cstddef>
+//
+#include "gridReader.h"
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+//	Opaque handle on a renderer
+typedef struct TermRenderer TermRenderer;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Creates a renderer (the terminal's size is read at every frame)
+ *  @param fd       file descriptor of the terminal
+ *  @return the renderer
+ */
+TermRenderer* termRendererCreate(int fd);
+
+/** Draws a frame
+ *  @param renderer the renderer
+ *  @param frame    the frame
+ *  @return bytes written for this frame
+ */
+size_t termRendererDraw(TermRenderer* renderer, const GridFrame* frame);
+
+/** Prints the frame count and the bytes written per frame
+ *  @param renderer the renderer
+ *  @param out      output stream
+ */
+void termRendererPrintReport(const TermRenderer* renderer, FILE* out);
+
+/** Restores the terminal's colors and cursor, and moves below the map
+ *  @param renderer the renderer
+ */
+void termRendererRestore(const TermRenderer* renderer);
+
+void termRendererDestroy(TermRenderer* renderer);
+
+#endif // TERM_RENDER_H
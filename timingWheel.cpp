@@ -0,0 +1,341 @@
+//
+//  timingWheel.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#if defined(__linux__)
+	#include <sys/syscall.h>
+	#include <sys/timerfd.h>
+	#include <linux/futex.h>
+#endif
+//
+#include "timingWheel.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Wheel geometry:	4 levels of 256 slots.  Level 0 holds the timers due in
+//	the next 256 ticks, level l those due within 256^(l+1) ticks; they
+//	cascade down a level each time the level below wraps around.
+//---------------------------------------------------------------------------
+
+const int WHEEL_BITS = 8;
+const int WHEEL_SLOTS = 1 << WHEEL_BITS;
+const int WHEEL_LEVELS = 4;
+const uint64_t WHEEL_MASK = WHEEL_SLOTS - 1;
+
+//	lateness histogram: bucket k counts wakeups between 2^(k-1) and 2^k us late
+const int LATENESS_BUCKETS = 24;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+WheelTimer* wheelSlots[WHEEL_LEVELS][WHEEL_SLOTS];
+pthread_mutex_t wheel_lock = PTHREAD_MUTEX_INITIALIZER;
+uint64_t wheelTick = 0;
+uint64_t wheelStartNs = 0;
+int wheelTickUs = 1000;
+bool wheelRunning = false;
+pthread_t wheelThreadID;
+int wheelTimerFd = -1;
+
+//	Threads parked for a level-0 slot wait on that slot's word; the wheel
+//	bumps it and wakes them all with one system call.
+atomic<uint32_t> wheelWakeWords[WHEEL_SLOTS];
+
+atomic<unsigned long> latenessHistogram[LATENESS_BUCKETS];
+atomic<unsigned long> latenessTotalUs(0);
+atomic<unsigned long> latenessMaxUs(0);
+atomic<unsigned long> sleepCount(0);
+//	sleep-related system calls: nanosleep, or futex wait/wake + timerfd read
+atomic<unsigned long> sleepSyscalls(0);
+atomic<unsigned long> wheelTicksRead(0);
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static uint64_t nowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void recordLateness(uint64_t deadlineNs, uint64_t wokeNs)
+{
+	unsigned long lateUs = wokeNs > deadlineNs ? (wokeNs - deadlineNs) / 1000 : 0;
+	int bucket = 0;
+	while (bucket < LATENESS_BUCKETS-1 && (1UL << bucket) <= lateUs)
+		bucket++;
+	latenessHistogram[bucket].fetch_add(1, memory_order_relaxed);
+	latenessTotalUs.fetch_add(lateUs, memory_order_relaxed);
+	unsigned long prevMax = latenessMaxUs.load(memory_order_relaxed);
+	while (lateUs > prevMax && !latenessMaxUs.compare_exchange_weak(prevMax, lateUs))
+		;
+	sleepCount.fetch_add(1, memory_order_relaxed);
+}
+
+//	upper bound (in us) of the bucket holding the given fraction of wakeups
+static unsigned long latenessPercentile(double fraction)
+{
+	unsigned long total = sleepCount.load();
+	unsigned long seen = 0;
+	for (int k=0; k<LATENESS_BUCKETS; k++)
+	{
+		seen += latenessHistogram[k].load();
+		if (seen >= fraction * total)
+			return 1UL << k;
+	}
+	return 1UL << (LATENESS_BUCKETS-1);
+}
+
+#if defined(__linux__)
+static void futexWait(atomic<uint32_t>* word, uint32_t value)
+{
+	syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futexWakeAll(atomic<uint32_t>* word)
+{
+	syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+#endif
+
+//	Caller holds wheel_lock
+static void insertTimer(WheelTimer* timer)
+{
+	//	a timer due now (or in the past) fires at the next tick
+	if (timer->deadlineTick <= wheelTick)
+		timer->deadlineTick = wheelTick + 1;
+
+	uint64_t delta = timer->deadlineTick - wheelTick;
+	int level = 0;
+	while (level < WHEEL_LEVELS-1 && delta >= (1ULL << (WHEEL_BITS * (level+1))))
+		level++;
+	int slot = (int) ((timer->deadlineTick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+	timer->next = wheelSlots[level][slot];
+	wheelSlots[level][slot] = timer;
+}
+
+/** Advances the wheel by one tick and returns the timers that fall due.
+ *	Caller holds wheel_lock.
+ */
+static WheelTimer* advanceOneTick(void)
+{
+	wheelTick++;
+
+	//	cascade: each level whose lower levels just wrapped around
+	//	redistributes its current slot
+	for (int level=1; level<WHEEL_LEVELS; level++)
+	{
+		if ((wheelTick & ((1ULL << (WHEEL_BITS * level)) - 1)) != 0)
+			break;
+		int slot = (int) ((wheelTick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+		WheelTimer* timer = wheelSlots[level][slot];
+		wheelSlots[level][slot] = NULL;
+		while (timer != NULL)
+		{
+			WheelTimer* next = timer->next;
+			//	due right now: straight to this tick's slot (a parked
+			//	thread already reads deadlineTick, so it must not change)
+			if (timer->deadlineTick == wheelTick)
+			{
+				timer->next = wheelSlots[0][wheelTick & WHEEL_MASK];
+				wheelSlots[0][wheelTick & WHEEL_MASK] = timer;
+			}
+			else
+				insertTimer(timer);
+			timer = next;
+		}
+	}
+
+	int slot = (int) (wheelTick & WHEEL_MASK);
+	WheelTimer* due = wheelSlots[0][slot];
+	wheelSlots[0][slot] = NULL;
+	return due;
+}
+
+#if defined(__linux__)
+static void* wheelThread(void* data)
+{
+	while (true)
+	{
+		uint64_t expirations;
+		if (read(wheelTimerFd, &expirations, sizeof(expirations)) != sizeof(expirations))
+			continue;
+		wheelTicksRead.fetch_add(1, memory_order_relaxed);
+		sleepSyscalls.fetch_add(1, memory_order_relaxed);
+
+		//	several ticks may have elapsed if we were descheduled
+		for (uint64_t e=0; e<expirations; e++)
+		{
+			pthread_mutex_lock(&wheel_lock);
+			WheelTimer* due = advanceOneTick();
+			int slot = (int) (wheelTick & WHEEL_MASK);
+			pthread_mutex_unlock(&wheel_lock);
+
+			bool wakeParked = false;
+			uint64_t firedNs = nowNs();
+			while (due != NULL)
+			{
+				//	read everything first: once fired, the timer may be gone
+				WheelTimer* next = due->next;
+				void (*callback)(void*) = due->callback;
+				void* arg = due->arg;
+				if (callback != NULL)
+				{
+					recordLateness(due->deadlineNs, firedNs);
+					due->fired.store(1, memory_order_release);
+					callback(arg);
+				}
+				else
+				{
+					due->fired.store(1, memory_order_release);
+					wakeParked = true;
+				}
+				due = next;
+			}
+
+			if (wakeParked)
+			{
+				wheelWakeWords[slot].fetch_add(1, memory_order_release);
+				futexWakeAll(wheelWakeWords + slot);
+				sleepSyscalls.fetch_add(1, memory_order_relaxed);
+			}
+		}
+	}
+	return NULL;
+}
+#endif
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+bool timingWheelStart(int tickUs)
+{
+#if defined(__linux__)
+	if (wheelRunning)
+		return true;
+
+	wheelTickUs = tickUs > 0 ? tickUs : 1000;
+	wheelTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (wheelTimerFd < 0)
+	{
+		perror("timerfd_create");
+		return false;
+	}
+	struct itimerspec spec;
+	spec.it_interval.tv_sec = wheelTickUs / 1000000;
+	spec.it_interval.tv_nsec = (wheelTickUs % 1000000) * 1000L;
+	spec.it_value = spec.it_interval;
+
+	wheelStartNs = nowNs();
+	if (timerfd_settime(wheelTimerFd, 0, &spec, NULL) != 0)
+	{
+		perror("timerfd_settime");
+		close(wheelTimerFd);
+		return false;
+	}
+	wheelRunning = true;
+	if (pthread_create(&wheelThreadID, nullptr, wheelThread, NULL) != 0)
+	{
+		fprintf(stderr, "could not create the timing wheel thread\n");
+		wheelRunning = false;
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool timingWheelRunning(void)
+{
+	return wheelRunning;
+}
+
+void timingWheelSchedule(WheelTimer* timer, long us, void (*callback)(void* arg), void* arg)
+{
+	uint64_t deadlineNs = nowNs() + (uint64_t) us * 1000;
+	timer->deadlineNs = deadlineNs;
+	timer->callback = callback;
+	timer->arg = arg;
+	timer->fired.store(0, memory_order_relaxed);
+
+	pthread_mutex_lock(&wheel_lock);
+	//	round up: never fire before the deadline
+	timer->deadlineTick = (deadlineNs - wheelStartNs + wheelTickUs * 1000ULL - 1) / (wheelTickUs * 1000ULL);
+	insertTimer(timer);
+	pthread_mutex_unlock(&wheel_lock);
+}
+
+void timingWheelSleep(long us)
+{
+	//	A sleep of 0 still goes through usleep, as it did before the wheel:
+	//	it gives the core away, so a thread retrying an empty tank does
+	//	not starve the producers.
+	us = max(0L, us);
+#if defined(__linux__)
+	if (wheelRunning && us > 0)
+	{
+		WheelTimer timer;
+		timingWheelSchedule(&timer, us, NULL, NULL);
+		atomic<uint32_t>* word = wheelWakeWords + (timer.deadlineTick & WHEEL_MASK);
+		while (timer.fired.load(memory_order_acquire) == 0)
+		{
+			uint32_t value = word->load(memory_order_acquire);
+			if (timer.fired.load(memory_order_acquire) != 0)
+				break;
+			futexWait(word, value);
+			sleepSyscalls.fetch_add(1, memory_order_relaxed);
+		}
+		recordLateness(timer.deadlineNs, nowNs());
+		return;
+	}
+#endif
+
+	uint64_t deadlineNs = nowNs() + (uint64_t) us * 1000;
+	usleep(us);
+	sleepSyscalls.fetch_add(1, memory_order_relaxed);
+	recordLateness(deadlineNs, nowNs());
+}
+
+void timingWheelPrintReport(FILE* out, double seconds)
+{
+	unsigned long count = sleepCount.load();
+	if (wheelRunning)
+		fprintf(out, "Timer report (timing wheel, %d us tick)\n", wheelTickUs);
+	else
+		fprintf(out, "Timer report (usleep)\n");
+	if (count == 0)
+	{
+		fprintf(out, "  no sleeps\n");
+		return;
+	}
+
+	fprintf(out, "  sleeps: %lu (%.0f per second)\n", count, count / seconds);
+	fprintf(out, "  lateness: mean %.0f us, p50 < %lu us, p90 < %lu us, p99 < %lu us, max %lu us\n",
+			(double) latenessTotalUs.load() / count, latenessPercentile(0.5),
+			latenessPercentile(0.9), latenessPercentile(0.99), latenessMaxUs.load());
+	fprintf(out, "  sleep system calls: %lu (%.0f per simulated second", sleepSyscalls.load(),
+			sleepSyscalls.load() / seconds);
+	if (wheelRunning)
+		fprintf(out, ", of which %lu timerfd reads", wheelTicksRead.load());
+	fprintf(out, ")\n");
+
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		fprintf(out, "  context switches: %ld voluntary, %ld involuntary\n",
+				usage.ru_nvcsw, usage.ru_nivcsw);
+}
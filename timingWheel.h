@@ -0,0 +1,80 @@
+//
+//  timingWheel.h
+//  GL threads
+//
+//  Shared hierarchical timing wheel for the simulation's sleeps.  Instead
+//	of one nanosleep per traveler step and per producer tick, sleepers
+//	register a timer in the wheel, and a single thread driven by a timerfd
+//	advances the wheel once per tick.  All the threads due in the same tick
+//	wait on the same futex word and are woken by a single FUTEX_WAKE;
+//	callback timers (coroutine travelers) cost no system call at all.
+//
+//	timingWheelSleep also works when the wheel isn't running (it then just
+//	calls usleep), so that lateness and system calls can be compared
+//	between the two models.
+//
+
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+/** A timer in the wheel.  The owner provides the storage (a stack variable,
+ *	a field of a coroutine frame...) and must keep it alive until it fires.
+ *  @var deadlineTick   tick at which the timer fires
+ *  @var deadlineNs     requested expiry time (CLOCK_MONOTONIC, ns)
+ *  @var next           next timer in the same slot
+ *  @var callback       called by the wheel thread when the timer fires (NULL
+ *                      for a parked thread)
+ *  @var arg            callback argument
+ *  @var fired          set when the timer has fired
+ */
+typedef struct WheelTimer {
+	uint64_t deadlineTick;
+	uint64_t deadlineNs;
+	struct WheelTimer* next;
+	void (*callback)(void* arg);
+	void* arg;
+	std::atomic<uint32_t> fired;
+} WheelTimer;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Starts the wheel thread
+ *  @param tickUs       tick length (in microseconds)
+ *  @return false if timerfd/futex are not available (sleeps keep using usleep)
+ */
+bool timingWheelStart(int tickUs);
+
+bool timingWheelRunning(void);
+
+/** Sleeps the calling thread (through the wheel when it runs, with usleep
+ *	otherwise), and records how late it woke up
+ *  @param us           sleep time (in microseconds; 0 still yields the core,
+ *                      through usleep)
+ */
+void timingWheelSleep(long us);
+
+/** Arms a callback timer.  The wheel must be running.
+ *  @param timer        timer storage
+ *  @param us           delay (in microseconds)
+ *  @param callback     called from the wheel thread when the timer fires
+ *  @param arg          callback argument
+ */
+void timingWheelSchedule(WheelTimer* timer, long us, void (*callback)(void* arg), void* arg);
+
+/** Prints the lateness distribution and the system calls per second
+ *  @param out          output stream
+ *  @param seconds      duration of the run
+ */
+void timingWheelPrintReport(FILE* out, double seconds);
+
+#endif // TIMING_WHEEL_H
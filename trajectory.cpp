@@ -0,0 +1,303 @@
+//
+//  trajectory.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <time.h>
+#include <pthread.h>
+//
+#include "trajectoryFormat.h"
+#include "trajectory.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+/** Moves (and end-of-life markers) buffered by a thread, as columns.  Its thread appends to it; the
+ *	lock is only contended when trajectoryClose flushes it.
+ *  @var lock       held to append and to flush
+ *  @var numMoves   records buffered
+ *  @var lifeStart  the next move starts a life
+ *  @var encoded    scratch of the encoded columns
+ *  @var next       next buffer of the list
+ */
+typedef struct TrajectoryBuffer {
+	pthread_mutex_t lock;
+	int numMoves;
+	bool lifeStart;
+	uint64_t timeNs[TRAJ_BUFFER_MOVES];
+	uint32_t traveler[TRAJ_BUFFER_MOVES];
+	uint16_t row[TRAJ_BUFFER_MOVES];
+	uint16_t col[TRAJ_BUFFER_MOVES];
+	uint8_t dir[TRAJ_BUFFER_MOVES];
+	uint8_t type[TRAJ_BUFFER_MOVES];
+	uint32_t waitUs[TRAJ_BUFFER_MOVES];
+	uint8_t encoded[NUM_TRAJ_COLUMNS * TRAJ_BUFFER_MOVES * TRAJ_MAX_VARINT_BYTES];
+	TrajectoryBuffer* next;
+} TrajectoryBuffer;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+bool trajectoryOn = false;
+
+char trajPath[256] = "";
+FILE* trajFile = NULL;
+uint64_t trajStartNs = 0;
+//	file, list of buffers and totals
+pthread_mutex_t traj_file_lock = PTHREAD_MUTEX_INITIALIZER;
+TrajectoryBuffer* trajBuffers = NULL;
+bool trajClosed = false;
+unsigned long trajNumChunks = 0, trajNumMoves = 0, trajNumLives = 0, trajNumBytes = 0;
+unsigned long trajColumnBytes[NUM_TRAJ_COLUMNS];
+bool trajWriteFailed = false;
+
+thread_local TrajectoryBuffer* trajSelf = NULL;
+
+const char* TRAJ_COLUMN_NAME[NUM_TRAJ_COLUMNS] = {"time", "traveler", "row", "col", "dir", "type", "wait"};
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static TrajectoryBuffer* newBuffer(void)
+{
+	TrajectoryBuffer* buffer = (TrajectoryBuffer*) malloc(sizeof(TrajectoryBuffer));
+	if (buffer == NULL)
+	{
+		fprintf(stderr, "could not allocate a trajectory buffer\n");
+		exit(EXIT_FAILURE);
+	}
+	pthread_mutex_init(&buffer->lock, NULL);
+	buffer->numMoves = 0;
+	buffer->lifeStart = false;
+	pthread_mutex_lock(&traj_file_lock);
+	buffer->next = trajBuffers;
+	trajBuffers = buffer;
+	pthread_mutex_unlock(&traj_file_lock);
+	return buffer;
+}
+
+//	Columns of signed values, as zigzag deltas
+template <typename T>
+static uint8_t* encodeDeltas(uint8_t* out, const T* values, int n)
+{
+	int64_t previous = 0;
+	for (int k=0; k<n; k++)
+	{
+		out = trajPutVarint(out, trajZigzag((int64_t) values[k] - previous));
+		previous = values[k];
+	}
+	return out;
+}
+
+/** Encodes the buffer and writes it as a chunk.  Caller holds the
+ *	buffer's lock.
+ */
+static void flushBuffer(TrajectoryBuffer* buffer)
+{
+	int n = buffer->numMoves;
+	if (n == 0)
+		return;
+	TrajChunkHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = TRAJ_CHUNK_MAGIC;
+	header.numMoves = n;
+	header.firstNs = buffer->timeNs[0];
+
+	//	the columns, one after the other
+	uint8_t* start = buffer->encoded;
+	uint8_t* out = start;
+	uint64_t previousNs = header.firstNs;
+	for (int k=0; k<n; k++)
+	{
+		out = trajPutVarint(out, buffer->timeNs[k] - previousNs);
+		previousNs = buffer->timeNs[k];
+	}
+	header.columnBytes[TRAJ_TIME_COLUMN] = out - start;
+	start = out;
+	out = encodeDeltas(out, buffer->traveler, n);
+	header.columnBytes[TRAJ_TRAVELER_COLUMN] = out - start;
+	start = out;
+	out = encodeDeltas(out, buffer->row, n);
+	header.columnBytes[TRAJ_ROW_COLUMN] = out - start;
+	start = out;
+	out = encodeDeltas(out, buffer->col, n);
+	header.columnBytes[TRAJ_COL_COLUMN] = out - start;
+	size_t count = min((size_t) n, (size_t) TRAJ_BUFFER_MOVES);
+	memcpy(out, buffer->dir, count);
+	out += count;
+	header.columnBytes[TRAJ_DIR_COLUMN] = count;
+	memcpy(out, buffer->type, count);
+	out += count;
+	header.columnBytes[TRAJ_TYPE_COLUMN] = count;
+	start = out;
+	for (int k=0; k<n; k++)
+		out = trajPutVarint(out, buffer->waitUs[k]);
+	header.columnBytes[TRAJ_WAIT_COLUMN] = out - start;
+	buffer->numMoves = 0;
+	int ends = 0;
+	for (int k=0; k<n; k++)
+		ends += (buffer->dir[k] & TRAJ_LIFE_END) != 0;
+
+	size_t size = out - buffer->encoded;
+	pthread_mutex_lock(&traj_file_lock);
+	if (!trajClosed)
+	{
+		if (fwrite(&header, sizeof(header), 1, trajFile) != 1 || fwrite(buffer->encoded, 1, size, trajFile) != size)
+			trajWriteFailed = true;
+		trajNumChunks++;
+		trajNumMoves += n - ends;
+		trajNumLives += ends;
+		trajNumBytes += sizeof(header) + size;
+		for (int c=0; c<NUM_TRAJ_COLUMNS; c++)
+			trajColumnBytes[c] += header.columnBytes[c];
+	}
+	pthread_mutex_unlock(&traj_file_lock);
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+bool trajectoryOpen(const char* path, int numRows, int numCols, int maxTravelers, int inkPerMove,
+					int depositPerMove)
+{
+	trajFile = fopen(path, "wb");
+	if (trajFile == NULL)
+	{
+		perror(path);
+		return false;
+	}
+	snprintf(trajPath, sizeof(trajPath), "%s", path);
+	trajStartNs = trajectoryClock();
+
+	TrajFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = TRAJ_FILE_MAGIC;
+	header.version = TRAJ_FILE_VERSION;
+	header.numRows = numRows;
+	header.numCols = numCols;
+	header.maxTravelers = maxTravelers;
+	header.inkPerMove = inkPerMove;
+	header.depositPerMove = depositPerMove;
+	header.startNs = trajStartNs;
+	if (fwrite(&header, sizeof(header), 1, trajFile) != 1)
+	{
+		perror(path);
+		return false;
+	}
+	trajNumBytes = sizeof(header);
+	trajectoryOn = true;
+	return true;
+}
+
+uint64_t trajectoryClock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void trajectoryBeginLife(void)
+{
+	if (trajSelf == NULL)
+		trajSelf = newBuffer();
+	trajSelf->lifeStart = true;
+}
+
+void trajectoryRecord(unsigned int index, int row, int col, int dir, int type, uint64_t inkWaitNs)
+{
+	if (trajSelf == NULL)
+		trajSelf = newBuffer();
+	TrajectoryBuffer* buffer = trajSelf;
+	pthread_mutex_lock(&buffer->lock);
+	int k = buffer->numMoves++;
+	buffer->timeNs[k] = trajectoryClock() - trajStartNs;
+	buffer->traveler[k] = index;
+	buffer->row[k] = row;
+	buffer->col[k] = col;
+	buffer->dir[k] = (dir & TRAJ_DIR_MASK) | (buffer->lifeStart ? TRAJ_LIFE_START : 0);
+	buffer->type[k] = type;
+	buffer->waitUs[k] = (uint32_t) (inkWaitNs / 1000);
+	buffer->lifeStart = false;
+	if (buffer->numMoves == TRAJ_BUFFER_MOVES)
+		flushBuffer(buffer);
+	pthread_mutex_unlock(&buffer->lock);
+}
+
+void trajectoryEndLife(unsigned int index, int row, int col, int dir, int type)
+{
+	if (trajSelf == NULL)
+		trajSelf = newBuffer();
+	TrajectoryBuffer* buffer = trajSelf;
+	pthread_mutex_lock(&buffer->lock);
+	int k = buffer->numMoves++;
+	buffer->timeNs[k] = trajectoryClock() - trajStartNs;
+	buffer->traveler[k] = index;
+	buffer->row[k] = row;
+	buffer->col[k] = col;
+	buffer->dir[k] = (dir & TRAJ_DIR_MASK) | TRAJ_LIFE_END;
+	buffer->type[k] = type;
+	buffer->waitUs[k] = 0;
+	buffer->lifeStart = false;
+	if (buffer->numMoves == TRAJ_BUFFER_MOVES)
+		flushBuffer(buffer);
+	pthread_mutex_unlock(&buffer->lock);
+}
+
+void trajectoryThreadEnd(void)
+{
+	if (trajSelf == NULL)
+		return;
+	pthread_mutex_lock(&trajSelf->lock);
+	flushBuffer(trajSelf);
+	pthread_mutex_unlock(&trajSelf->lock);
+}
+
+void trajectoryClose(void)
+{
+	if (trajFile == NULL)
+		return;
+	pthread_mutex_lock(&traj_file_lock);
+	TrajectoryBuffer* buffers = trajBuffers;
+	pthread_mutex_unlock(&traj_file_lock);
+	//	buffers are only ever added at the head: the list read is stable
+	for (TrajectoryBuffer* buffer=buffers; buffer != NULL; buffer=buffer->next)
+	{
+		pthread_mutex_lock(&buffer->lock);
+		flushBuffer(buffer);
+		pthread_mutex_unlock(&buffer->lock);
+	}
+
+	pthread_mutex_lock(&traj_file_lock);
+	trajClosed = true;
+	if (fclose(trajFile) != 0)
+		trajWriteFailed = true;
+	trajFile = NULL;
+	pthread_mutex_unlock(&traj_file_lock);
+}
+
+void trajectoryPrintReport(FILE* out)
+{
+	pthread_mutex_lock(&traj_file_lock);
+	fprintf(out, "Trajectory %s: %lu moves and %lu lives ended in %lu chunks, %.1f KiB (%.2f bytes/move)%s\n",
+			trajPath, trajNumMoves, trajNumLives, trajNumChunks, trajNumBytes / 1024., trajNumMoves > 0 ? (double) trajNumBytes / trajNumMoves : 0.,
+			trajWriteFailed ? ", WRITE FAILED" : "");
+	if (trajNumMoves > 0)
+	{
+		fprintf(out, "  bytes/move by column:");
+		for (int c=0; c<NUM_TRAJ_COLUMNS; c++)
+			fprintf(out, " %s %.2f", TRAJ_COLUMN_NAME[c], (double) trajColumnBytes[c] / trajNumMoves);
+		fputc('\n', out);
+	}
+	pthread_mutex_unlock(&traj_file_lock);
+}
@@ -0,0 +1,86 @@
+//
+//  trajectory.h
+//  GL threads
+//
+//  Export of every move of every traveler, for offline analysis (format in
+//	trajectoryFormat.h, aggregates with trajstat).  Each traveler thread
+//	appends its moves to a buffer of its own, as columns; a full buffer is
+//	delta-encoded by its thread and written as one chunk, so threads only
+//	meet on the file, once every TRAJ_BUFFER_MOVES moves.
+//
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <cstdio>
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+//	moves buffered per thread before they are written
+const int TRAJ_BUFFER_MOVES = 4096;
+
+//	set by trajectoryOpen
+extern bool trajectoryOn;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Creates the file and writes its header
+ *  @param path             the file
+ *  @param numRows          grid rows
+ *  @param numCols          grid columns
+ *  @param maxTravelers     size of the traveler table
+ *  @param inkPerMove       ink taken from the tank for each move
+ *  @param depositPerMove   ink added to the cell for each move
+ *  @return false if the file could not be created
+ */
+bool trajectoryOpen(const char* path, int numRows, int numCols, int maxTravelers, int inkPerMove,
+					int depositPerMove);
+
+/** CLOCK_MONOTONIC time in ns, as in the time column
+ */
+uint64_t trajectoryClock(void);
+
+/** Marks the calling thread's next move as the first of a life
+ */
+void trajectoryBeginLife(void);
+
+/** Appends a move to the calling thread's buffer
+ *  @param index        traveler index
+ *  @param row          row moved to
+ *  @param col          column moved to
+ *  @param dir          TravelDirection
+ *  @param type         TravelerType
+ *  @param inkWaitNs    time waited for ink before the move
+ */
+void trajectoryRecord(unsigned int index, int row, int col, int dir, int type, uint64_t inkWaitNs);
+
+/** Appends an end-of-life marker to the calling thread's buffer
+ *  @param index        traveler index
+ *  @param row          row the life ended on
+ *  @param col          column the life ended on
+ *  @param dir          TravelDirection
+ *  @param type         TravelerType
+ */
+void trajectoryEndLife(unsigned int index, int row, int col, int dir, int type);
+
+/** Writes the calling thread's buffered moves.  Call before a recording
+ *	thread exits.
+ */
+void trajectoryThreadEnd(void);
+
+/** Writes all the buffered moves and closes the file; moves recorded
+ *	afterwards are dropped
+ */
+void trajectoryClose(void);
+
+/** Prints what was written
+ *  @param out      output stream
+ */
+void trajectoryPrintReport(FILE* out);
+
+#endif // TRAJECTORY_H
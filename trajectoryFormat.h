@@ -0,0 +1,127 @@
+//
+//  trajectoryFormat.h
+//  GL threads
+//
+//  Layout of the trajectory files written with `travel -trajectory <file>`
+//	(see trajectory.h) and read by trajstat.  Like gridShared.h, this header
+//	stays free of the simulation, so that readers include it alone.
+//
+//	A file is a header, then chunks.  Each chunk holds the moves buffered by
+//	one traveler thread, column after column, so that a reader scans the
+//	columns it needs and skips the others by their size:
+//		time		ns since the start of the run, delta from the chunk's
+//					firstNs then from the previous move (unsigned varint)
+//		traveler	index of the traveler, delta (zigzag varint)
+//		row, col	cell moved to, delta (zigzag varint: mostly -1..1, 1 byte)
+//		dir			TravelDirection, ORed with TRAJ_LIFE_START on the first
+//					move of a life (1 byte)
+//		type		TravelerType (1 byte)
+//		wait		time waited for ink before the move, in us (unsigned varint)
+//	A life ends with a marker: a record whose dir has TRAJ_LIFE_END set, at
+//	the cell the traveler stopped on (its wait is 0).  It is not a move.
+//	Chunks of one thread are in order; chunks of different threads are
+//	interleaved in the order they were flushed.
+//
+
+#ifndef TRAJECTORY_FORMAT_H
+#define TRAJECTORY_FORMAT_H
+
+#include <cstdint>
+
+const uint32_t TRAJ_FILE_MAGIC = 0x4A415254;	//	"TRAJ"
+const uint32_t TRAJ_FILE_VERSION = 2;
+const uint32_t TRAJ_CHUNK_MAGIC = 0x4B484354;	//	"TCHK"
+
+const uint8_t TRAJ_LIFE_START = 0x80;
+const uint8_t TRAJ_LIFE_END = 0x40;
+const uint8_t TRAJ_DIR_MASK = 0x03;
+
+typedef enum TrajColumn {
+						TRAJ_TIME_COLUMN = 0,
+						TRAJ_TRAVELER_COLUMN,
+						TRAJ_ROW_COLUMN,
+						TRAJ_COL_COLUMN,
+						TRAJ_DIR_COLUMN,
+						TRAJ_TYPE_COLUMN,
+						TRAJ_WAIT_COLUMN,
+						//
+						NUM_TRAJ_COLUMNS
+} TrajColumn;
+
+/** File header
+ *  @var magic          TRAJ_FILE_MAGIC
+ *  @var version        TRAJ_FILE_VERSION
+ *  @var numRows        grid rows
+ *  @var numCols        grid columns
+ *  @var maxTravelers   size of the traveler table (travelers are < this)
+ *  @var inkPerMove     ink taken from the tank for each move
+ *  @var depositPerMove ink added to the cell moved to (saturating)
+ *  @var reserved       0
+ *  @var startNs        CLOCK_MONOTONIC time of the start of the run
+ */
+typedef struct TrajFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numRows;
+	uint32_t numCols;
+	uint32_t maxTravelers;
+	uint32_t inkPerMove;
+	uint32_t depositPerMove;
+	uint32_t reserved;
+	uint64_t startNs;
+} TrajFileHeader;
+
+/** Chunk header, followed by the columns in TrajColumn order
+ *  @var magic          TRAJ_CHUNK_MAGIC
+ *  @var numMoves       records in the chunk (moves and end-of-life markers)
+ *  @var firstNs        base of the time column
+ *  @var columnBytes    size of each column
+ *  @var reserved       0
+ */
+typedef struct TrajChunkHeader {
+	uint32_t magic;
+	uint32_t numMoves;
+	uint64_t firstNs;
+	uint32_t columnBytes[NUM_TRAJ_COLUMNS];
+	uint32_t reserved;
+} TrajChunkHeader;
+
+//	longest varint of a 64-bit value
+const int TRAJ_MAX_VARINT_BYTES = 10;
+
+inline uint8_t* trajPutVarint(uint8_t* out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		*out++ = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (uint8_t) value;
+	return out;
+}
+
+inline const uint8_t* trajGetVarint(const uint8_t* in, uint64_t* value)
+{
+	uint64_t result = 0;
+	int shift = 0;
+	while (*in & 0x80)
+	{
+		result |= (uint64_t) (*in++ & 0x7F) << shift;
+		shift += 7;
+	}
+	*value = result | ((uint64_t) *in++ << shift);
+	return in;
+}
+
+//	small signed values to small unsigned ones: 0, -1, 1, -2... -> 0, 1, 2, 3...
+inline uint64_t trajZigzag(int64_t value)
+{
+	return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+inline int64_t trajUnzigzag(uint64_t value)
+{
+	return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+#endif // TRAJECTORY_FORMAT_H
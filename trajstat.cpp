@@ -0,0 +1,241 @@
+//
+//  trajstat.cpp
+//  GL threads
+//
+//  Aggregates of a trajectory file written with `travel -trajectory <file>`:
+//	moves and throughput per color, path lengths of the lives, ink waits.
+//	The file is memory-mapped and scanned once, chunk by chunk; only the
+//	time, traveler, dir, type and wait columns are decoded, the row and col
+//	columns are skipped by their size.  Links nothing but the format.
+//
+//	usage:	trajstat <file>
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+//
+#include "trajectoryFormat.h"
+
+using namespace std;
+
+const int NUM_COLORS = 3;
+const char* COLOR_NAME[NUM_COLORS] = {"red", "green", "blue"};
+//	path lengths are counted in power-of-two buckets: 1, 2-3, 4-7...
+const int NUM_LENGTH_BUCKETS = 24;
+const int HISTOGRAM_WIDTH = 50;
+
+/** Totals of a color
+ *  @var moves          moves of the color
+ *  @var lives          lives completed (ended by a marker in the file)
+ *  @var lifeMoves      moves of those lives
+ *  @var longestLife    longest of them
+ *  @var waits          moves that waited for ink
+ *  @var waitUs         total time waited
+ *  @var maxWaitUs      longest wait
+ */
+typedef struct ColorTotals {
+	uint64_t moves;
+	uint64_t lives;
+	uint64_t lifeMoves;
+	uint64_t longestLife;
+	uint64_t waits;
+	uint64_t waitUs;
+	uint64_t maxWaitUs;
+} ColorTotals;
+
+/** Life in progress of a traveler
+ *  @var moves      moves so far (0: none seen)
+ *  @var type       its color
+ */
+typedef struct OpenLife {
+	uint64_t moves;
+	uint8_t type;
+} OpenLife;
+
+ColorTotals colorTotals[NUM_COLORS];
+uint64_t lengthBuckets[NUM_LENGTH_BUCKETS];
+OpenLife* openLives;
+
+static double nowSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void closeLife(OpenLife* life)
+{
+	if (life->moves == 0)
+		return;
+	ColorTotals* totals = colorTotals + life->type;
+	totals->lives++;
+	totals->lifeMoves += life->moves;
+	totals->longestLife = max(totals->longestLife, life->moves);
+	int bucket = 0;
+	while (bucket < NUM_LENGTH_BUCKETS-1 && (life->moves >> (bucket+1)) != 0)
+		bucket++;
+	lengthBuckets[bucket]++;
+	life->moves = 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s <file>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	int fd = open(argv[1], O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0)
+	{
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+	size_t size = info.st_size;
+	if (size < sizeof(TrajFileHeader))
+	{
+		fprintf(stderr, "%s: not a trajectory file\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	const uint8_t* base = (const uint8_t*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED)
+	{
+		perror("mmap");
+		return EXIT_FAILURE;
+	}
+	madvise((void*) base, size, MADV_SEQUENTIAL);
+
+	const TrajFileHeader* file = (const TrajFileHeader*) base;
+	//	version 1 had no end-of-life markers: a life ended when the next began
+	if (file->magic != TRAJ_FILE_MAGIC || file->version < 1 || file->version > TRAJ_FILE_VERSION)
+	{
+		fprintf(stderr, "%s: not a trajectory file (or version %u)\n", argv[1], file->version);
+		return EXIT_FAILURE;
+	}
+	openLives = (OpenLife*) calloc(file->maxTravelers, sizeof(OpenLife));
+
+	double scanStart = nowSeconds();
+	uint64_t numChunks = 0, numMoves = 0, numMarkers = 0, lastNs = 0, badValues = 0;
+	size_t offset = sizeof(TrajFileHeader);
+	while (offset + sizeof(TrajChunkHeader) <= size)
+	{
+		TrajChunkHeader chunk;
+		memcpy(&chunk, base + offset, sizeof(chunk));
+		size_t chunkBytes = sizeof(chunk);
+		for (int c=0; c<NUM_TRAJ_COLUMNS; c++)
+			chunkBytes += chunk.columnBytes[c];
+		if (chunk.magic != TRAJ_CHUNK_MAGIC || offset + chunkBytes > size)
+		{
+			fprintf(stderr, "%s: truncated or bad chunk at offset %zu: stopped there\n", argv[1], offset);
+			break;
+		}
+		const uint8_t* column[NUM_TRAJ_COLUMNS];
+		column[0] = base + offset + sizeof(chunk);
+		for (int c=1; c<NUM_TRAJ_COLUMNS; c++)
+			column[c] = column[c-1] + chunk.columnBytes[c-1];
+
+		//	the last time of the chunk is its latest
+		const uint8_t* in = column[TRAJ_TIME_COLUMN];
+		uint64_t timeNs = chunk.firstNs, delta;
+		for (uint32_t k=0; k<chunk.numMoves; k++)
+		{
+			in = trajGetVarint(in, &delta);
+			timeNs += delta;
+		}
+		lastNs = max(lastNs, timeNs);
+
+		const uint8_t* travelerIn = column[TRAJ_TRAVELER_COLUMN];
+		const uint8_t* dir = column[TRAJ_DIR_COLUMN];
+		const uint8_t* type = column[TRAJ_TYPE_COLUMN];
+		const uint8_t* waitIn = column[TRAJ_WAIT_COLUMN];
+		int64_t traveler = 0;
+		for (uint32_t k=0; k<chunk.numMoves; k++)
+		{
+			travelerIn = trajGetVarint(travelerIn, &delta);
+			traveler += trajUnzigzag(delta);
+			uint64_t waitUs;
+			waitIn = trajGetVarint(waitIn, &waitUs);
+			if (traveler < 0 || traveler >= (int64_t) file->maxTravelers || type[k] >= NUM_COLORS)
+			{
+				badValues++;
+				continue;
+			}
+			OpenLife* life = openLives + traveler;
+			if (dir[k] & TRAJ_LIFE_END)
+			{
+				closeLife(life);
+				numMarkers++;
+				continue;
+			}
+			if (dir[k] & TRAJ_LIFE_START)
+				closeLife(life);
+			life->moves++;
+			life->type = type[k];
+
+			ColorTotals* totals = colorTotals + type[k];
+			totals->moves++;
+			totals->waits += waitUs > 0;
+			totals->waitUs += waitUs;
+			totals->maxWaitUs = max(totals->maxWaitUs, waitUs);
+		}
+		numChunks++;
+		numMoves += chunk.numMoves;
+		offset += chunkBytes;
+	}
+	numMoves -= numMarkers;
+	//	lives still open at the end of the run are left out of the lengths
+	uint64_t unfinished = 0;
+	for (uint32_t t=0; t<file->maxTravelers; t++)
+		unfinished += openLives[t].moves > 0;
+	double scanSeconds = max(1e-9, nowSeconds() - scanStart);
+
+	double runSeconds = max(1e-9, lastNs * 1e-9);
+	printf("%s: grid %ux%u, %lu moves in %lu chunks over %.1f s, %.2f bytes/move\n", argv[1], file->numRows,
+			file->numCols, (unsigned long) numMoves, (unsigned long) numChunks, lastNs * 1e-9,
+			numMoves > 0 ? (double) size / numMoves : 0.);
+	printf("  scanned %.1f MiB in %.1f ms: %.2f GiB/s, %.1f M moves/s\n", size / 1048576., scanSeconds * 1e3,
+			size / scanSeconds / 1073741824., numMoves / scanSeconds * 1e-6);
+	if (badValues > 0)
+		printf("  %lu moves with an out-of-range traveler or type skipped\n", (unsigned long) badValues);
+
+	printf("  %-6s %10s %10s %8s %10s %8s %10s %10s %10s\n", "color", "moves", "moves/s", "lives", "mean path",
+			"longest", "ink waits", "mean wait", "max wait");
+	for (int c=0; c<NUM_COLORS; c++)
+	{
+		const ColorTotals* t = colorTotals + c;
+		printf("  %-6s %10lu %10.1f %8lu %10.1f %8lu %9.1f%% %8.0f us %7.1f ms\n", COLOR_NAME[c],
+				(unsigned long) t->moves, t->moves / runSeconds, (unsigned long) t->lives,
+				t->lives > 0 ? (double) t->lifeMoves / t->lives : 0., (unsigned long) t->longestLife,
+				t->moves > 0 ? 100. * t->waits / t->moves : 0., t->waits > 0 ? (double) t->waitUs / t->waits : 0.,
+				t->maxWaitUs * 1e-3);
+	}
+
+	uint64_t maxBucket = *max_element(lengthBuckets, lengthBuckets + NUM_LENGTH_BUCKETS);
+	printf("  path lengths (moves) of the completed lives, %lu still running at the end:\n",
+			(unsigned long) unfinished);
+	for (int b=0; b<NUM_LENGTH_BUCKETS && maxBucket > 0; b++)
+	{
+		if (lengthBuckets[b] == 0)
+			continue;
+		char range[32];
+		snprintf(range, sizeof(range), "%lu-%lu", 1UL << b, (2UL << b) - 1);
+		int bar = (int) (HISTOGRAM_WIDTH * lengthBuckets[b] / maxBucket);
+		printf("  %14s %8lu ", range, (unsigned long) lengthBuckets[b]);
+		for (int k=0; k<max(bar, 1); k++)
+			putchar('#');
+		putchar('\n');
+	}
+
+	munmap((void*) base, size);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,259 @@
+//
+//  travelerLayout.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <time.h>
+#include <pthread.h>
+//
+#include "gl_frontEnd.h"
+#include "travelerLayout.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+//	The traveler info struct before packing, for comparison
+typedef struct LegacyTravelerInfo {
+	TravelerType type;
+	int row;
+	int col;
+	TravelDirection dir;
+	int isLive;
+	int distance;
+	unsigned int index;
+	pthread_t threadID;
+	int node;
+} LegacyTravelerInfo;
+
+typedef enum BenchLayout {
+							LEGACY_LAYOUT = 0,
+							PACKED_LAYOUT,
+							ON_DEMAND_LAYOUT,
+							//
+							NUM_BENCH_LAYOUTS
+} BenchLayout;
+
+//	private working copy of a benchmark thread (packed layouts)
+typedef struct alignas(64) BenchHotState {
+	TravelerInfo info;
+	unsigned int index;
+	unsigned int publishedEpoch;
+} BenchHotState;
+
+typedef struct BenchThreadInfo {
+	int index;
+	BenchLayout layout;
+	unsigned long steps;
+} BenchThreadInfo;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+//	the benchmark moves its travelers on a wrapping virtual grid
+const int BENCH_GRID_MASK = 1023;
+//	steps between two checks of the stop flag
+const int BENCH_BATCH = 1024;
+//	frame interval of the reader (the publisher's, see main.cpp)
+const long BENCH_READ_INTERVAL_NS = 20 * 1000000L;
+
+const char* BENCH_LAYOUT_NAME[NUM_BENCH_LAYOUTS] = {"original layout, in place:      ",
+													"packed layout, private + store: ",
+													"packed layout, on demand:       "};
+
+LegacyTravelerInfo* benchLegacyTable = NULL;
+TravelerInfo* benchPackedTable = NULL;
+atomic<bool> benchStop(false);
+unsigned int benchReadEpoch = 0;
+int benchNumThreads = 0;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static unsigned int nextRandom(unsigned int* seed)
+{
+	*seed = *seed * 1103515245u + 12345u;
+	return *seed >> 16;
+}
+
+//	Same work on both layouts: one cell in the current direction, and a new
+//	direction and distance at the end of a segment.
+static void* legacyThread(void* data)
+{
+	BenchThreadInfo* info = static_cast<BenchThreadInfo*>(data);
+	LegacyTravelerInfo* tt = benchLegacyTable + info->index;
+	unsigned int seed = info->index + 1;
+	unsigned long steps = 0;
+	while (!benchStop.load(memory_order_relaxed))
+	{
+		for (int k=0; k<BENCH_BATCH; k++)
+		{
+			switch (tt->dir)
+			{
+				case NORTH:	tt->row = (tt->row - 1) & BENCH_GRID_MASK;	break;
+				case SOUTH:	tt->row = (tt->row + 1) & BENCH_GRID_MASK;	break;
+				case WEST:	tt->col = (tt->col - 1) & BENCH_GRID_MASK;	break;
+				default:	tt->col = (tt->col + 1) & BENCH_GRID_MASK;	break;
+			}
+			if (--tt->distance <= 0)
+			{
+				tt->dir = TravelDirection(nextRandom(&seed) % NUM_TRAVEL_DIRECTIONS);
+				tt->distance = 1 + nextRandom(&seed) % 64;
+			}
+			//	keep the compiler from folding the stores into registers
+			atomic_signal_fence(memory_order_seq_cst);
+		}
+		steps += BENCH_BATCH;
+	}
+	info->steps = steps;
+	return NULL;
+}
+
+static void* packedThread(void* data)
+{
+	BenchThreadInfo* info = static_cast<BenchThreadInfo*>(data);
+	bool onDemand = info->layout == ON_DEMAND_LAYOUT;
+	BenchHotState hot;
+	hot.index = info->index;
+	hot.info = benchPackedTable[hot.index];
+	hot.publishedEpoch = 0;
+	TravelerInfo* tt = &hot.info;
+	unsigned int seed = info->index + 1;
+	unsigned long steps = 0;
+	while (!benchStop.load(memory_order_relaxed))
+	{
+		for (int k=0; k<BENCH_BATCH; k++)
+		{
+			switch (tt->dir)
+			{
+				case NORTH:	tt->row = (tt->row - 1) & BENCH_GRID_MASK;	break;
+				case SOUTH:	tt->row = (tt->row + 1) & BENCH_GRID_MASK;	break;
+				case WEST:	tt->col = (tt->col - 1) & BENCH_GRID_MASK;	break;
+				default:	tt->col = (tt->col + 1) & BENCH_GRID_MASK;	break;
+			}
+			if (--tt->distance == 0)
+			{
+				tt->dir = nextRandom(&seed) % NUM_TRAVEL_DIRECTIONS;
+				tt->distance = 1 + nextRandom(&seed) % 64;
+			}
+			if (onDemand)
+			{
+				unsigned int epoch = __atomic_load_n(&benchReadEpoch, __ATOMIC_RELAXED);
+				if (epoch == hot.publishedEpoch)
+					continue;
+				hot.publishedEpoch = epoch;
+			}
+			__atomic_store(benchPackedTable + hot.index, tt, __ATOMIC_RELEASE);
+		}
+		steps += BENCH_BATCH;
+	}
+	info->steps = steps;
+	return NULL;
+}
+
+//	Reads the packed table at the publisher's rate, then asks for the next
+//	frame, as gridPublish's writeFrame does
+static void* readerThread(void*)
+{
+	struct timespec interval = {0, BENCH_READ_INTERVAL_NS};
+	while (!benchStop.load(memory_order_relaxed))
+	{
+		nanosleep(&interval, NULL);
+		for (int k=0; k<benchNumThreads; k++)
+		{
+			TravelerInfo traveler;
+			__atomic_load(benchPackedTable + k, &traveler, __ATOMIC_RELAXED);
+		}
+		__atomic_fetch_add(&benchReadEpoch, 1, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+/** Runs one layout, with the reader in all cases
+ *  @return steps per second, all threads together
+ */
+static double runLayout(BenchLayout layout, int numThreads, double seconds)
+{
+	BenchThreadInfo* info = new BenchThreadInfo[numThreads];
+	pthread_t* threads = new pthread_t[numThreads];
+	pthread_t reader;
+	benchStop = false;
+	benchNumThreads = numThreads;
+	for (int k=0; k<numThreads; k++)
+	{
+		info[k].index = k;
+		info[k].layout = layout;
+		info[k].steps = 0;
+		if (pthread_create(threads + k, nullptr, layout == LEGACY_LAYOUT ? legacyThread : packedThread, info + k) != 0)
+		{
+			fprintf(stderr, "could not create benchmark thread %d\n", k);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (pthread_create(&reader, nullptr, readerThread, nullptr) != 0)
+	{
+		fprintf(stderr, "could not create the benchmark reader\n");
+		exit(EXIT_FAILURE);
+	}
+
+	struct timespec delay;
+	delay.tv_sec = (time_t) seconds;
+	delay.tv_nsec = (long) ((seconds - delay.tv_sec) * 1e9);
+	nanosleep(&delay, NULL);
+	benchStop = true;
+	pthread_join(reader, NULL);
+
+	unsigned long steps = 0;
+	for (int k=0; k<numThreads; k++)
+	{
+		pthread_join(threads[k], NULL);
+		steps += info[k].steps;
+	}
+	delete [] threads;
+	delete [] info;
+	return steps / seconds;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void travelerLayoutPrintReport(FILE* out, int numTravelers)
+{
+	size_t hotBytes = sizeof(TravelerInfo), coldBytes = sizeof(TravelerDebugInfo);
+	fprintf(out, "Traveler table: %zu bytes/traveler (%zu per cache line) + %zu bytes cold"
+			" (was %zu bytes/traveler)\n", hotBytes, 64 / hotBytes, coldBytes, sizeof(LegacyTravelerInfo));
+	fprintf(out, "  %d travelers: %.1f KiB hot + %.1f KiB cold\n", numTravelers,
+			numTravelers * hotBytes / 1024., numTravelers * coldBytes / 1024.);
+}
+
+void travelerLayoutBenchmark(int numThreads, double seconds, FILE* out)
+{
+	benchLegacyTable = (LegacyTravelerInfo*) calloc(numThreads, sizeof(LegacyTravelerInfo));
+	benchPackedTable = (TravelerInfo*) calloc(numThreads, sizeof(TravelerInfo));
+	for (int k=0; k<numThreads; k++)
+	{
+		benchLegacyTable[k].distance = 1;
+		benchPackedTable[k].distance = 1;
+	}
+
+	travelerLayoutPrintReport(out, numThreads);
+	double rate[NUM_BENCH_LAYOUTS];
+	for (int layout=0; layout<NUM_BENCH_LAYOUTS; layout++)
+		rate[layout] = runLayout((BenchLayout) layout, numThreads, seconds);
+	fprintf(out, "Layout benchmark, %d threads on adjacent entries, a reader every %ld ms, %.1f s each:\n",
+			numThreads, BENCH_READ_INTERVAL_NS / 1000000, seconds);
+	for (int layout=0; layout<NUM_BENCH_LAYOUTS; layout++)
+		fprintf(out, "  %s%.0f steps/s (%.2fx)\n", BENCH_LAYOUT_NAME[layout], rate[layout],
+				rate[layout] / rate[LEGACY_LAYOUT]);
+
+	free(benchLegacyTable);
+	free(benchPackedTable);
+}
@@ -0,0 +1,40 @@
+//
+//  travelerLayout.h
+//  GL threads
+//
+//  Memory footprint of the traveler table, and a benchmark of its write
+//	traffic.  The benchmark runs one thread per traveler, stepping without
+//	sleeps, under three layouts: the original one (a 48-byte TravelerInfo
+//	updated field by field, in place, in the shared table), the packed one
+//	(an 8-byte entry published with one store per step from a private,
+//	cache-line-aligned working copy), and the packed one published on
+//	demand (a store only when a reader thread, reading the table at the
+//	publisher's frame rate, has bumped the read epoch, as the simulation
+//	does).  The differences in steps per second are the cost of the cache
+//	lines bouncing between cores.
+//
+
+#ifndef TRAVELER_LAYOUT_H
+#define TRAVELER_LAYOUT_H
+
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Prints the bytes per traveler of the packed and cold tables, against
+ *	the original layout
+ *  @param out          output stream
+ *  @param numTravelers number of travelers
+ */
+void travelerLayoutPrintReport(FILE* out, int numTravelers);
+
+/** Runs the write-traffic benchmark on both layouts and prints the results
+ *  @param numThreads   number of traveler threads (adjacent table entries)
+ *  @param seconds      duration of each run
+ *  @param out          output stream
+ */
+void travelerLayoutBenchmark(int numThreads, double seconds, FILE* out);
+
+#endif // TRAVELER_LAYOUT_H
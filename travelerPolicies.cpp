@@ -0,0 +1,178 @@
+//
+//  travelerPolicies.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include <time.h>
+//
+#include "travelerPolicies.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+const char* MOVEMENT_POLICY_NAME[NUM_MOVEMENT_POLICIES] = {"random", "straight", "seek", "fill"};
+
+atomic<uint32_t> policySeedCounter(0);
+
+//	ink deposited per step in the benchmark (as TRAV_INK_INCR in main.cpp)
+const unsigned int POLICY_BENCH_INK_INCR = 16;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static double nowSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static bool atCorner(const PolicyGrid* g, int col, int row)
+{
+	return (col == 0 || col == g->numCols-1) && (row == 0 || row == g->numRows-1);
+}
+
+/** Moves one walker for numSteps cells through the grid with the policies
+ *	inlined, respawning it when it reaches a corner
+ *  @return seconds taken
+ */
+template <class Movement, class Color>
+static double benchmarkInstance(unsigned int* cells, const PolicyGrid* g, long numSteps)
+{
+	int row = 1 + policyRandom() % (g->numRows-1), col = 1 + policyRandom() % (g->numCols-1);
+	TravelDirection dir = static_cast<TravelDirection>(policyRandom() % NUM_TRAVEL_DIRECTIONS);
+	double start = nowSeconds();
+	dir = Movement::template turn<Color>(g, col, row, dir);
+	for (long steps=0; steps < numSteps; )
+	{
+		if (atCorner(g, col, row))
+		{
+			row = 1 + policyRandom() % (g->numRows-1);
+			col = 1 + policyRandom() % (g->numCols-1);
+			dir = Movement::template turn<Color>(g, col, row, dir);
+		}
+		unsigned int distance = Movement::distance(g, col, row, dir);
+		const int dRow = dir == NORTH ? -1 : (dir == SOUTH ? 1 : 0);
+		const int dCol = dir == WEST ? -1 : (dir == EAST ? 1 : 0);
+		for (unsigned int k=0; k<distance; k++, steps++)
+		{
+			row += dRow;
+			col += dCol;
+			unsigned int* cell = cells + (size_t) row * g->numCols + col;
+			*cell = Color::deposit(*cell, POLICY_BENCH_INK_INCR);
+		}
+		dir = Movement::template turn<Color>(g, col, row, dir);
+	}
+	return nowSeconds() - start;
+}
+
+/** The same walk as the random-turn instantiations, the way the traveler
+ *	threads did it before: rand(), a switch on the direction per step, and
+ *	the channel's shift computed from the type at run time
+ */
+static double benchmarkRuntime(unsigned int* cells, const PolicyGrid* g, long numSteps, TravelerType type)
+{
+	int row = 1 + rand() % (g->numRows-1), col = 1 + rand() % (g->numCols-1);
+	TravelDirection dir = static_cast<TravelDirection>(rand() % NUM_TRAVEL_DIRECTIONS);
+	double start = nowSeconds();
+	for (long steps=0; steps < numSteps; )
+	{
+		if (atCorner(g, col, row))
+		{
+			row = 1 + rand() % (g->numRows-1);
+			col = 1 + rand() % (g->numCols-1);
+		}
+		if (dir == NORTH || dir == SOUTH)
+			dir = col == 0 ? EAST : (col == g->numCols-1 ? WEST : static_cast<TravelDirection>((rand() % 2)*2 + 1));
+		else
+			dir = row == 0 ? SOUTH : (row == g->numRows-1 ? NORTH : static_cast<TravelDirection>((rand() % 2)*2));
+		int room = dir == NORTH ? row : (dir == SOUTH ? g->numRows - row : (dir == WEST ? col : g->numCols - col));
+		int distance = max(1, rand() % max(1, room));
+		for (int k=0; k<distance; k++, steps++)
+		{
+			switch (dir)
+			{
+				case NORTH:	row -= 1;	break;
+				case SOUTH:	row += 1;	break;
+				case WEST:	col -= 1;	break;
+				case EAST:	col += 1;	break;
+				default:				break;
+			}
+			int shift = 8 * type;
+			unsigned int* cell = cells + (size_t) row * g->numCols + col;
+			unsigned int level = min(0xFFU, ((*cell >> shift) & 0xFF) + POLICY_BENCH_INK_INCR);
+			*cell = (*cell & ~(0xFFU << shift)) | (level << shift);
+		}
+	}
+	return nowSeconds() - start;
+}
+
+template <class Movement, class Color>
+static void reportInstance(vector<unsigned int>& cells, const PolicyGrid* g, long numSteps, FILE* out)
+{
+	fill(cells.begin(), cells.end(), 0xFF000000);
+	double seconds = benchmarkInstance<Movement, Color>(cells.data(), g, numSteps);
+	unsigned long painted = 0;
+	for (unsigned int cell : cells)
+		painted += Color::level(cell) != 0;
+	fprintf(out, "  %-9s %-6s %8.2f ns/step %10.1f M steps/s %8.1f%% of the grid painted\n",
+			movementPolicyName(Movement::id), Color::type == RED_TRAV ? "red" : (Color::type == GREEN_TRAV ? "green" : "blue"),
+			1e9 * seconds / numSteps, numSteps / seconds * 1e-6, 100. * painted / cells.size());
+}
+
+template <class Movement>
+static void reportMovement(vector<unsigned int>& cells, const PolicyGrid* g, long numSteps, FILE* out)
+{
+	reportInstance<Movement, ColorPolicy<RED_TRAV> >(cells, g, numSteps, out);
+	reportInstance<Movement, ColorPolicy<GREEN_TRAV> >(cells, g, numSteps, out);
+	reportInstance<Movement, ColorPolicy<BLUE_TRAV> >(cells, g, numSteps, out);
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+uint32_t policyRandomSeed(void)
+{
+	uint32_t seed = (uint32_t) time(NULL) ^ (++policySeedCounter * 0x9E3779B9u);
+	return seed != 0 ? seed : 1;
+}
+
+MovementPolicyID movementPolicyFromName(const char* name)
+{
+	for (int k=0; k<NUM_MOVEMENT_POLICIES; k++)
+		if (strcmp(name, MOVEMENT_POLICY_NAME[k]) == 0)
+			return static_cast<MovementPolicyID>(k);
+	return NUM_MOVEMENT_POLICIES;
+}
+
+const char* movementPolicyName(MovementPolicyID movement)
+{
+	return movement < NUM_MOVEMENT_POLICIES ? MOVEMENT_POLICY_NAME[movement] : "?";
+}
+
+void travelerPolicyBenchmark(int numRows, int numCols, long numSteps, FILE* out)
+{
+	vector<unsigned int> cells((size_t) numRows * numCols);
+	PolicyGrid g = {cells.data(), numRows, numCols};
+	fprintf(out, "Traveler policies: %ld steps per instantiation on a %dx%d grid\n", numSteps, numRows, numCols);
+
+	fill(cells.begin(), cells.end(), 0xFF000000);
+	double seconds = benchmarkRuntime(cells.data(), &g, numSteps, RED_TRAV);
+	fprintf(out, "  %-16s %8.2f ns/step %10.1f M steps/s\n", "runtime (before)", 1e9 * seconds / numSteps,
+			numSteps / seconds * 1e-6);
+
+	reportMovement<RandomTurnPolicy>(cells, &g, numSteps, out);
+	reportMovement<StraightLinePolicy>(cells, &g, numSteps, out);
+	reportMovement<InkSeekingPolicy>(cells, &g, numSteps, out);
+	reportMovement<SpaceFillingPolicy>(cells, &g, numSteps, out);
+}
@@ -0,0 +1,303 @@
+//
+//  travelerPolicies.h
+//  GL threads
+//
+//  Compile-time policies of a traveler.  A movement policy picks the next
+//	direction at the end of a segment and the length of the segment; a
+//	color policy knows the traveler's channel as constants (shift and mask
+//	into the packed cell) and which tank to draw ink from.  The traveler
+//	loop is a template over one policy of each kind, so every combination
+//	gets its own fully inlined loop, with no branch on the traveler's type
+//	or movement left inside.
+//
+
+#ifndef TRAVELER_POLICIES_H
+#define TRAVELER_POLICIES_H
+
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+//
+#include "gl_frontEnd.h"
+#include "inkMix.h"
+
+//-----------------------------------------------------------------------------
+//	Data types
+//-----------------------------------------------------------------------------
+
+typedef enum MovementPolicyID {
+								RANDOM_TURN_MOVEMENT = 0,
+								STRAIGHT_LINE_MOVEMENT,
+								INK_SEEKING_MOVEMENT,
+								SPACE_FILLING_MOVEMENT,
+								//
+								NUM_MOVEMENT_POLICIES
+} MovementPolicyID;
+
+/** The grid as the policies see it
+ *  @var cells      numRows x numCols packed RGBA cells, row after row
+ *  @var numRows    number of rows
+ *  @var numCols    number of columns
+ */
+typedef struct PolicyGrid {
+	const unsigned int* cells;
+	int numRows;
+	int numCols;
+} PolicyGrid;
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+//	ink access functions (main.cpp)
+bool acquireRedInk(int theRed);
+bool acquireGreenInk(int theGreen);
+bool acquireBlueInk(int theBlue);
+bool acquireInkMix(int theRed, int theGreen, int theBlue);
+
+/** Seed of the calling thread's policy generator
+ *  @return a nonzero seed, different for every thread
+ */
+uint32_t policyRandomSeed(void);
+
+/** Looks a movement policy up by name
+ *  @param name     "random", "straight", "seek" or "fill"
+ *  @return the policy, NUM_MOVEMENT_POLICIES if there is no such policy
+ */
+MovementPolicyID movementPolicyFromName(const char* name);
+
+const char* movementPolicyName(MovementPolicyID movement);
+
+/** Runs every instantiation on a private grid, without ink or sleeps, and
+ *	prints the time per step of each, next to the runtime-dispatched path
+ *	the traveler threads used before
+ *  @param numRows      rows of the grid
+ *  @param numCols      columns of the grid
+ *  @param numSteps     cell moves per instantiation
+ *  @param out          output stream
+ */
+void travelerPolicyBenchmark(int numRows, int numCols, long numSteps, FILE* out);
+
+//-----------------------------------------------------------------------------
+//	Policies
+//-----------------------------------------------------------------------------
+
+//	Per-thread xorshift generator: unlike rand(), takes no lock
+inline uint32_t policyRandom(void)
+{
+	thread_local uint32_t state = policyRandomSeed();
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+//	Cells left between (col, row) and the grid's edge in direction dir
+inline int roomAhead(const PolicyGrid* g, int col, int row, TravelDirection dir)
+{
+	switch (dir)
+	{
+		case NORTH:	return row;
+		case SOUTH:	return g->numRows - 1 - row;
+		case WEST:	return col;
+		default:	return g->numCols - 1 - col;
+	}
+}
+
+/** Color policy: the traveler's channel is byte TYPE of the cell
+ */
+template <TravelerType TYPE>
+struct ColorPolicy {
+	static constexpr bool MIXED = false;
+	static constexpr TravelerType type = TYPE;
+	static constexpr int CHANNEL = TYPE;
+	static constexpr int SHIFT = 8 * TYPE;
+	static constexpr unsigned int MASK = 0xFFu << SHIFT;
+
+	static inline unsigned int level(unsigned int cell)
+	{
+		return (cell & MASK) >> SHIFT;
+	}
+
+	//	cell with amount added to the channel, which saturates at 0xFF
+	static inline unsigned int deposit(unsigned int cell, unsigned int amount)
+	{
+		unsigned int newLevel = std::min(0xFFu, level(cell) + amount);
+		return (cell & ~MASK) | (newLevel << SHIFT);
+	}
+
+	//	tank whose refills a traveler out of ink waits for
+	static inline int inkChannel(void)
+	{
+		return TYPE;
+	}
+
+	static inline bool acquireInk(void)
+	{
+		if constexpr (TYPE == RED_TRAV)
+			return acquireRedInk(1);
+		else if constexpr (TYPE == GREEN_TRAV)
+			return acquireGreenInk(1);
+		else
+			return acquireBlueInk(1);
+	}
+};
+
+/** Color policy of mixed travelers: each cell takes the recipe of inkMix.h
+ *	from the tanks, all at once, and gets each ink of it (the recipe is set
+ *	at run time, so it is read from its globals).  Movements that follow
+ *	ink see the main color.
+ */
+struct MixedColorPolicy {
+	static constexpr bool MIXED = true;
+
+	static inline unsigned int level(unsigned int cell)
+	{
+		return (cell >> (8 * inkMixChannel)) & 0xFF;
+	}
+
+	//	amount added per unit of each ink of the recipe
+	static inline unsigned int deposit(unsigned int cell, unsigned int amount)
+	{
+		for (int c=0; c<3; c++)
+		{
+			unsigned int shift = 8 * c;
+			unsigned int newLevel = std::min(0xFFu, ((cell >> shift) & 0xFF) + amount * inkMixRecipe[c]);
+			cell = (cell & ~(0xFFu << shift)) | (newLevel << shift);
+		}
+		return cell;
+	}
+
+	static inline int inkChannel(void)
+	{
+		return inkMixChannel;
+	}
+
+	static inline bool acquireInk(void)
+	{
+		return acquireInkMix(inkMixRecipe[0], inkMixRecipe[1], inkMixRecipe[2]);
+	}
+};
+
+/** Random perpendicular turn, random distance up to the edge (the
+ *	original movement)
+ */
+struct RandomTurnPolicy {
+	static constexpr MovementPolicyID id = RANDOM_TURN_MOVEMENT;
+
+	template <class Color>
+	static inline TravelDirection turn(const PolicyGrid* g, int col, int row, TravelDirection dir)
+	{
+		if (dir == NORTH || dir == SOUTH)
+		{
+			if (col == 0)
+				return EAST;
+			if (col == g->numCols-1)
+				return WEST;
+			return (policyRandom() & 1) ? EAST : WEST;
+		}
+		if (row == 0)
+			return SOUTH;
+		if (row == g->numRows-1)
+			return NORTH;
+		return (policyRandom() & 1) ? NORTH : SOUTH;
+	}
+
+	static inline unsigned int distance(const PolicyGrid* g, int col, int row, TravelDirection dir)
+	{
+		//	never beyond the edge
+		int room = std::max(1, roomAhead(g, col, row, dir) + (dir == SOUTH || dir == EAST));
+		return std::max(1u, policyRandom() % room);
+	}
+};
+
+/** Straight to the edge, then a random perpendicular turn
+ */
+struct StraightLinePolicy {
+	static constexpr MovementPolicyID id = STRAIGHT_LINE_MOVEMENT;
+
+	template <class Color>
+	static inline TravelDirection turn(const PolicyGrid* g, int col, int row, TravelDirection dir)
+	{
+		if (roomAhead(g, col, row, dir) > 0)
+			return dir;
+		return RandomTurnPolicy::turn<Color>(g, col, row, dir);
+	}
+
+	static inline unsigned int distance(const PolicyGrid* g, int col, int row, TravelDirection dir)
+	{
+		return std::max(1, roomAhead(g, col, row, dir));
+	}
+};
+
+/** Turns toward the perpendicular neighbour with more ink of the
+ *	traveler's color (trail following), in short hops
+ */
+struct InkSeekingPolicy {
+	static constexpr MovementPolicyID id = INK_SEEKING_MOVEMENT;
+	static constexpr int MAX_HOP = 4;
+
+	template <class Color>
+	static inline TravelDirection turn(const PolicyGrid* g, int col, int row, TravelDirection dir)
+	{
+		TravelDirection left, right;
+		int dRow = 0, dCol = 0;
+		if (dir == NORTH || dir == SOUTH)
+		{
+			if (col == 0 || col == g->numCols-1)
+				return col == 0 ? EAST : WEST;
+			left = WEST;
+			right = EAST;
+			dCol = 1;
+		}
+		else
+		{
+			if (row == 0 || row == g->numRows-1)
+				return row == 0 ? SOUTH : NORTH;
+			left = NORTH;
+			right = SOUTH;
+			dRow = 1;
+		}
+		//	relaxed reads: a stale neighbour only makes a worse choice
+		unsigned int before = __atomic_load_n(g->cells + (size_t) (row - dRow) * g->numCols + col - dCol, __ATOMIC_RELAXED);
+		unsigned int after = __atomic_load_n(g->cells + (size_t) (row + dRow) * g->numCols + col + dCol, __ATOMIC_RELAXED);
+		unsigned int levelBefore = Color::level(before), levelAfter = Color::level(after);
+		if (levelBefore == levelAfter)
+			return (policyRandom() & 1) ? left : right;
+		return levelBefore > levelAfter ? left : right;
+	}
+
+	static inline unsigned int distance(const PolicyGrid* g, int col, int row, TravelDirection dir)
+	{
+		return std::max(1, std::min(roomAhead(g, col, row, dir), 1 + (int) (policyRandom() % MAX_HOP)));
+	}
+};
+
+/** Sweeps the grid row by row, away from the corners: across to the
+ *	second-to-last column, one row down, back across; from the
+ *	second-to-last row, back up to the second row
+ */
+struct SpaceFillingPolicy {
+	static constexpr MovementPolicyID id = SPACE_FILLING_MOVEMENT;
+
+	template <class Color>
+	static inline TravelDirection turn(const PolicyGrid* g, int col, int row, TravelDirection dir)
+	{
+		if (dir == EAST || dir == WEST)
+			return row < g->numRows-2 ? SOUTH : NORTH;
+		return col <= g->numCols/2 ? EAST : WEST;
+	}
+
+	static inline unsigned int distance(const PolicyGrid* g, int col, int row, TravelDirection dir)
+	{
+		switch (dir)
+		{
+			case SOUTH:	return 1;
+			case NORTH:	return std::max(1, row - 1);
+			case WEST:	return std::max(1, col - 1);
+			default:	return std::max(1, g->numCols - 2 - col);
+		}
+	}
+};
+
+#endif // TRAVELER_POLICIES_H
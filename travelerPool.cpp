@@ -0,0 +1,204 @@
+//
+//  travelerPool.cpp
+//  GL threads
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+//
+#include "travelerPool.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+//  Data types
+//---------------------------------------------------------------------------
+
+//	Where a retired traveler's thread waits to be spawned again.  One per
+//	slot, on its own cache line.
+typedef struct alignas(64) SlotParking {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool spawned;
+} SlotParking;
+
+//---------------------------------------------------------------------------
+//  File-level global variables
+//---------------------------------------------------------------------------
+
+//	Free list: a Treiber stack of slot indices.  The head packs a tag
+//	(incremented by every pop, against ABA) with the top slot index + 1
+//	(0 = empty list).
+atomic<uint64_t> poolHead(0);
+atomic<uint32_t>* poolNext = NULL;
+SlotParking* poolParking = NULL;
+int poolNumSlots = 0;
+
+double poolSpawnRate = 0.;
+void (*poolSpawnCallback)(unsigned int slot) = NULL;
+pthread_t poolSpawnerThreadID;
+struct timespec poolSpawnerStart;
+
+atomic<unsigned long> poolSpawned(0);
+atomic<unsigned long> poolRetired(0);
+atomic<unsigned long> poolEmptyTicks(0);
+atomic<unsigned long> poolBurstSpawned(0);
+
+//	longest the spawner sleeps, so that low rates still spawn on time
+const long MAX_SPAWNER_SLEEP_US = 10000;
+
+//---------------------------------------------------------------------------
+//  Private functions
+//---------------------------------------------------------------------------
+
+static double secondsSince(const struct timespec& start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+static void signalSpawn(unsigned int slot)
+{
+	SlotParking* parking = poolParking + slot;
+	pthread_mutex_lock(&parking->lock);
+	parking->spawned = true;
+	pthread_cond_signal(&parking->cond);
+	pthread_mutex_unlock(&parking->lock);
+}
+
+/** Spawns travelers at poolSpawnRate: the number spawned so far tracks
+ *	rate x elapsed time, whatever the sleep granularity.
+ */
+static void* spawnerThread(void* data)
+{
+	long sleepTime = (long) (1000000. / poolSpawnRate);
+	if (sleepTime > MAX_SPAWNER_SLEEP_US)
+		sleepTime = MAX_SPAWNER_SLEEP_US;
+
+	unsigned long due = 0;
+	while (true)
+	{
+		usleep(sleepTime);
+		unsigned long target = (unsigned long) (secondsSince(poolSpawnerStart) * poolSpawnRate);
+		while (due < target)
+		{
+			unsigned int slot;
+			if (!travelerPoolAcquire(&slot))
+			{
+				//	population is full: spawns that fall due now are dropped
+				poolEmptyTicks++;
+				due = target;
+				break;
+			}
+			poolSpawnCallback(slot);
+			poolSpawned++;
+			signalSpawn(slot);
+			due++;
+		}
+	}
+	return NULL;
+}
+
+//---------------------------------------------------------------------------
+//  Public functions
+//---------------------------------------------------------------------------
+
+void travelerPoolInitialize(int numSlots)
+{
+	poolNumSlots = numSlots;
+	poolNext = new atomic<uint32_t>[numSlots];
+	poolParking = new SlotParking[numSlots];
+	for (int k=0; k<numSlots; k++)
+	{
+		poolNext[k].store(0);
+		pthread_mutex_init(&poolParking[k].lock, NULL);
+		pthread_cond_init(&poolParking[k].cond, NULL);
+		poolParking[k].spawned = false;
+	}
+	poolHead.store(0);
+}
+
+void travelerPoolRelease(unsigned int slot)
+{
+	uint64_t head = poolHead.load(memory_order_relaxed);
+	uint64_t newHead;
+	do {
+		poolNext[slot].store((uint32_t) head, memory_order_relaxed);
+		newHead = (head & 0xFFFFFFFF00000000ULL) | (slot + 1);
+	} while (!poolHead.compare_exchange_weak(head, newHead, memory_order_release,
+											 memory_order_relaxed));
+	poolRetired++;
+}
+
+bool travelerPoolAcquire(unsigned int* slot)
+{
+	uint64_t head = poolHead.load(memory_order_acquire);
+	while (true)
+	{
+		uint32_t top = (uint32_t) head;
+		if (top == 0)
+			return false;
+		uint64_t tag = (head >> 32) + 1;
+		uint64_t newHead = (tag << 32) | poolNext[top - 1].load(memory_order_relaxed);
+		if (poolHead.compare_exchange_weak(head, newHead, memory_order_acquire,
+										   memory_order_acquire))
+		{
+			*slot = top - 1;
+			return true;
+		}
+	}
+}
+
+void travelerPoolWaitForSpawn(unsigned int slot)
+{
+	SlotParking* parking = poolParking + slot;
+	pthread_mutex_lock(&parking->lock);
+	while (!parking->spawned)
+		pthread_cond_wait(&parking->cond, &parking->lock);
+	parking->spawned = false;
+	pthread_mutex_unlock(&parking->lock);
+}
+
+void travelerPoolStartSpawner(double rate, void (*spawnFunc)(unsigned int slot))
+{
+	poolSpawnRate = rate;
+	poolSpawnCallback = spawnFunc;
+	clock_gettime(CLOCK_MONOTONIC, &poolSpawnerStart);
+	if (pthread_create(&poolSpawnerThreadID, nullptr, spawnerThread, NULL) != 0)
+	{
+		fprintf(stderr, "could not create the spawner thread\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+int travelerPoolSpawnNow(int count, void (*spawnFunc)(unsigned int slot))
+{
+	int spawned = 0;
+	unsigned int slot;
+	while (spawned < count && travelerPoolAcquire(&slot))
+	{
+		spawnFunc(slot);
+		poolSpawned++;
+		signalSpawn(slot);
+		spawned++;
+	}
+	poolBurstSpawned += spawned;
+	return spawned;
+}
+
+void travelerPoolPrintReport(FILE* out)
+{
+	fprintf(out, "Traveler pool: %d slots, spawn rate %.1f/s, %lu spawned, %lu retired",
+			poolNumSlots, poolSpawnRate, poolSpawned.load(), poolRetired.load());
+	if (poolBurstSpawned > 0)
+		fprintf(out, ", %lu in bursts", poolBurstSpawned.load());
+	if (poolEmptyTicks > 0)
+		fprintf(out, ", population full %lu time(s)", poolEmptyTicks.load());
+	fprintf(out, "\n");
+}
@@ -0,0 +1,62 @@
+//
+//  travelerPool.h
+//  GL threads
+//
+//  Traveler slot recycling for sustained-load runs.  When a traveler
+//	reaches a corner its slot goes back on a lock-free free list and its
+//	thread parks.  A spawner thread takes slots off the free list at a
+//	configurable rate, reinitializes them, and wakes their thread: no
+//	allocation and no thread creation per spawn.
+//
+
+#ifndef TRAVELER_POOL_H
+#define TRAVELER_POOL_H
+
+#include <cstdio>
+
+//-----------------------------------------------------------------------------
+//	Function prototypes
+//-----------------------------------------------------------------------------
+
+/** Allocates the free list and the per-slot parking spots.  All slots
+ *	start out in use.
+ *  @param numSlots     number of traveler slots
+ */
+void travelerPoolInitialize(int numSlots);
+
+/** Puts a slot back on the free list (lock-free)
+ *  @param slot         slot index
+ */
+void travelerPoolRelease(unsigned int slot);
+
+/** Takes a slot off the free list (lock-free)
+ *  @param slot         receives the slot index
+ *  @return false if the free list is empty
+ */
+bool travelerPoolAcquire(unsigned int* slot);
+
+/** Parks the calling traveler thread until its slot is spawned again
+ *  @param slot         the thread's slot
+ */
+void travelerPoolWaitForSpawn(unsigned int slot);
+
+/** Starts the spawner thread
+ *  @param rate         spawns per second
+ *  @param spawnFunc    reinitializes a slot taken off the free list (called
+ *                      before the slot's thread is woken up)
+ */
+void travelerPoolStartSpawner(double rate, void (*spawnFunc)(unsigned int slot));
+
+/** Spawns up to count travelers right away, from the calling thread
+ *  @param count        travelers wanted
+ *  @param spawnFunc    reinitializes each slot, as for the spawner
+ *  @return travelers spawned (fewer if the free list runs out)
+ */
+int travelerPoolSpawnNow(int count, void (*spawnFunc)(unsigned int slot));
+
+/** Prints the spawn/retire counters
+ *  @param out          output stream
+ */
+void travelerPoolPrintReport(FILE* out);
+
+#endif // TRAVELER_POOL_H